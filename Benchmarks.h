@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Core.h"
+#include "Primitive.h"
+#include "ThreadPool.h"
+
+/*
+ *	Headless checks and benchmarks, one translation unit per subsystem. The headless main() only
+ *	runs them when asked: --bench for all of them, --bench=<gpu|math|raster|shaders> for one group.
+ */
+void runGPUBenchmarks(Core& core, Primitive& primitive);                       // BenchmarksGPU.cpp
+void runMathBenchmarks(Core& core, ThreadPool& pool);                          // BenchmarksMath.cpp
+void runRasterBenchmarks(Core& core, Primitive& primitive, ThreadPool& pool);  // BenchmarksRaster.cpp
+void runShaderBenchmarks(Core& core, Primitive& primitive);                    // BenchmarksShaders.cpp
+
+// Per-frame constant buffer updates, defined in main.cpp
+void updateConstants(Primitive& primitive, float time, unsigned int WIDTH, unsigned int HEIGHT);
@@ -0,0 +1,270 @@
+#ifndef _WIN32
+// Headless benchmarks: Barrier tracking, placed memory, constant updates, uploads, streaming and mesh optimisation
+#include "Benchmarks.h"
+#include "Core.h"
+#include "Mesh.h"
+#include "NullDevice.h"
+#include "Primitive.h"
+#include "TLSFAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Compare name lookups against resolved handles for the same constant buffer writes
+void benchmarkConstantUpdates(ConstantBuffer& constantBuffer, unsigned int iterations) {
+	ConstantBufferHandle timeHandle = constantBuffer.getHandle("time");
+	ConstantBufferHandle lightsHandle = constantBuffer.getHandle("lights");
+	float time = 0.f;
+	Vec4 lights[4];
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		time += 1.f;
+		constantBuffer.update("time", &time);
+		constantBuffer.update("lights", lights);
+	}
+	double stringNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++) {
+		time += 1.f;
+		constantBuffer.update(timeHandle, &time);
+		constantBuffer.update(lightsHandle, lights);
+	}
+	double handleNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+	double updates = 2.0 * iterations;
+	printf("constant buffer update ns: string %.2f handle %.2f (%.1fx)\n",
+		   stringNs / updates, handleNs / updates, (handleNs > 0.0) ? stringNs / handleNs : 0.0);
+}
+
+// Replays what the tracker queues and checks every barrier starts from the state the subresource is really in
+void checkBarrierMerging(Core& core) {
+	GPUResource* resource = core.device->createBuffer(GPU_HEAP_DEFAULT, 256, GPU_STATE_COPY_DEST);
+	resource->subresourceCount = 2;
+	const GPUResourceState A = GPU_STATE_COPY_DEST, B = GPU_STATE_PIXEL_SHADER_RESOURCE, C = GPU_STATE_RENDER_TARGET;
+
+	// Whole resource A->B, subresource 0 B->C, whole resource back to B (only subresource 0 moves), then to A
+	ResourceStateTracker tracker;
+	tracker.transition(resource, B);
+	tracker.transition(resource, C, 0);
+	tracker.transition(resource, B);
+	tracker.transition(resource, A);
+
+	GPUResourceState actual[2] = { A, A };
+	unsigned int invalid = 0, recorded = 0;
+	for (const GPUBarrier& barrier : tracker.pending) {
+		if (barrier.before == barrier.after) continue;  // flush() drops these
+		recorded++;
+		for (unsigned int s = 0; s < 2; s++) {
+			if (barrier.subresource != GPU_ALL_SUBRESOURCES && barrier.subresource != s) continue;
+			if (actual[s] != barrier.before) invalid++;
+			actual[s] = barrier.after;
+		}
+	}
+	tracker.commit();
+	bool final = actual[0] == A && actual[1] == A && resource->state == A && resource->subresourceStates.empty();
+	printf("barrier merging: %u barriers, %u start from the wrong state, final states %s\n", recorded, invalid, final ? "match" : "DIFFER");
+	delete resource;
+}
+
+// A placed buffer deleted while its frame is being recorded must not give its memory to the next allocation
+void checkDeferredRelease(Core& core) {
+	core.beginFrame();
+	GPUResource* deleted = core.memory.createBuffer(GPU_HEAP_DEFAULT, 4096, GPU_STATE_COMMON);
+	uint64_t address = deleted->getGPUAddress();
+	delete deleted;
+	GPUResource* sameFrame = core.memory.createBuffer(GPU_HEAP_DEFAULT, 4096, GPU_STATE_COMMON);
+	bool aliased = sameFrame->getGPUAddress() == address;
+	uint64_t retiring = core.memory.stats.retiringBlocks;
+	core.finishFrame();
+	core.flushGraphicsQueue();
+
+	core.beginFrame();
+	GPUResource* nextFrame = core.memory.createBuffer(GPU_HEAP_DEFAULT, 4096, GPU_STATE_COMMON);
+	bool reused = nextFrame->getGPUAddress() == address;
+	core.finishFrame();
+	core.flushGraphicsQueue();
+	delete sameFrame;
+	delete nextFrame;
+
+	// An upload flushed on the graphics queue before the frame is submitted signals the same fence,
+	// the deleted block still has to wait for the frame's own value
+	NullDevice* nullDevice = (NullDevice*)core.device;
+	unsigned int latency = nullDevice->gpuLatency;
+	nullDevice->gpuLatency = 4;
+	GPUResource* uploaded = core.memory.createBuffer(GPU_HEAP_DEFAULT, 256, GPU_STATE_COMMON);
+	unsigned char data[256] = {};
+	core.beginFrame();
+	GPUResource* deletedBeforeUpload = core.memory.createBuffer(GPU_HEAP_DEFAULT, 4096, GPU_STATE_COMMON);
+	address = deletedBeforeUpload->getGPUAddress();
+	delete deletedBeforeUpload;
+	core.uploads.queueBuffer(uploaded, data, sizeof(data), GPU_STATE_COMMON);
+	core.uploads.flush();
+	core.finishFrame();
+	uint64_t frameValue = core.frameFenceValues[(core.frameSlot + core.framesInFlight - 1) % core.framesInFlight];
+	core.beginFrame();
+	GPUResource* afterUpload = core.memory.createBuffer(GPU_HEAP_DEFAULT, 4096, GPU_STATE_COMMON);
+	bool early = !core.graphicsQueueFence.isComplete(frameValue) && (core.memory.stats.retiringBlocks == 0 || afterUpload->getGPUAddress() == address);
+	core.finishFrame();
+	core.flushGraphicsQueue();
+	nullDevice->gpuLatency = latency;
+	delete afterUpload;
+	delete uploaded;
+
+	printf("deferred release: same frame %s, %llu block retiring, after the frame completed %s, upload flushed mid-frame %s\n",
+		   aliased ? "ALIASED" : "got new memory", (unsigned long long)retiring, reused ? "memory reused" : "memory NOT reused",
+		   early ? "REUSED EARLY" : "kept until the frame completed");
+}
+
+// Time loading many small meshes one submission at a time versus as one upload batch
+void benchmarkMeshUploads(Core& core, unsigned int meshCount) {
+	std::vector<ScreenSpaceTriangle> meshes(meshCount);
+	for (int batched = 0; batched < 2; batched++) {
+		uint64_t submits = core.uploads.stats.submits;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (batched) core.beginUploads();
+		for (ScreenSpaceTriangle& mesh : meshes) mesh.initialize(&core);
+		if (batched) core.endUploads();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("%s upload of %u meshes: %.3f ms, %llu submits\n", batched ? "batched" : "unbatched", meshCount, ms,
+			   (unsigned long long)(core.uploads.stats.submits - submits));
+	}
+}
+
+// Optimise a shuffled grid (like a badly exported model) and draw it indexed
+void benchmarkMeshOptimizer(Core& core, Primitive& primitive, unsigned int gridSize) {
+	std::vector<PRIM_VERTEX> vertices((gridSize + 1) * (gridSize + 1));
+	for (unsigned int y = 0; y <= gridSize; y++) {
+		for (unsigned int x = 0; x <= gridSize; x++) {
+			PRIM_VERTEX& v = vertices[y * (gridSize + 1) + x];
+			v.position = Vec3((float)x / gridSize * 2.0f - 1.0f, (float)y / gridSize * 2.0f - 1.0f, 0);
+			v.colour = Colour((float)x / gridSize, (float)y / gridSize, 0);
+		}
+	}
+	std::vector<unsigned int> indices;
+	for (unsigned int y = 0; y < gridSize; y++) {
+		for (unsigned int x = 0; x < gridSize; x++) {
+			unsigned int i = y * (gridSize + 1) + x;
+			unsigned int quad[6] = { i, i + gridSize + 1, i + 1, i + 1, i + gridSize + 1, i + gridSize + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	unsigned int seed = 7;
+	for (size_t t = indices.size() / 3 - 1; t > 0; t--) {
+		seed = seed * 1664525u + 1013904223u;
+		size_t other = (seed >> 8) % (t + 1);
+		for (int k = 0; k < 3; k++) std::swap(indices[t * 3 + k], indices[other * 3 + k]);
+	}
+
+	Mesh mesh;
+	auto start = std::chrono::high_resolution_clock::now();
+	core.beginUploads();
+	mesh.initialize(&core, &vertices[0], sizeof(PRIM_VERTEX), (int)vertices.size(), &indices[0], (int)indices.size());
+	core.endUploads();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	NullDevice* nullDevice = (NullDevice*)core.device;
+	uint64_t indicesDrawn = nullDevice->stats.indicesDrawn;
+	core.beginFrame();
+	primitive.draw(&core);
+	mesh.draw(&core);
+	core.finishFrame();
+
+	printf("mesh %u tris, %u verts, %s indices: optimise+upload %.2f ms, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, drew %llu indices\n",
+		   mesh.numIndices / 3, mesh.numVertices, (mesh.ibView.format == GPU_FORMAT_R16_UINT) ? "16-bit" : "32-bit", ms,
+		   mesh.cacheStatsBefore.acmr, mesh.cacheStatsAfter.acmr, mesh.cacheStatsBefore.atvr, mesh.cacheStatsAfter.atvr,
+		   (unsigned long long)(nullDevice->stats.indicesDrawn - indicesDrawn));
+}
+
+// A trailing partial triangle and a triangle past the last vertex are dropped before the optimisers see them
+void checkMeshIndexValidation(Core& core) {
+	PRIM_VERTEX vertices[4] = {};
+	unsigned int indices[11] = { 0, 1, 2, 2, 1, 3, 1, 3, 9, 3, 0 };
+	Mesh mesh;
+	core.beginUploads();
+	mesh.initialize(&core, vertices, sizeof(PRIM_VERTEX), 4, indices, 11);
+	core.endUploads();
+	printf("mesh index validation: 11 indices with one triangle past 4 vertices -> %u indices %u vertices (expected 6 and 4)\n",
+		   mesh.numIndices, mesh.numVertices);
+}
+
+// Random allocate/free traffic against the CPU side of the heap allocator
+void benchmarkHeapAllocator(unsigned int operations) {
+	TLSFAllocator allocator;
+	allocator.initialize(256ull * 1024 * 1024, 256);
+	std::vector<TLSFAllocation> live;
+	unsigned int seed = 1, failures = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < operations; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		// Hover around 2048 live allocations so the heap churns rather than fills
+		if (live.empty() || (live.size() < 2048 && (seed >> 16) % 4 != 0)) {
+			// Mostly small vertex/constant sized blocks with the odd large one
+			uint64_t size = ((seed >> 8) % 64 == 0) ? 256 * 1024 + (seed % (1 << 20)) : 256 + (seed % (64 * 1024));
+			uint64_t alignment = 256ull << ((seed >> 4) % 4);
+			TLSFAllocation allocation;
+			if (allocator.allocate(size, alignment, allocation)) live.push_back(allocation);
+			else failures++;
+		} else {
+			unsigned int index = (seed >> 8) % live.size();
+			allocator.free(live[index].block);
+			live[index] = live.back();
+			live.pop_back();
+		}
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+	const TLSFStats& stats = allocator.getStats();
+	printf("tlsf %u ops: %.1f ns/op, live %llu, used %.1f MB, free blocks %llu, fragmentation %.3f, failures %u\n",
+		   operations, ns / operations, (unsigned long long)stats.allocations, stats.usedBytes / (1024.0 * 1024.0),
+		   (unsigned long long)stats.freeBlocks, stats.fragmentation(), failures);
+}
+
+// Stream a new mesh in on the copy queue every frame and draw it the frame after
+void benchmarkStreaming(Core& core, Primitive& primitive, unsigned int frames) {
+	std::vector<ScreenSpaceTriangle> meshes(frames);
+	core.streamingTotal = {};
+	float time = 0.f;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		time += 1.f / 60.f;
+		updateConstants(primitive, time, 1024, 1024);
+		core.beginUploads(true);
+		meshes[frame].initialize(&core);
+		core.endUploads();
+
+		core.beginFrame();
+		primitive.draw(&core);
+		if (frame > 0) meshes[frame - 1].draw(&core);
+		core.finishFrame();
+	}
+	core.flushGraphicsQueue();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	const StreamingFrameStats& stats = core.streamingTotal;
+	double perFrame = (frames > 0) ? 1.0 / frames : 0.0;
+	printf("streaming %u frames: cpu frame ms %.5f, copy submits %.2f, bytes %.1f per frame\n", frames, ms * perFrame,
+		   stats.submits * perFrame, stats.bytes * perFrame);
+	printf("streaming first uses %llu: overlapped %llu serialized %llu, frames with copies in flight %llu\n",
+		   (unsigned long long)stats.firstUses, (unsigned long long)stats.overlapped,
+		   (unsigned long long)stats.serialized, (unsigned long long)stats.copiesInFlight);
+}
+
+void runGPUBenchmarks(Core& core, Primitive& primitive) {
+	checkBarrierMerging(core);
+	checkDeferredRelease(core);
+	benchmarkConstantUpdates(primitive.constantBuffer, 1000000);
+	benchmarkMeshUploads(core, 1000);
+	benchmarkStreaming(core, primitive, 1000);
+	benchmarkHeapAllocator(1000000);
+	benchmarkMeshOptimizer(core, primitive, 100);
+	benchmarkMeshOptimizer(core, primitive, 400);
+	checkMeshIndexValidation(core);
+}
+#endif
@@ -0,0 +1,320 @@
+#ifndef _WIN32
+// Headless benchmarks: MyMath SIMD paths, AffineMatrix, vector streams and the transform hierarchy
+#include "Benchmarks.h"
+#include "Core.h"
+#include "MyMath.h"
+#include "NullDevice.h"
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+#include "VectorStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Time the SIMD Matrix paths against the scalar ones and check they agree bit for bit
+void benchmarkMatrixMath(unsigned int count) {
+	// Random affine matrices (rotation, scale, translation) and points
+	std::vector<Matrix> matrices(count);
+	std::vector<Vec3> points(count);
+	unsigned int seed = 3;
+	auto random = [&seed](float range) {
+		seed = seed * 1664525u + 1013904223u;
+		return ((seed >> 8) / 16777216.0f * 2.f - 1.f) * range;
+	};
+	for (unsigned int i = 0; i < count; i++) {
+		matrices[i] = Matrix::rotateOnXAxis(random(3.f)).mul(Matrix::rotateOnYAxis(random(3.f))).mul(Matrix::scale(1.f + random(0.5f)));
+		matrices[i][3] = random(100.f); matrices[i][7] = random(100.f); matrices[i][11] = random(100.f);
+		points[i] = Vec3(random(10.f), random(10.f), random(10.f));
+	}
+	std::vector<Matrix> simdMatrices(count), scalarMatrices(count);
+	std::vector<Vec4> simdVectors(count), scalarVectors(count);
+
+	unsigned int mismatches[4] = {};
+	float inverseError = 0.f;
+	for (unsigned int i = 0; i < count; i++) {
+		const Matrix& a = matrices[i];
+		const Matrix& b = matrices[(i + 1) % count];
+		Vec4 v(points[i].x, points[i].y, points[i].z, random(2.f));
+		Matrix product = a.mul(b), productScalar = a.mulScalar(b);
+		Vec4 vector = a.mul(v), vectorScalar = a.mulScalar(v);
+		Matrix inverse = a.invertAffine(), inverseScalar = a.invertAffineScalar();
+		if (memcmp(&product, &productScalar, sizeof(Matrix)) != 0) mismatches[0]++;
+		if (memcmp(&vector, &vectorScalar, sizeof(Vec4)) != 0) mismatches[1]++;
+		if (memcmp(&inverse, &inverseScalar, sizeof(Matrix)) != 0) mismatches[2]++;
+		Matrix general = Matrix(a).invert();
+		for (int j = 0; j < 16; j++) inverseError = std::max<float>(inverseError, fabsf(general[j] - inverse[j]));
+	}
+	transformPoints(matrices[0], &points[0], &simdVectors[0], count);
+	for (unsigned int i = 0; i < count; i++) {
+		scalarVectors[i] = matrices[0].mulScalar(Vec4(points[i].x, points[i].y, points[i].z, 1.f));
+		if (memcmp(&simdVectors[i], &scalarVectors[i], sizeof(Vec4)) != 0) mismatches[3]++;
+	}
+
+	// ns per call of f, over every index a few times so the data is warm in cache
+	const unsigned int passes = 64;
+	auto time = [count](auto f) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int pass = 0; pass < passes; pass++)
+			for (unsigned int i = 0; i < count; i++) f(i);
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / (count * passes);
+	};
+	unsigned int mask = count - 1;  // count is a power of two
+	double mulNs[2], vecNs[2], inverseNs[2], batchNs[2];
+	mulNs[0] = time([&](unsigned int i) { scalarMatrices[i] = matrices[i].mulScalar(matrices[(i + 1) & mask]); });
+	mulNs[1] = time([&](unsigned int i) { simdMatrices[i] = matrices[i].mul(matrices[(i + 1) & mask]); });
+	vecNs[0] = time([&](unsigned int i) { scalarVectors[i] = matrices[i].mulScalar(scalarVectors[i]); });
+	vecNs[1] = time([&](unsigned int i) { simdVectors[i] = matrices[i].mul(simdVectors[i]); });
+	inverseNs[0] = time([&](unsigned int i) { scalarMatrices[i] = matrices[i].invertAffineScalar(); });
+	inverseNs[1] = time([&](unsigned int i) { simdMatrices[i] = matrices[i].invertAffine(); });
+	batchNs[0] = time([&](unsigned int i) { scalarVectors[i] = matrices[0].mulScalar(Vec4(points[i].x, points[i].y, points[i].z, 1.f)); });
+	batchNs[1] = time([&](unsigned int i) { if (i == 0) transformPoints(matrices[0], &points[0], &simdVectors[0], count); });
+
+	// Matrix::mul only has a SIMD kernel with AVX, elsewhere both columns time the scalar code
+#if defined(MYMATH_AVX)
+	const char* path = "avx";
+#elif defined(MYMATH_SSE)
+	const char* path = "sse";
+#else
+	const char* path = "scalar";
+#endif
+	printf("matrix math (%s) mismatches vs scalar: mul %u vec %u affine inverse %u transformPoints %u, affine vs general inverse max error %g\n",
+		   path, mismatches[0], mismatches[1], mismatches[2], mismatches[3], inverseError);
+	printf("matrix math ns scalar -> simd: mul %.2f -> %.2f, vec %.2f -> %.2f, affine inverse %.2f -> %.2f, transformPoints %.2f -> %.2f\n",
+		   mulNs[0], mulNs[1], vecNs[0], vecNs[1], inverseNs[0], inverseNs[1], batchNs[0], batchNs[1]);
+}
+
+// AffineMatrix against Matrix for the same transforms, and the upload size of per-object matrices
+void benchmarkAffineMatrix(Core& core, unsigned int count, unsigned int instances) {
+	std::vector<Matrix> matrices(count), results(count);
+	std::vector<AffineMatrix> affines(count), affineResults(count);
+	unsigned int seed = 20;
+	auto random = [&seed](float range) {
+		seed = seed * 1664525u + 1013904223u;
+		return ((seed >> 8) / 16777216.0f * 2.f - 1.f) * range;
+	};
+	for (unsigned int i = 0; i < count; i++) {
+		matrices[i] = Matrix::rotateOnXAxis(random(3.f)).mul(Matrix::rotateOnYAxis(random(3.f)));
+		// A different scale per axis, so columns stay perpendicular but not unit length
+		for (int axis = 0; axis < 3; axis++) {
+			float scale = 1.f + random(0.5f);
+			matrices[i][axis] *= scale; matrices[i][axis + 4] *= scale; matrices[i][axis + 8] *= scale;
+		}
+		matrices[i][3] = random(100.f); matrices[i][7] = random(100.f); matrices[i][11] = random(100.f);
+		affines[i] = AffineMatrix(matrices[i]);
+	}
+
+	// Products have to equal Matrix::mul, inverses come out close to the general one
+	unsigned int mismatches[3] = {};
+	float inverseError = 0.f;
+	for (unsigned int i = 0; i < count; i++) {
+		const AffineMatrix& a = affines[i];
+		const AffineMatrix& b = affines[(i + 1) % count];
+		AffineMatrix product = a.mul(b), productScalar = a.mulScalar(b);
+		Matrix full = matrices[i].mul(matrices[(i + 1) % count]);
+		AffineMatrix inverse = a.invertOrthogonal(), inverseScalar = a.invertOrthogonalScalar();
+		if (memcmp(&product, &productScalar, sizeof(AffineMatrix)) != 0) mismatches[0]++;
+		if (memcmp(&inverse, &inverseScalar, sizeof(AffineMatrix)) != 0) mismatches[1]++;
+		for (int j = 0; j < 12; j++) if (product.m[j] != full.m[j]) { mismatches[2]++; break; }
+		Matrix general = Matrix(matrices[i]).invert();
+		for (int j = 0; j < 12; j++) inverseError = std::max<float>(inverseError, fabsf(general[j] - inverse[j]));
+	}
+
+	const unsigned int passes = 64;
+	auto time = [count](auto f) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int pass = 0; pass < passes; pass++)
+			for (unsigned int i = 0; i < count; i++) f(i);
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / (count * passes);
+	};
+	unsigned int mask = count - 1;  // count is a power of two
+	double mulNs[2], inverseNs[3];
+	mulNs[0] = time([&](unsigned int i) { results[i] = matrices[i].mul(matrices[(i + 1) & mask]); });
+	mulNs[1] = time([&](unsigned int i) { affineResults[i] = affines[i].mul(affines[(i + 1) & mask]); });
+	inverseNs[0] = time([&](unsigned int i) { results[i] = matrices[i].invert(); });
+	inverseNs[1] = time([&](unsigned int i) { results[i] = matrices[i].invertAffine(); });
+	inverseNs[2] = time([&](unsigned int i) { affineResults[i] = affines[i].invertOrthogonal(); });
+
+	// One world matrix per instance written into the frame's upload ring, as 64 then 48 bytes
+	double uploadMs[2];
+	uint64_t uploadBytes[2];
+	for (int affine = 0; affine < 2; affine++) {
+		size_t stride = affine ? sizeof(AffineMatrix) : sizeof(Matrix);
+		uploadBytes[affine] = (uint64_t)stride * instances;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < 20; frame++) {
+			core.beginFrame();
+			UploadAllocation allocation = core.constantBufferRing.allocate(uploadBytes[affine], 256);
+			for (unsigned int i = 0; i < instances; i++) {
+				const void* source = affine ? (const void*)affines[i & mask].m : (const void*)matrices[i & mask].m;
+				memcpy(allocation.cpu + i * stride, source, stride);
+			}
+			core.finishFrame();
+		}
+		uploadMs[affine] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / 20;
+	}
+	core.flushGraphicsQueue();
+
+	printf("affine matrix mismatches: mul vs scalar %u, inverse vs scalar %u, mul vs Matrix %u, orthogonal vs general inverse max error %g\n",
+		   mismatches[0], mismatches[1], mismatches[2], inverseError);
+	printf("affine matrix ns Matrix -> AffineMatrix: mul %.2f -> %.2f, inverse %.2f (general) %.2f (affine) -> %.2f (orthogonal)\n",
+		   mulNs[0], mulNs[1], inverseNs[0], inverseNs[1], inverseNs[2]);
+	printf("affine matrix upload %u instances: %.1f KB %.3f ms as Matrix, %.1f KB %.3f ms as AffineMatrix\n",
+		   instances, uploadBytes[0] / 1024.0, uploadMs[0], uploadBytes[1] / 1024.0, uploadMs[1]);
+}
+
+// Run the same bulk vector work over Vec3 arrays and over Vec3Streams, checking they agree
+void benchmarkVectorStreams(unsigned int count) {
+	std::vector<Vec3> a(count), b(count), result(count);
+	unsigned int seed = 5;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return ((seed >> 8) / 16777216.0f * 2.f - 1.f) * 50.f;
+	};
+	for (unsigned int i = 0; i < count; i++) {
+		a[i] = Vec3(random(), random(), random());
+		b[i] = Vec3(random(), random(), random());
+	}
+	std::vector<float> dots(count);
+	Vec3Stream sa, sb, sresult;
+	FloatStream sdots;
+	sa.fromAoS(&a[0], count);
+	sb.fromAoS(&b[0], count);
+
+	const unsigned int passes = 64;
+	auto time = [count](auto f) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int pass = 0; pass < passes; pass++) f();
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / (count * passes);
+	};
+	unsigned int mismatches = 0;
+	auto compare = [&]() {
+		for (unsigned int i = 0; i < count; i++) {
+			Vec3 s = sresult.get(i);
+			if (memcmp(&s, &result[i], sizeof(Vec3)) != 0) mismatches++;
+		}
+	};
+
+	double ns[5][2];
+	ns[0][0] = time([&]() { for (unsigned int i = 0; i < count; i++) result[i] = a[i] + b[i]; });
+	ns[0][1] = time([&]() { Add(sa, sb, sresult); });
+	compare();
+	ns[1][0] = time([&]() { for (unsigned int i = 0; i < count; i++) dots[i] = Dot(a[i], b[i]); });
+	ns[1][1] = time([&]() { Dot(sa, sb, sdots); });
+	for (unsigned int i = 0; i < count; i++)
+		if (memcmp(&sdots[i], &dots[i], sizeof(float)) != 0) mismatches++;
+	ns[2][0] = time([&]() { for (unsigned int i = 0; i < count; i++) result[i] = Cross(a[i], b[i]); });
+	ns[2][1] = time([&]() { Cross(sa, sb, sresult); });
+	compare();
+	// Vec3::normalize goes through the double sqrt, so only expect it to within an ulp or so
+	ns[3][0] = time([&]() { for (unsigned int i = 0; i < count; i++) result[i] = a[i].normalize(); });
+	ns[3][1] = time([&]() { Normalize(sa, sresult); });
+	float normalizeError = 0.f;
+	for (unsigned int i = 0; i < count; i++)
+		for (int c = 0; c < 3; c++) normalizeError = std::max<float>(normalizeError, fabsf(sresult.get(i).v[c] - result[i].v[c]));
+	ns[4][0] = time([&]() { for (unsigned int i = 0; i < count; i++) result[i] = Min(a[i], b[i]); });
+	ns[4][1] = time([&]() { Min(sa, sb, sresult); });
+	compare();
+
+	// Round trip back to AoS and a bounds reduction against the plain loop
+	Vec3 lo = a[0], hi = a[0], streamLo, streamHi;
+	for (unsigned int i = 1; i < count; i++) {
+		lo = Min(lo, a[i]);
+		hi = Max(hi, a[i]);
+	}
+	Bounds(sa, streamLo, streamHi);
+	if (memcmp(&lo, &streamLo, sizeof(Vec3)) != 0 || memcmp(&hi, &streamHi, sizeof(Vec3)) != 0) mismatches++;
+	sa.toAoS(&result[0]);
+	if (memcmp(&result[0], &a[0], count * sizeof(Vec3)) != 0) mismatches++;
+
+	// Normalize leaves NaN in the padding, growing into it within capacity has to read 0
+	Normalize(sa, sresult);
+	sresult.resize(sresult.storage.capacity);
+	for (size_t i = count; i < sresult.size(); i++)
+		if (sresult.x[i] != 0.f || sresult.y[i] != 0.f || sresult.z[i] != 0.f) mismatches++;
+
+	printf("vector streams %u x %u lanes, mismatches vs Vec3 %u, normalize max error %g\n", count, (unsigned int)LANE_WIDTH, mismatches, normalizeError);
+	printf("vector streams ns per element aos -> soa: add %.2f -> %.2f, dot %.2f -> %.2f, cross %.2f -> %.2f, normalize %.2f -> %.2f, min %.2f -> %.2f\n",
+		   ns[0][0], ns[0][1], ns[1][0], ns[1][1], ns[2][0], ns[2][1], ns[3][0], ns[3][1], ns[4][0], ns[4][1]);
+}
+
+void benchmarkTransformHierarchy(ThreadPool& pool, unsigned int rootCount) {
+	// Each root carries 4 children with 4 children each with 2 leaves, 53 nodes per root
+	TransformHierarchy hierarchy;
+	std::vector<unsigned int> roots, leaves;
+	for (unsigned int r = 0; r < rootCount; r++) {
+		Matrix rootLocal = Matrix::rotateOnYAxis((float)r * 0.1f);
+		rootLocal[3] = (float)(r % 64) * 4.f;
+		rootLocal[11] = (float)(r / 64) * 4.f;
+		unsigned int root = hierarchy.addNode(-1, rootLocal);
+		roots.push_back(root);
+		for (int c = 0; c < 4; c++) {
+			unsigned int child = hierarchy.addNode((int)root, Matrix::rotateOnZAxis((float)c * 0.5f).mul(Matrix::translate(1.f)));
+			for (int g = 0; g < 4; g++) {
+				unsigned int grandchild = hierarchy.addNode((int)child, Matrix::rotateOnXAxis((float)g * 0.3f).mul(Matrix::scale(0.5f)));
+				for (int l = 0; l < 2; l++) leaves.push_back(hierarchy.addNode((int)grandchild, Matrix::translate((float)l + 0.5f)));
+			}
+		}
+	}
+	hierarchy.update();
+
+	// Static frame, a few animated roots, scattered leaves, then everything
+	const char* labels[4] = { "static", "1% roots", "1% leaves", "all" };
+	unsigned int frames = 20;
+	for (int scenario = 0; scenario < 4; scenario++) {
+		double ms[2] = { 0.0, 0.0 };
+		for (int parallel = 0; parallel < 2; parallel++) {
+			for (unsigned int frame = 0; frame < frames; frame++) {
+				float angle = (float)frame * 0.01f;
+				if (scenario == 1) {
+					for (unsigned int r = frame % 100; r < rootCount; r += 100) hierarchy.setLocal(roots[r], Matrix::rotateOnYAxis(angle).mul(hierarchy.locals[roots[r]]));
+				} else if (scenario == 2) {
+					for (unsigned int l = frame % 100; l < leaves.size(); l += 100) hierarchy.setLocal(leaves[l], Matrix::rotateOnZAxis(angle).mul(hierarchy.locals[leaves[l]]));
+				} else if (scenario == 3) {
+					for (unsigned int node = 0; node < hierarchy.size(); node++) hierarchy.setLocal(node, hierarchy.locals[node]);
+				}
+				hierarchy.update(parallel ? &pool : NULL);
+				ms[parallel] += hierarchy.stats.updateMs;
+			}
+		}
+		printf("transform hierarchy %u nodes, %s: recomputed %llu skipped %llu (%llu ranges, %llu jobs), %.4f ms serial %.4f ms on %u threads\n",
+			   hierarchy.size(), labels[scenario], (unsigned long long)hierarchy.stats.recomputed, (unsigned long long)hierarchy.stats.skipped,
+			   (unsigned long long)hierarchy.stats.rangesUpdated, (unsigned long long)hierarchy.stats.jobs, ms[0] / frames, ms[1] / frames, pool.threadCount());
+	}
+
+	// One root over everything, added breadth first so no subtree is contiguous in node order.
+	// Moving the root makes one range far bigger than a job, split below the root for the pool.
+	TransformHierarchy wide;
+	wide.addNode(-1, Matrix::translate(1.f));
+	for (unsigned int level = 0, first = 0, count = 1; level < 3; level++, first += count, count *= 16)
+		for (unsigned int c = 0; c < count * 16; c++) wide.addNode((int)(first + c % count), Matrix::rotateOnZAxis((float)c * 0.1f).mul(Matrix::translate(0.5f)));
+	wide.update();
+	wide.setLocal(0, Matrix::rotateOnYAxis(0.3f));
+	wide.setLocal(wide.size() - 1, Matrix::scale(2.f));  // Nested in the root's range
+	wide.update(&pool);
+	printf("transform hierarchy %u nodes under one root, root moved: recomputed %llu (%llu ranges, %llu jobs)\n", wide.size(),
+		   (unsigned long long)wide.stats.recomputed, (unsigned long long)wide.stats.rangesUpdated, (unsigned long long)wide.stats.jobs);
+
+	// Every world has to match a full rebuild in node order
+	unsigned int mismatches = 0;
+	for (TransformHierarchy* checked : { &hierarchy, &wide }) {
+		std::vector<Matrix> reference(checked->size());
+		for (unsigned int node = 0; node < checked->size(); node++) {
+			int parent = checked->parents[node];
+			reference[node] = (parent >= 0) ? reference[parent].mul(checked->locals[node]) : checked->locals[node];
+			if (memcmp(reference[node].m, checked->getWorld(node).m, sizeof(reference[node].m)) != 0) mismatches++;
+		}
+	}
+	printf("transform hierarchy mismatches vs full rebuild: %u\n", mismatches);
+}
+
+void runMathBenchmarks(Core& core, ThreadPool& pool) {
+	benchmarkMatrixMath(4096);
+	benchmarkAffineMatrix(core, 4096, 100000);
+	benchmarkVectorStreams(4099);
+	benchmarkTransformHierarchy(pool, 2000);
+}
+#endif
@@ -0,0 +1,494 @@
+#ifndef _WIN32
+// Headless benchmarks: Software rasteriser, clipping, occlusion and frustum culling
+#include "Benchmarks.h"
+#include "Core.h"
+#include "FrustumCulling.h"
+#include "NullDevice.h"
+#include "OcclusionCuller.h"
+#include "Primitive.h"
+#include "SoftwareRasteriser.h"
+#include "ThreadPool.h"
+#include "VectorStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Full-screen grids stacked in depth (drawn in a scrambled order for overdraw) plus a cloud of small triangles
+struct RasterScene {
+	std::vector<Vec3> positions;
+	std::vector<Colour> colours;
+	std::vector<unsigned int> gridIndices;
+	std::vector<unsigned int> cloudIndices;
+	std::vector<Matrix> layers;  // World matrix of each grid
+	unsigned int triangleCount;
+
+	void build(unsigned int gridSize, unsigned int layerCount, unsigned int cloudTriangles) {
+		unsigned int seed = 11;
+		auto random = [&seed]() {
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8) / 16777216.0f;
+		};
+		for (unsigned int y = 0; y <= gridSize; y++) {
+			for (unsigned int x = 0; x <= gridSize; x++) {
+				positions.push_back(Vec3((float)x / gridSize * 2.f - 1.f, (float)y / gridSize * 2.f - 1.f, 0.f));
+				colours.push_back(Colour(random(), random(), random()));
+			}
+		}
+		for (unsigned int y = 0; y < gridSize; y++) {
+			for (unsigned int x = 0; x < gridSize; x++) {
+				unsigned int i = y * (gridSize + 1) + x;
+				unsigned int quad[6] = { i, i + gridSize + 1, i + 1, i + 1, i + gridSize + 1, i + gridSize + 2 };
+				gridIndices.insert(gridIndices.end(), quad, quad + 6);
+			}
+		}
+		// Layer k sits at depth 4 + 2k and is scaled to just overfill a 90 degree view
+		for (unsigned int k = 0; k < layerCount; k++) {
+			unsigned int layer = (k * 5 + 3) % layerCount;
+			float depth = 4.f + 2.f * layer;
+			Matrix world = Matrix::scale(depth * 1.1f);
+			world[11] = depth;
+			layers.push_back(world);
+		}
+		// Small triangles, a few pixels across, in front of everything
+		for (unsigned int t = 0; t < cloudTriangles; t++) {
+			Vec3 centre((random() * 2.f - 1.f) * 2.5f, (random() * 2.f - 1.f) * 2.5f, 3.f);
+			for (int k = 0; k < 3; k++) {
+				cloudIndices.push_back((unsigned int)positions.size());
+				positions.push_back(centre + Vec3((random() - 0.5f) * 0.06f, (random() - 0.5f) * 0.06f, 0.f));
+				colours.push_back(Colour(random(), random(), random()));
+			}
+		}
+		triangleCount = (unsigned int)(gridIndices.size() / 3 * layerCount + cloudIndices.size() / 3);
+	}
+
+	void draw(SoftwareRasteriser& rasteriser, const Matrix& viewProjection) const {
+		for (const Matrix& world : layers)
+			rasteriser.drawIndexed(viewProjection.mul(world), &positions[0], &colours[0], (unsigned int)positions.size(),
+								   &gridIndices[0], (unsigned int)gridIndices.size());
+		rasteriser.drawIndexed(viewProjection, &positions[0], &colours[0], (unsigned int)positions.size(),
+							   &cloudIndices[0], (unsigned int)cloudIndices.size());
+	}
+};
+
+uint64_t hashImage(const std::vector<uint32_t>& pixels) {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t pixel : pixels) hash = (hash ^ pixel) * 1099511628211ull;
+	return hash;
+}
+
+// Render the scene on one thread and on the whole pool, report throughput and check both images agree
+void benchmarkSoftwareRasteriser(ThreadPool& pool, unsigned int frames) {
+	const int width = 512, height = 512;
+	RasterScene scene;
+	scene.build(64, 8, 20000);
+	Matrix viewProjection = Matrix::projection(width, height, 100.f, 0.1f).mul(Matrix::lookAt(Vec3(0, 0, 0), Vec3(0, 0, 1), Vec3(0, 1, 0)));
+
+	ThreadPool serial;
+	ThreadPool* pools[2] = { &serial, &pool };
+	uint64_t hashes[2];
+	for (int p = 0; p < 2; p++) {
+		SoftwareRasteriser rasteriser;
+		rasteriser.initialize(width, height, pools[p]);
+		RasterStats total = {};
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++) {
+			rasteriser.beginFrame();
+			scene.draw(rasteriser, viewProjection);
+			rasteriser.endFrame();
+			total.trianglesIn += rasteriser.stats.trianglesIn;
+			total.pixelsCovered += rasteriser.stats.pixelsCovered;
+			total.pixelsShaded += rasteriser.stats.pixelsShaded;
+			total.binMs += rasteriser.stats.binMs;
+			total.rasterMs += rasteriser.stats.rasterMs;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		hashes[p] = hashImage(rasteriser.colourBuffer);
+		printf("software raster %dx%d, %u threads: %.2f Mtris/s, %.1f Mpx/s covered, %.3f shaded per covered, ms per frame bin %.2f raster %.2f, culled %llu, tile bins %llu\n",
+			   width, height, pools[p]->threadCount(), total.trianglesIn / seconds * 1e-6, total.pixelsCovered / seconds * 1e-6,
+			   total.pixelsCovered ? (double)total.pixelsShaded / total.pixelsCovered : 0.0, total.binMs / frames, total.rasterMs / frames,
+			   (unsigned long long)rasteriser.stats.trianglesCulled, (unsigned long long)rasteriser.stats.tileBins);
+	}
+	printf("software raster image %016llx, %s across thread counts\n", (unsigned long long)hashes[1], (hashes[0] == hashes[1]) ? "identical" : "DIFFERENT");
+}
+
+// Overdraw-heavy scene with and without Hi-Z, the images have to match
+void benchmarkHierarchicalZ(ThreadPool& pool, unsigned int frames) {
+	const int width = 512, height = 512;
+	RasterScene scene;
+	scene.build(64, 16, 20000);
+	Matrix viewProjection = Matrix::projection(width, height, 100.f, 0.1f).mul(Matrix::lookAt(Vec3(0, 0, 0), Vec3(0, 0, 1), Vec3(0, 1, 0)));
+
+	SoftwareRasteriser rasteriser;
+	rasteriser.initialize(width, height, &pool);
+	uint64_t hashes[2];
+	for (int enabled = 0; enabled < 2; enabled++) {
+		rasteriser.hierarchicalZ = enabled != 0;
+		double ms = 0.0;
+		for (unsigned int frame = 0; frame < frames; frame++) {
+			rasteriser.beginFrame();
+			scene.draw(rasteriser, viewProjection);
+			rasteriser.endFrame();
+			ms += rasteriser.stats.rasterMs / frames;
+		}
+		hashes[enabled] = hashImage(rasteriser.colourBuffer);
+		const RasterStats& stats = rasteriser.stats;
+		printf("hi-z %s: raster %.2f ms, %llu pixels depth tested, %llu shaded, %.3f shaded per tested, blocks occluded %llu depth passed %llu of %llu\n",
+			   enabled ? "on " : "off", ms, (unsigned long long)stats.pixelsCovered, (unsigned long long)stats.pixelsShaded,
+			   stats.pixelsCovered ? (double)stats.pixelsShaded / stats.pixelsCovered : 0.0, (unsigned long long)stats.blocksOccluded,
+			   (unsigned long long)stats.blocksDepthPassed, (unsigned long long)(stats.blocksAccepted + stats.blocksPartial));
+	}
+	printf("hi-z image %s\n", (hashes[0] == hashes[1]) ? "identical" : "DIFFERENT");
+}
+
+// Every raster mode for triangles of one size (in pixels) scattered over the screen
+void benchmarkRasterModes(ThreadPool& pool, const char* label, float size, unsigned int count) {
+	const int width = 512, height = 512;
+	std::vector<Vec3> positions;
+	std::vector<Colour> colours;
+	std::vector<unsigned int> indices;
+	unsigned int seed = 13;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / 16777216.0f;
+	};
+	// Straight to NDC, the identity transform leaves w at 1
+	for (unsigned int t = 0; t < count; t++) {
+		float cx = random() * width, cy = random() * height, depth = 0.1f + random() * 0.8f;
+		for (int k = 0; k < 3; k++) {
+			float x = cx + (random() - 0.5f) * size, y = cy + (random() - 0.5f) * size;
+			indices.push_back((unsigned int)positions.size());
+			positions.push_back(Vec3(x / width * 2.f - 1.f, 1.f - y / height * 2.f, depth));
+			colours.push_back(Colour(random(), random(), random()));
+		}
+	}
+
+	SoftwareRasteriser rasteriser;
+	rasteriser.initialize(width, height, &pool);
+	RasterMode modes[4] = { RASTER_SCALAR, RASTER_SIMD, RASTER_FIXED, RASTER_FIXED_SIMD };
+	double ms[4];
+	std::vector<uint32_t> images[4];
+	const unsigned int frames = 4;
+	for (int m = 0; m < 4; m++) {
+		rasteriser.mode = modes[m];
+		ms[m] = 0.0;
+		for (unsigned int frame = 0; frame < frames; frame++) {
+			rasteriser.beginFrame();
+			rasteriser.drawIndexed(Matrix(), &positions[0], &colours[0], (unsigned int)positions.size(), &indices[0], (unsigned int)indices.size());
+			rasteriser.endFrame();
+			ms[m] += rasteriser.stats.rasterMs / frames;
+		}
+		images[m] = rasteriser.colourBuffer;
+	}
+	// Block and per-pixel walks should only differ by float rounding, integer edges not at all
+	unsigned int different[2] = { 0, 0 };
+	for (size_t i = 0; i < images[0].size(); i++) {
+		if (images[0][i] != images[1][i]) different[0]++;
+		if (images[2][i] != images[3][i]) different[1]++;
+	}
+
+	const RasterStats& stats = rasteriser.stats;
+	double covered = (double)stats.pixelsCovered;
+	printf("raster %s tris (%.0f px, %u): scalar %.1f Mpx/s %.2f Mtris/s, simd x%u %.1f Mpx/s %.2f Mtris/s (%.2fx), blocks rejected %llu accepted %llu partial %llu, %u pixels differ\n",
+		   label, size, count, covered / ms[0] * 1e-3, count / ms[0] * 1e-3, (unsigned int)LANE_WIDTH, covered / ms[1] * 1e-3, count / ms[1] * 1e-3,
+		   ms[1] > 0.0 ? ms[0] / ms[1] : 0.0, (unsigned long long)stats.blocksRejected, (unsigned long long)stats.blocksAccepted,
+		   (unsigned long long)stats.blocksPartial, different[0]);
+	printf("raster %s tris fixed point: scalar %.1f Mpx/s %.2f Mtris/s (%.2fx float), simd x%u %.1f Mpx/s %.2f Mtris/s (%.2fx float), %u pixels differ\n",
+		   label, covered / ms[2] * 1e-3, count / ms[2] * 1e-3, ms[2] > 0.0 ? ms[0] / ms[2] : 0.0, (unsigned int)EDGE_LANE_WIDTH,
+		   covered / ms[3] * 1e-3, count / ms[3] * 1e-3, ms[3] > 0.0 ? ms[1] / ms[3] : 0.0, different[1]);
+}
+
+/*
+ *	Fill rule check: a full-screen mesh whose vertices all sit on pixel corners or pixel centres,
+ *	so many edges pass exactly through pixel centres. Each triangle is nearer than the last so
+ *	every covered pixel is shaded, then pixels still at the clear colour are holes and
+ *	covered - (width * height - holes) are pixels drawn twice.
+ */
+void benchmarkFillRule(ThreadPool& pool, unsigned int gridSize) {
+	const int width = 512, height = 512;
+	std::vector<Vec3> positions;
+	std::vector<Colour> colours;
+	std::vector<unsigned int> indices;
+	unsigned int seed = 17;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	float cell = (float)width / gridSize;
+	for (unsigned int y = 0; y <= gridSize; y++) {
+		for (unsigned int x = 0; x <= gridSize; x++) {
+			float px = x * cell, py = y * cell;
+			// Jitter the inside vertices by whole and half pixels, the border stays on the screen edge
+			if (x > 0 && x < gridSize) px += (float)((int)(random() % 5) - 2) * 0.5f;
+			if (y > 0 && y < gridSize) py += (float)((int)(random() % 5) - 2) * 0.5f;
+			positions.push_back(Vec3(px / width * 2.f - 1.f, 1.f - py / height * 2.f, 0.f));
+		}
+	}
+	for (unsigned int y = 0; y < gridSize; y++) {
+		for (unsigned int x = 0; x < gridSize; x++) {
+			unsigned int i = y * (gridSize + 1) + x;
+			// Alternate the diagonal so both directions get tested
+			if ((x + y) & 1) {
+				unsigned int quad[6] = { i, i + gridSize + 1, i + 1, i + 1, i + gridSize + 1, i + gridSize + 2 };
+				indices.insert(indices.end(), quad, quad + 6);
+			} else {
+				unsigned int quad[6] = { i, i + gridSize + 2, i + 1, i, i + gridSize + 1, i + gridSize + 2 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	// Unshare the vertices so each triangle gets its own depth
+	std::vector<Vec3> triangles;
+	for (size_t i = 0; i < indices.size(); i++) {
+		Vec3 p = positions[indices[i]];
+		p.z = 0.9f - (float)(i / 3) * 0.0002f;
+		triangles.push_back(p);
+		colours.push_back(Colour(1.f, 1.f, 1.f));
+		indices[i] = (unsigned int)i;
+	}
+
+	SoftwareRasteriser rasteriser;
+	rasteriser.initialize(width, height, &pool);
+	rasteriser.clearColour = Colour(0.f, 0.f, 0.f, 0.f);
+	const char* names[4] = { "scalar", "simd", "fixed", "fixed simd" };
+	RasterMode modes[4] = { RASTER_SCALAR, RASTER_SIMD, RASTER_FIXED, RASTER_FIXED_SIMD };
+	for (int m = 0; m < 4; m++) {
+		rasteriser.mode = modes[m];
+		rasteriser.beginFrame();
+		rasteriser.drawIndexed(Matrix(), &triangles[0], &colours[0], (unsigned int)triangles.size(), &indices[0], (unsigned int)indices.size());
+		rasteriser.endFrame();
+		uint64_t holes = 0;
+		for (uint32_t pixel : rasteriser.colourBuffer)
+			if (pixel == 0) holes++;
+		uint64_t twice = rasteriser.stats.pixelsCovered - ((uint64_t)width * height - holes);
+		printf("fill rule %s, %u tris over %dx%d: %llu pixels drawn twice, %llu holes\n", names[m], (unsigned int)(indices.size() / 3), width, height,
+			   (unsigned long long)twice, (unsigned long long)holes);
+	}
+}
+
+// A floor just under the camera, running behind it, through the near plane and out past the far plane and the sides of the view
+void benchmarkClipping(ThreadPool& pool, unsigned int gridSize, unsigned int frames) {
+	const int width = 512, height = 512;
+	const float extent = 400.f;
+	std::vector<Vec3> positions;
+	std::vector<Colour> colours;
+	std::vector<unsigned int> indices;
+	for (unsigned int z = 0; z <= gridSize; z++) {
+		for (unsigned int x = 0; x <= gridSize; x++) {
+			positions.push_back(Vec3(((float)x / gridSize * 2.f - 1.f) * extent, -1.f, ((float)z / gridSize * 2.f - 1.f) * extent));
+			colours.push_back(Colour((float)(x & 1), (float)(z & 1), 0.5f));
+		}
+	}
+	for (unsigned int z = 0; z < gridSize; z++) {
+		for (unsigned int x = 0; x < gridSize; x++) {
+			unsigned int i = z * (gridSize + 1) + x;
+			unsigned int quad[6] = { i, i + gridSize + 1, i + 1, i + 1, i + gridSize + 1, i + gridSize + 2 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	Matrix viewProjection = Matrix::projection(width, height, 100.f, 0.1f).mul(Matrix::lookAt(Vec3(0, -0.95f, 0), Vec3(0, -1.f, 1), Vec3(0, 1, 0)));
+
+	SoftwareRasteriser rasteriser;
+	rasteriser.initialize(width, height, &pool);
+	RasterStats total = {};
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		rasteriser.beginFrame();
+		rasteriser.drawIndexed(viewProjection, &positions[0], &colours[0], (unsigned int)positions.size(), &indices[0], (unsigned int)indices.size());
+		rasteriser.endFrame();
+		total.binMs += rasteriser.stats.binMs;
+		total.rasterMs += rasteriser.stats.rasterMs;
+	}
+	const RasterStats& stats = rasteriser.stats;
+	printf("clipping %llu tris per frame: rejected %llu clipped %llu passed %llu culled %llu, %llu triangles set up, %llu pixels covered, ms per frame bin %.2f raster %.2f\n",
+		   (unsigned long long)stats.trianglesIn, (unsigned long long)stats.trianglesRejected, (unsigned long long)stats.trianglesClipped,
+		   (unsigned long long)stats.trianglesPassed, (unsigned long long)stats.trianglesCulled, (unsigned long long)rasteriser.triangles.size(),
+		   (unsigned long long)stats.pixelsCovered, total.binMs / frames, total.rasterMs / frames);
+}
+
+/*
+ *	A few walls in front of a field of small boxes. Each frame renders the walls into the
+ *	occlusion buffer, tests every box and records draws (apply + Mesh::draw) for the survivors,
+ *	against recording all of them. The walls also go through the full resolution rasteriser to
+ *	check that nothing culled had any pixel in front of them.
+ */
+void benchmarkOcclusionCulling(Core& core, Primitive& primitive, unsigned int frames) {
+	const Vec3 cubePositions[8] = { Vec3(-1, -1, -1), Vec3(1, -1, -1), Vec3(-1, 1, -1), Vec3(1, 1, -1),
+									Vec3(-1, -1, 1), Vec3(1, -1, 1), Vec3(-1, 1, 1), Vec3(1, 1, 1) };
+	const unsigned int cubeIndices[36] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+										   2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+	// Walls as scaled cubes
+	std::vector<Matrix> walls;
+	const float wallBoxes[3][6] = { { -8.f, -5.f, 10.f, 3.f, 5.f, 11.f }, { 2.5f, -5.f, 14.f, 12.f, 4.f, 15.f }, { -30.f, -5.f, 30.f, -6.f, 8.f, 31.f } };
+	for (const float* box : wallBoxes) {
+		Matrix world;
+		world[0] = (box[3] - box[0]) * 0.5f;
+		world[5] = (box[4] - box[1]) * 0.5f;
+		world[10] = (box[5] - box[2]) * 0.5f;
+		world[3] = (box[0] + box[3]) * 0.5f;
+		world[7] = (box[1] + box[4]) * 0.5f;
+		world[11] = (box[2] + box[5]) * 0.5f;
+		walls.push_back(world);
+	}
+	// Objects on a grid behind and around the walls
+	std::vector<Vec3> boundsMin, boundsMax;
+	for (int z = 0; z < 64; z++) {
+		for (int x = 0; x < 64; x++) {
+			Vec3 centre(((float)x - 31.5f) * 1.5f, ((x * 7 + z * 3) % 5) * 0.5f - 2.f, 16.f + (float)z * 1.5f);
+			boundsMin.push_back(centre - Vec3(0.4f, 0.4f, 0.4f));
+			boundsMax.push_back(centre + Vec3(0.4f, 0.4f, 0.4f));
+		}
+	}
+	unsigned int objectCount = (unsigned int)boundsMin.size();
+	Matrix viewProjection = Matrix::projection(1024, 1024, 200.f, 0.1f).mul(Matrix::lookAt(Vec3(0, 0, 0), Vec3(0, 0, 1), Vec3(0, 1, 0)));
+
+	OcclusionCuller culler;
+	culler.initialize();
+	std::vector<unsigned int> visible;
+	NullDevice* nullDevice = (NullDevice*)core.device;
+	double frameMs[2] = { 0.0, 0.0 };
+	uint64_t draws[2] = { 0, 0 };
+	OcclusionStats total = {};
+	for (int culling = 0; culling < 2; culling++) {
+		uint64_t drawCalls = nullDevice->stats.drawCalls;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++) {
+			if (culling) {
+				culler.beginFrame(viewProjection);
+				for (const Matrix& wall : walls) culler.renderOccluder(wall, cubePositions, 8, cubeIndices, 36);
+				culler.cullBoxes(&boundsMin[0], &boundsMax[0], objectCount, visible);
+				total.rasterMs += culler.stats.rasterMs;
+				total.testMs += culler.stats.testMs;
+			} else {
+				visible.resize(objectCount);
+				for (unsigned int i = 0; i < objectCount; i++) visible[i] = i;
+			}
+			core.beginFrame();
+			primitive.draw(&core);
+			for (unsigned int object : visible) {
+				// Per-object constants, so every draw uploads its own data like a real object would
+				float time = (float)object;
+				primitive.constantBuffer.update(primitive.timeHandle, &time);
+				primitive.apply(&core);
+				primitive.triangle.draw(&core);
+			}
+			core.finishFrame();
+		}
+		frameMs[culling] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / frames;
+		draws[culling] = (nullDevice->stats.drawCalls - drawCalls) / frames;
+	}
+	core.flushGraphicsQueue();
+
+	// Everything culled has to be behind the walls at full resolution too
+	ThreadPool serial;
+	SoftwareRasteriser reference;
+	reference.initialize(1024, 1024, &serial);
+	reference.beginFrame();
+	std::vector<Colour> cubeColours(8, Colour(1.f, 1.f, 1.f));
+	for (const Matrix& wall : walls) reference.drawIndexed(viewProjection.mul(wall), cubePositions, &cubeColours[0], 8, cubeIndices, 36);
+	reference.endFrame();
+	unsigned int wrong = 0;
+	for (unsigned int i = 0; i < objectCount; i++) {
+		culler.stats = {};
+		if (culler.testBox(boundsMin[i], boundsMax[i]) || culler.stats.boxesOffscreen) continue;
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, zMin = 1e30f;
+		for (int corner = 0; corner < 8; corner++) {
+			Vec4 p((corner & 1) ? boundsMax[i].x : boundsMin[i].x, (corner & 2) ? boundsMax[i].y : boundsMin[i].y, (corner & 4) ? boundsMax[i].z : boundsMin[i].z, 1.f);
+			Vec4 ndc = viewProjection.mul(p).divideByW();
+			minX = std::min<float>(minX, (ndc.x + 1.f) * 512.f);
+			maxX = std::max<float>(maxX, (ndc.x + 1.f) * 512.f);
+			minY = std::min<float>(minY, (1.f - ndc.y) * 512.f);
+			maxY = std::max<float>(maxY, (1.f - ndc.y) * 512.f);
+			zMin = std::min<float>(zMin, ndc.z);
+		}
+		bool exposed = false;
+		for (int y = std::max<int>((int)minY, 0); y < std::min<int>((int)ceilf(maxY), 1024) && !exposed; y++)
+			for (int x = std::max<int>((int)minX, 0); x < std::min<int>((int)ceilf(maxX), 1024) && !exposed; x++)
+				exposed = reference.depthBuffer[(size_t)y * 1024 + x] > zMin;
+		if (exposed) wrong++;
+	}
+
+	const OcclusionStats& stats = culler.stats;
+	culler.cullBoxes(&boundsMin[0], &boundsMax[0], objectCount, visible);
+	printf("occlusion culling %u objects, %dx%d buffer: %u visible, %.1f%% occluded, %llu off screen, cost per frame %.3f ms (occluders %.3f tests %.3f), %u wrongly culled\n",
+		   objectCount, culler.width, culler.height, (unsigned int)visible.size(), 100.0 * stats.boxesOccluded / objectCount,
+		   (unsigned long long)stats.boxesOffscreen, (total.rasterMs + total.testMs) / frames, total.rasterMs / frames, total.testMs / frames, wrong);
+	printf("occlusion culling frame: %llu draws %.3f ms without, %llu draws %.3f ms with\n", (unsigned long long)draws[0], frameMs[0],
+		   (unsigned long long)draws[1], frameMs[1]);
+}
+
+void benchmarkFrustumCulling(Core& core, Primitive& primitive, unsigned int objectCount, unsigned int iterations) {
+	// Objects scattered over a square around the camera, roughly a quarter of them in view
+	Vec3Stream centres, extents;
+	FloatStream radii;
+	centres.resize(objectCount);
+	extents.resize(objectCount);
+	radii.resize(objectCount);
+	srand(18);
+	for (unsigned int i = 0; i < objectCount; i++) {
+		centres.set(i, Vec3((rand() % 4000) * 0.1f - 200.f, (rand() % 400) * 0.1f - 20.f, (rand() % 4000) * 0.1f - 200.f));
+		extents.set(i, Vec3(0.5f + (rand() % 30) * 0.1f, 0.5f + (rand() % 30) * 0.1f, 0.5f + (rand() % 30) * 0.1f));
+		radii[i] = extents.get(i).length();
+	}
+	Frustum frustum;
+	frustum.fromMatrix(Matrix::projection(1024, 1024, 150.f, 0.1f).mul(Matrix::lookAt(Vec3(0, 0, 0), Vec3(0.3f, 0, 1), Vec3(0, 1, 0))));
+
+	std::vector<unsigned int> visibleSpheres, visibleBoxes;
+	visibleSpheres.reserve(objectCount + STREAM_WIDTH);
+	visibleBoxes.reserve(objectCount + STREAM_WIDTH);
+	double sphereMs = 1e30, boxMs = 1e30;
+	for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		frustumCullSpheres(frustum, centres, radii, visibleSpheres);
+		auto middle = std::chrono::high_resolution_clock::now();
+		frustumCullBoxes(frustum, centres, extents, visibleBoxes);
+		auto end = std::chrono::high_resolution_clock::now();
+		sphereMs = std::min<double>(sphereMs, std::chrono::duration<double, std::milli>(middle - start).count());
+		boxMs = std::min<double>(boxMs, std::chrono::duration<double, std::milli>(end - middle).count());
+	}
+
+	// Scalar reference, one object at a time
+	std::vector<unsigned int> referenceSpheres, referenceBoxes;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < objectCount; i++)
+		if (frustum.testSphere(centres.get(i), radii[i])) referenceSpheres.push_back(i);
+	double scalarMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	for (unsigned int i = 0; i < objectCount; i++)
+		if (frustum.testBox(centres.get(i), extents.get(i))) referenceBoxes.push_back(i);
+
+	// Draw submission only walks the visible list
+	NullDevice* nullDevice = (NullDevice*)core.device;
+	uint64_t drawCalls = nullDevice->stats.drawCalls;
+	core.beginFrame();
+	primitive.draw(&core);
+	for (unsigned int object : visibleBoxes) {
+		float time = (float)object;
+		primitive.constantBuffer.update(primitive.timeHandle, &time);
+		primitive.apply(&core);
+		primitive.triangle.draw(&core);
+	}
+	core.finishFrame();
+	core.flushGraphicsQueue();
+
+	printf("frustum culling %u objects (%u wide): spheres %.3f ms (%.2f ns each) %u visible, boxes %.3f ms (%.2f ns each) %u visible, scalar spheres %.3f ms, mismatches %s\n",
+		   objectCount, (unsigned int)LANE_WIDTH, sphereMs, sphereMs * 1e6 / objectCount, (unsigned int)visibleSpheres.size(),
+		   boxMs, boxMs * 1e6 / objectCount, (unsigned int)visibleBoxes.size(), scalarMs,
+		   (visibleSpheres == referenceSpheres && visibleBoxes == referenceBoxes) ? "none" : "FOUND");
+	printf("frustum culling frame: %llu draws submitted\n", (unsigned long long)(nullDevice->stats.drawCalls - drawCalls));
+}
+
+void runRasterBenchmarks(Core& core, Primitive& primitive, ThreadPool& pool) {
+	benchmarkSoftwareRasteriser(pool, 5);
+	benchmarkHierarchicalZ(pool, 5);
+	benchmarkRasterModes(pool, "small", 6.f, 100000);
+	benchmarkRasterModes(pool, "medium", 40.f, 10000);
+	benchmarkRasterModes(pool, "large", 300.f, 200);
+	benchmarkFillRule(pool, 32);
+	benchmarkClipping(pool, 200, 5);
+	benchmarkOcclusionCulling(core, primitive, 100);
+	benchmarkFrustumCulling(core, primitive, 100000, 50);
+}
+#endif
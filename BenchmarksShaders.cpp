@@ -0,0 +1,262 @@
+#ifndef _WIN32
+// Headless benchmarks: Shader cache, permutations, reflection, binding layouts and pipeline cache
+#include "Benchmarks.h"
+#include "Core.h"
+#include "NullDevice.h"
+#include "Primitive.h"
+#include "PSOManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// Cold, warm and edited loads through a scratch cache, editing an include must only miss its users
+void benchmarkShaderCache() {
+	const std::wstring folder = L"ShaderCache/check";
+	createDirectory(L"ShaderCache");
+	createDirectory(folder);
+	const char* common = "float3 tint(float3 c) { return c; }\n";
+	writeBinaryFile(folder + L"/Common.hlsli", common, strlen(common));
+	const char* sources[2] = { "#include \"Common.hlsli\"\nfloat4 PS() : SV_Target0 { return float4(tint(1), 1); }\n",
+							   "float4 VS(float4 p : POSITION) : SV_POSITION { return p; }\n" };
+	const std::wstring names[2] = { folder + L"/CheckPS.hlsl", folder + L"/CheckVS.hlsl" };
+	std::vector<unsigned char> blob;
+	readBinaryFile(L"PixelShader.hlsl.cso", blob);
+	for (int i = 0; i < 2; i++) {
+		writeBinaryFile(names[i], sources[i], strlen(sources[i]));
+		writeBinaryFile(names[i] + L".cso", blob.data(), blob.size());  // What the stub "compiler" returns off Windows
+	}
+
+	// Starts empty every run. The stub's output is cached here since only the cache is being checked.
+	ShaderManager manager;
+	StubShaderCompiler* stub = new StubShaderCompiler();
+	stub->cacheOutput = true;
+	manager.setCompiler(stub);
+	manager.cache.initialize(folder);
+	manager.cache.clear();
+
+	const char* passes[3] = { "cold", "warm", "include edited" };
+	for (int pass = 0; pass < 3; pass++) {
+		if (pass == 2) {
+			const char* edited = "float3 tint(float3 c) { return c * 0.5; }\n";
+			writeBinaryFile(folder + L"/Common.hlsli", edited, strlen(edited));
+		}
+		manager.cache.stats = {};
+		manager.load("CheckPS", names[0], "PS", "ps_5_0", PIXEL_SHADER);
+		manager.load("CheckVS", names[1], "VS", "vs_5_0", VERTEX_SHADER);
+		manager.load("CheckPSFog", names[0], "PS", "ps_5_0", PIXEL_SHADER, { { "FOG", "1" } });
+		printf("shader cache %s: %u hits %u misses\n", passes[pass], manager.cache.stats.hits, manager.cache.stats.misses);
+	}
+}
+
+// All 16 variants of a 4-feature shader on one thread and then on a pool, through the stub compiler with a fixed cost per compile
+void benchmarkShaderPermutations(unsigned int threads, unsigned int compileMs) {
+	const std::wstring folder = L"ShaderCache/permutations";
+	createDirectory(L"ShaderCache");
+	createDirectory(folder);
+	const char* source = "float4 PS() : SV_Target0 {\n#ifdef FOG\n\treturn 0.5;\n#endif\n\treturn 1;\n}\n";
+	const std::wstring filename = folder + L"/Permuted.hlsl";
+	writeBinaryFile(filename, source, strlen(source));
+	std::vector<unsigned char> blob;
+	readBinaryFile(L"PixelShader.hlsl.cso", blob);
+	writeBinaryFile(filename + L".cso", blob.data(), blob.size());
+
+	ThreadPool pool;
+	pool.initialize(threads - 1);
+	std::vector<std::pair<std::string, uint32_t>> all;
+	for (uint32_t mask = 0; mask < 16; mask++) all.push_back({ "Permuted", mask });
+	double ms[2];
+	unsigned int built[2];
+	for (int parallel = 0; parallel < 2; parallel++) {
+		ShaderManager manager;
+		StubShaderCompiler* stub = new StubShaderCompiler();
+		stub->simulatedMs = compileMs;
+		manager.setCompiler(stub);
+		manager.cache.initialize(folder);
+		manager.cache.clear();
+		manager.compilePool = parallel ? &pool : NULL;
+		manager.declarePermutations("Permuted", filename, "PS", "ps_5_0", PIXEL_SHADER, { "FOG", "SKINNING", "SHADOWS", "LIGHTS_8" });
+		manager.compilePermutations(all);
+		ms[parallel] = manager.permutationMs;
+		built[parallel] = manager.permutationsBuilt;
+		// Already built, so no compile, and an unlisted bit is ignored
+		if (manager.getShader("Permuted", 5) != manager.getShader("Permuted", 5 | 64) || manager.permutationsBuilt != built[parallel]) built[parallel] = 0;
+	}
+	printf("shader permutations: %u variants (%u ms per compile) %.1f ms on 1 thread, %u variants %.1f ms on %u threads (%.2fx)\n",
+		   built[0], compileMs, ms[0], built[1], ms[1], pool.threadCount(), ms[0] / ms[1]);
+}
+
+// Start-up cost of getting a shader's reflection: parsing the bytecode, then copying out the cache's parse
+void benchmarkShaderReflection(Core& core, unsigned int iterations) {
+	const char* names[2] = { "TriangleVS", "TrianglePS" };
+	for (const char* name : names) {
+		Shader* shader = core.shaderManager.getShader(name);
+		if (!shader) shader = core.shaderManager.getShader(name, 0);
+		if (!shader || !shader->reflection) {
+			printf("shader reflection %s: not reflected\n", name);
+			continue;
+		}
+		ShaderReflection parsed;
+		parseDXBCReflection(shader->bytecode.data(), shader->bytecode.size(), parsed);
+		const ShaderReflection& cached = *shader->reflection;
+		bool same = parsed.constantBuffers.size() == cached.constantBuffers.size() && parsed.inputs.size() == cached.inputs.size();
+		for (size_t c = 0; same && c < parsed.constantBuffers.size(); c++) {
+			const ConstantBufferReflection &a = parsed.constantBuffers[c], &b = cached.constantBuffers[c];
+			same = a.name == b.name && a.size == b.size && a.bindPoint == b.bindPoint && a.variables.size() == b.variables.size();
+			for (size_t v = 0; same && v < a.variables.size(); v++)
+				same = a.variables[v].name == b.variables[v].name && a.variables[v].offset == b.variables[v].offset && a.variables[v].size == b.variables[v].size;
+		}
+		for (size_t i = 0; same && i < parsed.inputs.size(); i++)
+			same = parsed.inputs[i].semanticName == cached.inputs[i].semanticName && parsed.inputs[i].semanticIndex == cached.inputs[i].semanticIndex &&
+				   parsed.inputs[i].registerIndex == cached.inputs[i].registerIndex && parsed.inputs[i].mask == cached.inputs[i].mask;
+
+		double us[2];
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < iterations; i++) {
+			ShaderReflection reflection;
+			parseDXBCReflection(shader->bytecode.data(), shader->bytecode.size(), reflection);
+		}
+		us[0] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < iterations; i++) {
+			ShaderReflection reflection;
+			Primitive::reflect(&core, shader, reflection);
+		}
+		us[1] = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+
+		std::string inputs;
+		for (const ShaderInputParameter& input : cached.inputs) inputs += " " + input.semanticName + std::to_string(input.semanticIndex);
+		printf("shader reflection %s: %u cbuffers, inputs%s, %s; parse bytecode %.2f us, copy from cache %.2f us\n",
+			   name, (unsigned int)cached.constantBuffers.size(), inputs.c_str(), same ? "matches" : "DIFFERS", us[0], us[1]);
+	}
+}
+
+// Root parameters bound per draw with the layout reflected from the triangle's shaders
+void benchmarkBindingLayouts(Core& core, Primitive& primitive, unsigned int draws) {
+	NullDevice* nullDevice = (NullDevice*)core.device;
+	const BindingLayout& layout = primitive.layout;
+
+	// Rebuilding from the same shaders has to land on the same root signature
+	ShaderReflection vs, ps;
+	Primitive::reflect(&core, primitive.vertexShader, vs);
+	Primitive::reflect(&core, primitive.pixelShader, ps);
+	BindingLayout rebuilt;
+	rebuilt.build(vs, ps);
+	unsigned int signatures = core.rootSignatures.size();
+	bool shared = rebuilt.hash == layout.hash && core.rootSignatures.get(core.device, rebuilt) == primitive.rootSignature &&
+				  core.rootSignatures.size() == signatures;
+
+	// Per-object transform, a per-frame buffer both stages declare and a material too big for root constants,
+	// declared in a different order the second time round
+	ShaderReflection objectVS, objectPS;
+	objectVS.constantBuffers.push_back({ "Frame", 16, 1, {} });
+	objectVS.constantBuffers.push_back({ "Object", 64, 0, {} });
+	objectPS.constantBuffers.push_back({ "Material", 512, 0, {} });
+	objectPS.constantBuffers.push_back({ "Frame", 16, 1, {} });
+	BindingLayout object, reordered;
+	object.build(objectVS, objectPS);
+	std::swap(objectVS.constantBuffers[0], objectVS.constantBuffers[1]);
+	reordered.build(objectVS, objectPS);
+	bool objectExpected = object.parameters.size() == 3 && object.find(GPU_VISIBILITY_VERTEX, 0) == 0 && object.find(GPU_VISIBILITY_PIXEL, 1) == 1 &&
+						  object.slots[1].visibility == GPU_VISIBILITY_ALL && object.parameters[1].type == GPU_ROOT_CONSTANTS &&
+						  object.parameters[2].type == GPU_ROOT_CBV && object.dwords == 16 + 4 + ROOT_CBV_DWORDS && object.hash == reordered.hash;
+
+	const NullDeviceStats& stats = nullDevice->stats;
+	uint64_t cbvs = stats.commands[NULL_CMD_SET_ROOT_CBV], constants = stats.commands[NULL_CMD_SET_ROOT_CONSTANTS];
+	uint64_t allocations = core.constantBufferRing.stats.allocations;
+	core.beginFrame();
+	primitive.draw(&core);
+	for (unsigned int i = 1; i < draws; i++) {
+		primitive.apply(&core);
+		primitive.triangle.draw(&core);
+	}
+	core.finishFrame();
+	core.flushGraphicsQueue();
+	double perDraw = 1.0 / draws;
+
+	printf("binding layout: %u parameters (%u root constants, %u root CBVs), %u of %u DWORDs; per draw %.2f root CBVs %.2f root constant sets %.2f ring allocations\n",
+		   (unsigned int)layout.parameters.size(), layout.countOf(GPU_ROOT_CONSTANTS), layout.countOf(GPU_ROOT_CBV), layout.dwords, ROOT_SIGNATURE_MAX_DWORDS,
+		   (stats.commands[NULL_CMD_SET_ROOT_CBV] - cbvs) * perDraw, (stats.commands[NULL_CMD_SET_ROOT_CONSTANTS] - constants) * perDraw,
+		   (core.constantBufferRing.stats.allocations - allocations) * perDraw);
+	printf("root signatures: %u for %u requests, rebuilt layout %s, merged 3 buffer layout %s (%u DWORDs)\n",
+		   core.rootSignatures.size(), core.rootSignatures.requests, shared ? "shared" : "NOT SHARED", objectExpected ? "as expected" : "WRONG", object.dwords);
+}
+
+// Pipelines keyed by description: names no longer decide what is shared, and repeat lookups cost a hash and a probe
+void benchmarkPipelineCache(Core& core, Primitive& primitive, unsigned int lookups) {
+	PipelineCacheStats before = core.pipelines.stats;
+	GPUInputLayout inputLayout = primitive.triangle.mesh.inputLayoutDesc;
+
+	// The triangle's pipeline under another name is the same object
+	PSOManager other;
+	bool aliasShared = other.createPSO(&core, "Alias", primitive.vertexShader, primitive.pixelShader, inputLayout, primitive.rootSignature) == primitive.pso;
+
+	// A different pixel shader under a name already in use gets its own (the stub compiler returns one blob for every
+	// variant, so a padded copy stands in for the other shader)
+	Shader variant = *primitive.pixelShader;
+	variant.bytecode.push_back(0);
+	variant.hash = hashBytes(variant.bytecode.data(), variant.bytecode.size());
+	GPUPipelineState* renamed = other.createPSO(&core, "Alias", primitive.vertexShader, &variant, inputLayout, primitive.rootSignature);
+	bool nameSeparate = renamed != primitive.pso && other.psos["Alias"] == renamed;
+
+	// Any state change is a different key
+	GPUPipelineDesc desc = {};
+	desc.inputLayout = inputLayout;
+	desc.rootSignature = primitive.rootSignature;
+	desc.vs = { primitive.vertexShader->bytecode.data(), primitive.vertexShader->bytecode.size(), primitive.vertexShader->hash };
+	desc.ps = { primitive.pixelShader->bytecode.data(), primitive.pixelShader->bytecode.size(), primitive.pixelShader->hash };
+	desc.fillMode = GPU_FILL_SOLID;
+	desc.cullMode = GPU_CULL_NONE;
+	desc.depthClipEnable = true;
+	desc.depthEnable = true;
+	desc.depthWrite = true;
+	desc.depthFunc = GPU_COMPARISON_LESS;
+	desc.topologyType = GPU_TOPOLOGY_TYPE_TRIANGLE;
+	desc.rtvFormat = GPU_FORMAT_R8G8B8A8_UNORM;
+	desc.dsvFormat = GPU_FORMAT_D32_FLOAT;
+	bool sameDesc = core.pipelines.get(core.device, desc) == primitive.pso;
+	desc.cullMode = GPU_CULL_BACK;
+	GPUPipelineState* culled = core.pipelines.get(core.device, desc);
+	desc.cullMode = GPU_CULL_NONE;
+	desc.rootSignature = core.rootSignature;
+	GPUPipelineState* otherSignature = core.pipelines.get(core.device, desc);
+	desc.rootSignature = primitive.rootSignature;
+	bool statesSeparate = culled != primitive.pso && otherSignature != primitive.pso && otherSignature != culled;
+
+	// What a hash hit is checked against: equal descriptions match, one changed field doesn't
+	PipelineKey key(desc);
+	bool keyMatches = key.matches(desc);
+	desc.cullMode = GPU_CULL_FRONT;
+	bool keyRejects = !key.matches(desc);
+	desc.cullMode = GPU_CULL_NONE;
+
+	// Repeat requests, with the shader hashes carried in the description and with the bytecode hashed every time
+	double ns[2];
+	uintptr_t check = 0;
+	for (int hashed = 0; hashed < 2; hashed++) {
+		desc.vs.hash = hashed ? 0 : primitive.vertexShader->hash;
+		desc.ps.hash = hashed ? 0 : primitive.pixelShader->hash;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < lookups; i++) check += (uintptr_t)core.pipelines.get(core.device, desc);
+		ns[hashed] = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / lookups;
+	}
+	bool hits = check == (uintptr_t)primitive.pso * 2 * lookups;
+
+	const PipelineCacheStats& stats = core.pipelines.stats;
+	printf("pipeline cache: alias %s, reused name %s, changed state %s, matching desc %s, key compare %s, lookups %s; %u new for %llu requests (%u unique in all, %u collisions), lookup %.1f ns (%.1f ns hashing the bytecode)\n",
+		   aliasShared ? "shared" : "NOT SHARED", nameSeparate ? "separate" : "WRONG PSO", statesSeparate ? "separate" : "WRONG PSO",
+		   sameDesc ? "shared" : "NOT SHARED", (keyMatches && keyRejects) ? "ok" : "WRONG", hits ? "all hits" : "MISSED", stats.unique - before.unique,
+		   (unsigned long long)(stats.requests - before.requests), stats.unique, stats.collisions, ns[0], ns[1]);
+}
+
+void runShaderBenchmarks(Core& core, Primitive& primitive) {
+	benchmarkShaderCache();
+	benchmarkShaderPermutations(4, 20);
+	benchmarkShaderReflection(core, 10000);
+	benchmarkBindingLayouts(core, primitive, 1000);
+	benchmarkPipelineCache(core, primitive, 1000000);
+}
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GPUDevice.h"
+#include "Platform.h"
+#include "ShaderReflection.h"
+
+// A root signature holds 64 DWORDs: root constants cost one per value, a root CBV costs two
+const unsigned int ROOT_SIGNATURE_MAX_DWORDS = 64;
+const unsigned int ROOT_CBV_DWORDS = 2;
+
+// Constant buffers up to this size can be set inline with the draw instead of going through the upload ring
+const unsigned int ROOT_CONSTANTS_MAX_BYTES = 128;
+
+// Field by field, so equal descriptions hash equally whatever was left in unused members
+inline uint64_t hashRootSignature(const GPURootSignatureDesc& desc) {
+	uint32_t header[2] = { desc.numParameters, desc.allowInputLayout ? 1u : 0u };
+	uint64_t hash = hashBytes(header, sizeof(header));
+	for (unsigned int i = 0; i < desc.numParameters; i++) {
+		const GPURootParameter& parameter = desc.parameters[i];
+		uint32_t fields[5] = { (uint32_t)parameter.type, parameter.shaderRegister, parameter.registerSpace,
+							   (parameter.type == GPU_ROOT_CONSTANTS) ? parameter.num32BitValues : 0u, (uint32_t)parameter.visibility };
+		hash = hashBytes(fields, sizeof(fields), hash);
+	}
+	return hash;
+}
+
+// One constant buffer a pipeline reads and the root parameter it is bound through
+struct BindingSlot {
+	ConstantBufferReflection buffer;
+	GPUShaderVisibility visibility;  // GPU_VISIBILITY_ALL when both stages declare it the same way
+	unsigned int rootIndex;
+};
+
+/*
+ *	Root signature layout for a vertex and pixel shader pair, built from the reflection of both.
+ *	A constant buffer both stages declare with the same name, register and size gets a single
+ *	parameter visible to both. Every buffer starts as a root CBV, then the smallest ones become
+ *	root constants while they fit the 64 DWORD budget, so small per-draw data needs no upload.
+ *	Slots are ordered by stage then register, so the same shaders always give the same hash.
+ */
+class BindingLayout {
+public:
+	std::vector<BindingSlot> slots;             // slots[i] is bound through parameters[i]
+	std::vector<GPURootParameter> parameters;
+	unsigned int dwords = 0;                    // Root signature space used
+	uint64_t hash = 0;
+
+	void build(const ShaderReflection& vs, const ShaderReflection& ps) {
+		slots.clear();
+		parameters.clear();
+		addStage(vs, GPU_VISIBILITY_VERTEX);
+		addStage(ps, GPU_VISIBILITY_PIXEL);
+
+		std::vector<unsigned int> bySize;
+		for (unsigned int i = 0; i < slots.size(); i++) {
+			GPURootParameter parameter = {};
+			parameter.type = GPU_ROOT_CBV;
+			parameter.shaderRegister = slots[i].buffer.bindPoint;
+			parameter.visibility = slots[i].visibility;
+			parameters.push_back(parameter);
+			slots[i].rootIndex = i;
+			bySize.push_back(i);
+		}
+		dwords = ROOT_CBV_DWORDS * (unsigned int)slots.size();
+
+		std::stable_sort(bySize.begin(), bySize.end(), [this](unsigned int a, unsigned int b) { return slots[a].buffer.size < slots[b].buffer.size; });
+		for (unsigned int i : bySize) {
+			unsigned int values = (slots[i].buffer.size + 3) / 4;
+			if (slots[i].buffer.size > ROOT_CONSTANTS_MAX_BYTES || dwords - ROOT_CBV_DWORDS + values > ROOT_SIGNATURE_MAX_DWORDS) continue;
+			parameters[i].type = GPU_ROOT_CONSTANTS;
+			parameters[i].num32BitValues = values;
+			dwords = dwords - ROOT_CBV_DWORDS + values;
+		}
+		if (dwords > ROOT_SIGNATURE_MAX_DWORDS)
+			debugLog("BindingLayout: " + std::to_string(slots.size()) + " constant buffers need " + std::to_string(dwords) + " DWORDs, more than a root signature holds\n");
+		hash = hashRootSignature(desc());
+	}
+
+	// Points into parameters, valid until the next build
+	GPURootSignatureDesc desc() const {
+		GPURootSignatureDesc desc = {};
+		desc.numParameters = (unsigned int)parameters.size();
+		desc.parameters = parameters.empty() ? NULL : &parameters[0];
+		desc.allowInputLayout = true;
+		return desc;
+	}
+
+	// Root parameter of the buffer a stage reads from register(bN), -1 if the pipeline has none
+	int find(GPUShaderVisibility stage, unsigned int shaderRegister) const {
+		for (const BindingSlot& slot : slots)
+			if (slot.buffer.bindPoint == shaderRegister && (slot.visibility == stage || slot.visibility == GPU_VISIBILITY_ALL)) return (int)slot.rootIndex;
+		return -1;
+	}
+
+	unsigned int countOf(GPURootParameterType type) const {
+		unsigned int count = 0;
+		for (const GPURootParameter& parameter : parameters) count += (parameter.type == type) ? 1 : 0;
+		return count;
+	}
+
+private:
+	void addStage(const ShaderReflection& reflection, GPUShaderVisibility stage) {
+		std::vector<const ConstantBufferReflection*> buffers;
+		for (const ConstantBufferReflection& buffer : reflection.constantBuffers)
+			if (buffer.size > 0) buffers.push_back(&buffer);
+		std::stable_sort(buffers.begin(), buffers.end(), [](const ConstantBufferReflection* a, const ConstantBufferReflection* b) { return a->bindPoint < b->bindPoint; });
+
+		for (const ConstantBufferReflection* buffer : buffers) {
+			bool shared = false;
+			for (BindingSlot& slot : slots) {
+				if (slot.visibility == stage || slot.buffer.bindPoint != buffer->bindPoint || slot.buffer.size != buffer->size || slot.buffer.name != buffer->name) continue;
+				slot.visibility = GPU_VISIBILITY_ALL;
+				shared = true;
+				break;
+			}
+			if (!shared) slots.push_back({ *buffer, stage, 0 });
+		}
+	}
+};
+
+// Root signatures by layout hash, pipelines that bind the same way share one
+class RootSignatureCache {
+public:
+	unsigned int requests = 0;
+
+	RootSignatureCache() {}
+	RootSignatureCache(const RootSignatureCache&) = delete;
+	RootSignatureCache& operator=(const RootSignatureCache&) = delete;
+	~RootSignatureCache() {
+		for (auto& signature : signatures) delete signature.second;
+	}
+
+	GPURootSignature* get(GPUDevice* device, const GPURootSignatureDesc& desc) {
+		requests++;
+		uint64_t hash = hashRootSignature(desc);
+		auto it = signatures.find(hash);
+		if (it != signatures.end()) return it->second;
+		GPURootSignature* signature = device->createRootSignature(desc);
+		if (!signature) return NULL;
+		signature->layoutHash = hash;
+		signatures.insert({ hash, signature });
+		return signature;
+	}
+
+	GPURootSignature* get(GPUDevice* device, const BindingLayout& layout) { return get(device, layout.desc()); }
+
+	unsigned int size() const { return (unsigned int)signatures.size(); }
+
+private:
+	std::unordered_map<uint64_t, GPURootSignature*> signatures;
+};
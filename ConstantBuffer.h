@@ -2,73 +2,85 @@
 
 #include "Core.h"
 #include "MyMath.h"
+#include "ShaderReflection.h"
 
-#include <d3d12.h>
-#include <d3d12shader.h>
-#include <dxgi1_6.h>
-#include <d3dcompiler.h>
-#include <assert.h>
+#include <map>
+#include <string>
+#include <vector>
 
-#pragma comment(lib, "d3d12")
-#pragma comment(lib, "dxgi")
-#pragma comment(lib, "d3dcompiler.lib")
-#pragma comment(lib, "dxguid.lib")
+// Variable location resolved once from reflection, so per-draw updates skip the name lookup
+struct ConstantBufferHandle {
+	unsigned int offset = 0;
+	unsigned int size = 0;  // 0 if the variable was not found
 
-struct ConstantBufferVariable {
-	std::string name;
-	unsigned int offset;  // Byte offset in the struct (e.g., time is 0)
-	unsigned int size;    // Size in bytes
+	bool valid() const { return size != 0; }
 };
 
 class ConstantBuffer {
 public:
-	ID3D12Resource* constantBuffer;
-	unsigned char* buffer;
+	// CPU copy of the contents, pushed into the frame's upload ring whenever the buffer is bound
+	std::vector<unsigned char> buffer;
+	FrameRingAllocator* ring;
 
 	unsigned int cbSizeInBytes;
-	unsigned int maxDrawCalls;
-	unsigned int offsetIndex;
-	unsigned int numInstances = 0;
 
 	std::string name;
 	std::map<std::string, ConstantBufferVariable> constantBufferData;
 
-	void initialize(Core* core, unsigned int sizeInBytes, unsigned int _maxDrawCalls = 1024) {
-		maxDrawCalls = _maxDrawCalls;
+	// Root parameter the buffer is bound through, from the pipeline's BindingLayout
+	unsigned int rootIndex = 0;
+	unsigned int rootConstants = 0;  // 32-bit values set inline with the draw, 0 for a root CBV
+
+	void initialize(Core* core, unsigned int sizeInBytes) {
 		cbSizeInBytes = (sizeInBytes + 255) & ~255;
-		unsigned int cbSizeInBytesAligned = cbSizeInBytes * maxDrawCalls;
-		numInstances = _maxDrawCalls;
-		offsetIndex = 0;
-		HRESULT hr;
-		D3D12_HEAP_PROPERTIES heapprops = {};
-		heapprops.Type = D3D12_HEAP_TYPE_UPLOAD;
-		heapprops.CreationNodeMask = 1;
-		heapprops.VisibleNodeMask = 1;
-		D3D12_RESOURCE_DESC cbDesc = {};
-		cbDesc.Width = cbSizeInBytesAligned;
-		cbDesc.Height = 1;
-		cbDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		cbDesc.DepthOrArraySize = 1;
-		cbDesc.MipLevels = 1;
-		cbDesc.SampleDesc.Count = 1;
-		cbDesc.SampleDesc.Quality = 0;
-		cbDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-		core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &cbDesc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&constantBuffer));
-		constantBuffer->Map(0, NULL, (void**)&buffer);
+		buffer.assign(cbSizeInBytes, 0);
+		ring = &core->constantBufferRing;
 	}
 
-	void update(std::string name, void* data) {
-		ConstantBufferVariable cbVariable = constantBufferData[name];
-		unsigned int offset = offsetIndex * cbSizeInBytes;
-		memcpy(&buffer[offset + cbVariable.offset], data, cbVariable.size);
+	ConstantBufferHandle getHandle(const std::string& name) const {
+		ConstantBufferHandle handle;
+		auto it = constantBufferData.find(name);
+		if (it != constantBufferData.end() && it->second.offset + it->second.size <= buffer.size()) {
+			handle.offset = it->second.offset;
+			handle.size = it->second.size;
+		}
+		return handle;
 	}
 
-	D3D12_GPU_VIRTUAL_ADDRESS getGPUAddress() const {
-		return (constantBuffer->GetGPUVirtualAddress() + (offsetIndex * cbSizeInBytes));
+	// Slow path - name lookup on every write
+	void update(const std::string& name, const void* data) {
+		auto it = constantBufferData.find(name);
+		if (it == constantBufferData.end()) return;
+		update(ConstantBufferHandle{ it->second.offset, it->second.size }, data);
 	}
 
-	void next() {
-		offsetIndex++;
-		if (offsetIndex >= maxDrawCalls) offsetIndex = 0;
+	void update(ConstantBufferHandle handle, const void* data) {
+		if (handle.offset + handle.size > buffer.size()) return;  // Handle from a different, smaller buffer
+		memcpy(&buffer[handle.offset], data, handle.size);
 	}
-};
\ No newline at end of file
+
+	// 48 bytes for a row_major float3x4, expanded if the shader still declares a float4x4
+	void update(ConstantBufferHandle handle, const AffineMatrix& matrix) {
+		if (handle.size >= sizeof(Matrix)) {
+			Matrix full = matrix.toMatrix();
+			update(ConstantBufferHandle{ handle.offset, (unsigned int)sizeof(Matrix) }, &full);
+		} else if (handle.size == sizeof(matrix.m)) {
+			update(handle, matrix.m);
+		} else if (handle.valid()) {
+			debugLog("ConstantBuffer: " + std::to_string(handle.size) + " byte variable is neither a float3x4 nor a float4x4\n");
+		}
+	}
+
+	// Copy the current contents into this frame's ring and return the address to bind
+	uint64_t commit() {
+		UploadAllocation allocation = ring->allocate(cbSizeInBytes, 256);
+		memcpy(allocation.cpu, &buffer[0], cbSizeInBytes);
+		return allocation.gpuAddress;
+	}
+
+	// Root constants go straight into the command list, anything else is committed to the ring
+	void bind(GPUCommandList* commandList) {
+		if (rootConstants) commandList->setRootConstants(rootIndex, rootConstants, &buffer[0]);
+		else commandList->setRootConstantBufferView(rootIndex, commit());
+	}
+};
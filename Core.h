@@ -1,239 +1,150 @@
 #pragma once
 
-#include <d3d12.h>
-#include <dxgi1_6.h>
-#include <d3dcompiler.h>
+#include <assert.h>
+#include <cstring>
 #include <vector>
 
+#include "BindingLayout.h"
+#include "FrameRingAllocator.h"
+#include "GPUDevice.h"
+#include "GPUMemoryAllocator.h"
+#include "NullDevice.h"
+#include "PipelineCache.h"
+#include "ResourceStateTracker.h"
 #include "ShaderManager.h"
+#include "UploadBatch.h"
 
-#pragma comment(lib, "d3d12")
-#pragma comment(lib, "dxgi")
-#pragma comment(lib, "d3dcompiler.lib")
-
-// Ensure memory visibility across queue operations
-class Barrier {
-public:
-	static void add(ID3D12Resource* res, D3D12_RESOURCE_STATES first, D3D12_RESOURCE_STATES second, ID3D12GraphicsCommandList4* commandList) {
-		D3D12_RESOURCE_BARRIER rb = {};
-		rb.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		rb.Transition.pResource = res;
-		rb.Transition.StateBefore = first;
-		rb.Transition.StateAfter = second;
-		rb.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-		commandList->ResourceBarrier(1, &rb);
-	}
-};
-
-// Signal when a queue finishes (Wait for a fence before starting dependent tasks on another queue)
-class GPUFence {
-public:
-	ID3D12Fence* fence;
-	HANDLE eventHandle;
-	UINT64 value = 0;
-
-	~GPUFence() {
-		CloseHandle(eventHandle);
-		fence->Release();
-	}
-
-	void create(ID3D12Device5* device) {
-		device->CreateFence(value, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
-		eventHandle = CreateEvent(NULL, FALSE, FALSE, NULL);
-	}
-
-	void signal(ID3D12CommandQueue* queue) {
-		queue->Signal(fence, ++value);
-	}
-	
-	void wait() {
-		if (fence->GetCompletedValue() < value) {
-			fence->SetEventOnCompletion(value, eventHandle);
-			WaitForSingleObject(eventHandle, INFINITE);
-		}
-	}
-};
+#ifdef _WIN32
+#include "D3D12Device.h"
+#endif
 
 class Core {
 public:
-	// Representation of the Adapter
-	IDXGIAdapter1* adapter;
-
-	// Core Interfaces
-	ID3D12Device5* device;
-	ID3D12CommandQueue* graphicsQueue;
-	ID3D12CommandQueue* copyQueue;
-	ID3D12CommandQueue* computeQueue;
-	IDXGISwapChain3* swapchain;
-
-	// One for each frame
-	ID3D12CommandAllocator* graphicsCommandAllocator[2];
-	ID3D12GraphicsCommandList4* graphicsCommandList[2];
-
-	ID3D12DescriptorHeap* backbufferHeap;
-	ID3D12Resource** backbuffers;
-
-	GPUFence graphicsQueueFence[2];
-
-	ID3D12DescriptorHeap* dsvHeap;
-	ID3D12Resource* dsv;
-	D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle;
-
-	D3D12_VIEWPORT viewport;
-	D3D12_RECT scissorRect;
-
-	ID3D12RootSignature* rootSignature;
+	// Core Interfaces (D3D12 or Null backend)
+	GPUDevice* device;
+	GPUQueue* graphicsQueue;
+	GPUQueue* copyQueue;
+	GPUQueue* computeQueue;
+	GPUSwapchain* swapchain;
+
+	// Placed resources in a few large heaps instead of one committed resource per object
+	GPUMemoryAllocator memory;
+
+	// Frames the CPU may record ahead of the GPU (2-4), one command list per frame slot
+	unsigned int framesInFlight;
+	unsigned int frameSlot = 0;
+	std::vector<TrackedCommandList*> graphicsCommandList;
+
+	// One timeline per queue, and the graphics value each frame slot last submitted
+	GPUFence graphicsQueueFence;
+	GPUFence copyQueueFence;
+	GPUFence computeQueueFence;
+	std::vector<uint64_t> frameFenceValues;
+
+	GPUResource* dsv;
+
+	GPUViewport viewport;
+	GPURect scissorRect;
+
+	// Default signature (one root CBV at b0 per stage), pipelines built from reflection get theirs from rootSignatures
+	GPURootSignature* rootSignature;
+	RootSignatureCache rootSignatures;
+
+	// Pipeline states by a hash of their full description, shared by every PSOManager
+	PipelineCache pipelines;
+
+	// Per-frame upload memory for constant buffers, retired against graphicsQueueFence
+	FrameRingAllocator constantBufferRing;
+
+	// Staging ring and batched copies for uploadResource
+	UploadBatch uploads;
+	bool batchingUploads = false;
+	bool recordingFrame = false;  // Between beginFrame and finishFrame
+
+	// Asynchronous uploads on the copy queue, the graphics queue only waits when a resource is first used
+	UploadBatch streamingUploads;
+	bool streaming = false;
+	uint64_t streamingSafeValue = 0;  // Copy fence value the graphics queue is already ordered after
+	uint64_t streamingWaitValue = 0;  // Copy fence value the list being recorded needs
+	StreamingFrameStats streamingFrame = {};
+	StreamingFrameStats streamingTotal = {};
+	uint64_t streamingFrameSubmits = 0;  // Copy submits and bytes counted since the last finishFrame
+	uint64_t streamingFrameBytes = 0;
+
+	// Transitions recorded by the frame's command list
+	BarrierStats barrierFrame = {};
+	BarrierStats barrierTotal = {};
 
 	// Shader Manager
 	ShaderManager shaderManager;
 
-	void initialize(HWND hwnd, int _width, int _height) {
-		// Enable the D3D12 debug layer
-		ID3D12Debug* debugController;
-		if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController)))) {
-			debugController->EnableDebugLayer();
-			debugController->Release();
+#ifdef _WIN32
+	void initialize(HWND hwnd, int _width, int _height, unsigned int _framesInFlight = 2) {
+		D3D12Device* d3d12Device = new D3D12Device();
+		d3d12Device->initialize();
+		initialize(d3d12Device, hwnd, _width, _height, _framesInFlight);
+	}
+#endif
+
+	// Run on an already initialized device, windowHandle can be NULL for the null backend
+	void initialize(GPUDevice* _device, void* windowHandle, int _width, int _height, unsigned int _framesInFlight = 2) {
+		device = _device;
+		memory.initialize(device);
+
+		// More slots hide more GPU latency at the cost of input lag and memory
+		framesInFlight = _framesInFlight;
+		if (framesInFlight < 2 || framesInFlight > 4) {
+			debugLog("Core: frames in flight must be between 2 and 4, clamping\n");
+			framesInFlight = (framesInFlight < 2) ? 2 : 4;
 		}
 
-		// Enumerate adapters
-		IDXGIAdapter1* adapterf;
-		std::vector<IDXGIAdapter1*> adapters;
-		IDXGIFactory6* factory = NULL;
-		CreateDXGIFactory(__uuidof(IDXGIFactory6), (void**)&factory);
+		// Create Command Queues
+		graphicsQueue = device->createQueue(GPU_QUEUE_GRAPHICS);
+		copyQueue = device->createQueue(GPU_QUEUE_COPY);
+		computeQueue = device->createQueue(GPU_QUEUE_COMPUTE);
 
-		int i = 0;
-		while (factory->EnumAdapters1(i, &adapterf) != DXGI_ERROR_NOT_FOUND) {
-			adapters.push_back(adapterf);
-			i++;
-		}
+		// Create the swapchain (one backbuffer per frame in flight)
+		swapchain = device->createSwapchain(graphicsQueue, windowHandle, _width, _height, framesInFlight, GPU_FORMAT_R8G8B8A8_UNORM);
 
-		// Find the best adapter
-		long long maxVideoMemory = 0;
-		int useAdapterIndex = 0;
-		for (int i = 0; i < adapters.size(); i++) {
-			DXGI_ADAPTER_DESC desc;
-			adapters[i]->GetDesc(&desc);
-			if (desc.DedicatedVideoMemory > maxVideoMemory) {
-				maxVideoMemory = desc.DedicatedVideoMemory;
-				useAdapterIndex = i;
-			}
+		// Create Command Allocators and Command Lists
+		for (unsigned int i = 0; i < framesInFlight; i++) {
+			TrackedCommandList* list = new TrackedCommandList();
+			list->initialize(device->createCommandList(GPU_QUEUE_GRAPHICS));
+			graphicsCommandList.push_back(list);
 		}
-		adapter = adapters[useAdapterIndex];
+		frameFenceValues.assign(framesInFlight, 0);
 
-		// Create DX12 Device on Adapter
-		D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&device));
+		// Create GPU Fences
+		graphicsQueueFence.create(device);
+		copyQueueFence.create(device);
+		computeQueueFence.create(device);
 
-		// Create Command Queues
-		D3D12_COMMAND_QUEUE_DESC graphicsQueueDesc = {};
-		graphicsQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-		device->CreateCommandQueue(&graphicsQueueDesc, IID_PPV_ARGS(&graphicsQueue));
-		D3D12_COMMAND_QUEUE_DESC copyQueueDesc = {};
-		copyQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
-		device->CreateCommandQueue(&copyQueueDesc, IID_PPV_ARGS(&copyQueue));
-		D3D12_COMMAND_QUEUE_DESC computeQueueDesc = {};
-		computeQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
-		device->CreateCommandQueue(&computeQueueDesc, IID_PPV_ARGS(&computeQueue));
-
-		// Swapchain
-		DXGI_SWAP_CHAIN_DESC1 scDesc = {};
-		scDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		scDesc.Width = _width;
-		scDesc.Height = _height;
-		scDesc.SampleDesc.Count = 1;  // MSAA here
-		scDesc.SampleDesc.Quality = 0;
-		scDesc.BufferCount = 2;		  // Double Buffering
-		scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;  // Stop copying memory and start swapping pointers
-
-		// Create the swapchain
-		IDXGISwapChain1* swapChain1;
-		factory->CreateSwapChainForHwnd(graphicsQueue, hwnd, &scDesc, NULL, NULL, &swapChain1);
-		swapChain1->QueryInterface(&swapchain);
-		swapChain1->Release();
-		factory->Release();
+		// Placed resources deleted mid-frame keep their memory until the graphics queue is past them
+		memory.retireFence = &graphicsQueueFence;
 
-		// Create Command Allocators and Command Lists
-		device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&graphicsCommandAllocator[0]));
-		device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&graphicsCommandList[0]));
-		graphicsCommandList[0]->Close();
-
-		device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&graphicsCommandAllocator[1]));
-		device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&graphicsCommandList[1]));
-		graphicsCommandList[1]->Close();
-
-		// Create Heap
-		D3D12_DESCRIPTOR_HEAP_DESC renderTargetViewHeapDesc = {};
-		renderTargetViewHeapDesc.NumDescriptors = scDesc.BufferCount;
-		renderTargetViewHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-		device->CreateDescriptorHeap(&renderTargetViewHeapDesc, IID_PPV_ARGS(&backbufferHeap));
-
-		// Allocate memory for Backbuffer array
-		backbuffers = new ID3D12Resource* [scDesc.BufferCount];
-
-		// Get backbuffers and create views on heap
-		D3D12_CPU_DESCRIPTOR_HANDLE renderTargetViewHandle = backbufferHeap->GetCPUDescriptorHandleForHeapStart();
-		unsigned int renderTargetViewDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-		for (unsigned int i = 0; i < 2; i++) {
-			swapchain->GetBuffer(i, IID_PPV_ARGS(&backbuffers[i]));
-			device->CreateRenderTargetView(backbuffers[i], nullptr, renderTargetViewHandle);
-			renderTargetViewHandle.ptr += renderTargetViewDescriptorSize;
-		}
+		// Shared constant buffer memory, one 256KB arena per frame (grows if a frame needs more)
+		constantBufferRing.initialize(&memory, framesInFlight, 256 * 1024);
 
-		// Create GPU Fences
-		graphicsQueueFence[0].create(device);
-		graphicsQueueFence[1].create(device);
-
-		// Create Descriptor Heap
-		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
-		memset(&dsvHeapDesc, 0, sizeof(D3D12_DESCRIPTOR_HEAP_DESC));
-		dsvHeapDesc.NumDescriptors = 1;
-		dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-		dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-		device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&dsvHeap));
-		dsvHandle = dsvHeap->GetCPUDescriptorHandleForHeapStart();
-
-		// Create Depth Buffer
-		D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
-		depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-		depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
-		D3D12_CLEAR_VALUE depthClearValue = {};
-		depthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-		depthClearValue.DepthStencil.Depth = 1.0f;
-		depthClearValue.DepthStencil.Stencil = 0;
-
-		// Specify which type of memory to allocate Depth Buffer (want fast on chip memory)
-		D3D12_HEAP_PROPERTIES heapprops = {};
-		heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
-		heapprops.CreationNodeMask = 1;
-		heapprops.VisibleNodeMask = 1;
-
-		// Specify resource information
-		D3D12_RESOURCE_DESC dsvDesc = {};
-		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
-		dsvDesc.Width = _width;
-		dsvDesc.Height = _height;
-		dsvDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		dsvDesc.DepthOrArraySize = 1;
-		dsvDesc.MipLevels = 1;
-		dsvDesc.SampleDesc.Count = 1;
-		dsvDesc.SampleDesc.Quality = 0;
-		dsvDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-		dsvDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-
-		// Allocate memory for resources
-		device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &dsvDesc, D3D12_RESOURCE_STATE_DEPTH_WRITE, &depthClearValue, IID_PPV_ARGS(&dsv));
-
-		// Create DepthStencilView to Resource on descriptor heap
-		device->CreateDepthStencilView(dsv, &depthStencilDesc, dsvHandle);
+		// 4MB staging ring for resource uploads (larger uploads get a dedicated buffer)
+		uploads.initialize(device, graphicsQueue, GPU_QUEUE_GRAPHICS, &graphicsQueueFence, 4 * 1024 * 1024);
+		streamingUploads.initialize(device, copyQueue, GPU_QUEUE_COPY, &copyQueueFence, 4 * 1024 * 1024);
+
+		// Create Depth Buffer (want fast on chip memory)
+		GPUTextureDesc dsvDesc = {};
+		dsvDesc.width = _width;
+		dsvDesc.height = _height;
+		dsvDesc.format = GPU_FORMAT_D32_FLOAT;
+		dsvDesc.flags = GPU_TEXTURE_DEPTH_STENCIL;
+		dsvDesc.clearDepth = 1.0f;
+		dsv = memory.createTexture2D(dsvDesc, GPU_STATE_DEPTH_WRITE);
 
 		// Define viewport and scissor
-		viewport.TopLeftX = 0.0f;
-		viewport.TopLeftY = 0.0f;
-		viewport.Width = (float)_width;
-		viewport.Height = (float)_height;
-		viewport.MinDepth = 0.0f;
-		viewport.MaxDepth = 1.0f;
+		viewport.topLeftX = 0.0f;
+		viewport.topLeftY = 0.0f;
+		viewport.width = (float)_width;
+		viewport.height = (float)_height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
 
 		scissorRect.left = 0;
 		scissorRect.top = 0;
@@ -241,151 +152,192 @@ public:
 		scissorRect.bottom = _height;
 
 		// Update Root Signature
-		std::vector<D3D12_ROOT_PARAMETER> parameters;
-		D3D12_ROOT_PARAMETER rootParameterCBVS;
-		rootParameterCBVS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-		rootParameterCBVS.Descriptor.ShaderRegister = 0; // Register(b0)
-		rootParameterCBVS.Descriptor.RegisterSpace = 0;
-		rootParameterCBVS.ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+		std::vector<GPURootParameter> parameters;
+		GPURootParameter rootParameterCBVS = {};
+		rootParameterCBVS.type = GPU_ROOT_CBV;
+		rootParameterCBVS.shaderRegister = 0; // Register(b0)
+		rootParameterCBVS.registerSpace = 0;
+		rootParameterCBVS.visibility = GPU_VISIBILITY_VERTEX;
 		parameters.push_back(rootParameterCBVS);
 
-		D3D12_ROOT_PARAMETER rootParameterCBPS;
-		rootParameterCBPS.ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-		rootParameterCBPS.Descriptor.ShaderRegister = 0; // Register(b0)
-		rootParameterCBPS.Descriptor.RegisterSpace = 0;
-		rootParameterCBPS.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+		GPURootParameter rootParameterCBPS = {};
+		rootParameterCBPS.type = GPU_ROOT_CBV;
+		rootParameterCBPS.shaderRegister = 0; // Register(b0)
+		rootParameterCBPS.registerSpace = 0;
+		rootParameterCBPS.visibility = GPU_VISIBILITY_PIXEL;
 		parameters.push_back(rootParameterCBPS);
 
 		// Create/Update Root Signature Descrpition
-		D3D12_ROOT_SIGNATURE_DESC desc = {};
-		desc.NumParameters = parameters.size();
-		desc.pParameters = &parameters[0];
-		desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
-		ID3DBlob* serialized;
-		ID3DBlob* error;
-		D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1, &serialized, &error);
-		device->CreateRootSignature(0, serialized->GetBufferPointer(), serialized->GetBufferSize(), IID_PPV_ARGS(&rootSignature));
-		serialized->Release();
+		GPURootSignatureDesc desc = {};
+		desc.numParameters = (unsigned int)parameters.size();
+		desc.parameters = &parameters[0];
+		desc.allowInputLayout = true;
+		rootSignature = rootSignatures.get(device, desc);
 	}
 
 	int frameIndex() {
-		return swapchain->GetCurrentBackBufferIndex();
+		return frameSlot;
 	}
-	
-	// Reset command allocator and command list (Find correct command list from Back Buffer in use)
+
+	// Reset command allocator and command list for the frame slot being recorded
 	void resetCommandList() {
-		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
-		graphicsCommandAllocator[frameIndex]->Reset();
-		graphicsCommandList[frameIndex]->Reset(graphicsCommandAllocator[frameIndex], NULL);
+		graphicsCommandList[frameSlot]->reset();
 	}
 
-	// Will need this when issuing commands
-	ID3D12GraphicsCommandList4* getCommandList() {
-		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
-		return graphicsCommandList[frameIndex];
+	// Will need this when issuing commands, transition() resources before using them
+	TrackedCommandList* getCommandList() {
+		return graphicsCommandList[frameSlot];
 	}
 
 	// Close and execute the list
 	void runCommandList() {
-		getCommandList()->Close();
-		ID3D12CommandList* lists[] = { getCommandList() };
-		graphicsQueue->ExecuteCommandLists(1, lists);
+		getCommandList()->close();
+		// Order this list after any streamed copies it reads from
+		if (streamingWaitValue > streamingSafeValue) {
+			graphicsQueue->wait(copyQueueFence.fence, streamingWaitValue);
+			streamingSafeValue = streamingWaitValue;
+		}
+		GPUCommandList* lists[] = { getCommandList()->commandList };
+		graphicsQueue->executeCommandLists(1, lists);
 	}
 
 	void flushGraphicsQueue() {
-		graphicsQueueFence[0].signal(graphicsQueue);
-		graphicsQueueFence[0].wait();
+		graphicsQueueFence.signal(graphicsQueue);
+		graphicsQueueFence.wait();
 	}
 
 	void beginFrame() {
 		// Find Backbuffer index
-		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
-
-		// Ensure the GPU has finished and present current backbuffer
-		graphicsQueueFence[frameIndex].wait();
+		unsigned int frameIndex = swapchain->getCurrentBackBufferIndex();
 
-		// Find RenderTargetView at index - Find value from heap, Increment by index
-		D3D12_CPU_DESCRIPTOR_HANDLE renderTargetViewHandle = backbufferHeap -> GetCPUDescriptorHandleForHeapStart();
-		unsigned int renderTargetViewDescriptorSize = device -> GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-		renderTargetViewHandle.ptr += frameIndex * renderTargetViewDescriptorSize;
+		// Ensure the GPU has finished the last frame recorded in this slot
+		graphicsQueueFence.wait(frameFenceValues[frameSlot]);
+		memory.beginFrame();
+		constantBufferRing.beginFrame(frameSlot);
+		beginStreamingFrame();
+		recordingFrame = true;
 
 		// Clear Backbuffer and Depth Buffer  Issue commands on the command list
+		GPUResource* backbuffer = swapchain->getBackbuffer(frameIndex);
 		resetCommandList();
-		Barrier::add(backbuffers[frameIndex], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET, getCommandList());
-		getCommandList()->OMSetRenderTargets(1, &renderTargetViewHandle, FALSE, &dsvHandle);
+		getCommandList()->transition(backbuffer, GPU_STATE_RENDER_TARGET);
+		getCommandList()->transition(dsv, GPU_STATE_DEPTH_WRITE);
+		getCommandList()->setRenderTargets(backbuffer, dsv);
 		float color[4];
 		color[0] = 0; color[1] = 0; color[2] = 1.0; color[3] = 1.0;
-		getCommandList()->ClearRenderTargetView(renderTargetViewHandle, color, 0, NULL);
-		getCommandList()->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, NULL);
+		getCommandList()->clearRenderTarget(backbuffer, color);
+		getCommandList()->clearDepth(dsv, 1.0f);
 	}
 
 	void finishFrame() {
-		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
-		Barrier::add(backbuffers[frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT, getCommandList());
+		unsigned int frameIndex = swapchain->getCurrentBackBufferIndex();
+		getCommandList()->transition(swapchain->getBackbuffer(frameIndex), GPU_STATE_PRESENT);
 		runCommandList();
-		graphicsQueueFence[frameIndex].signal(graphicsQueue);
-		swapchain->Present(1, 0);
+		recordingFrame = false;
+		barrierFrame = getCommandList()->states.stats;
+		barrierTotal.transitions += barrierFrame.transitions;
+		barrierTotal.redundant += barrierFrame.redundant;
+		barrierTotal.barriers += barrierFrame.barriers;
+		barrierTotal.flushes += barrierFrame.flushes;
+		if (barrierFrame.largestFlush > barrierTotal.largestFlush) barrierTotal.largestFlush = barrierFrame.largestFlush;
+		frameFenceValues[frameSlot] = graphicsQueueFence.signal(graphicsQueue);
+		memory.endFrame(frameFenceValues[frameSlot]);
+		endStreamingFrame();
+		swapchain->present(1);
+		frameSlot = (frameSlot + 1) % framesInFlight;
 	}
 
-	void uploadResource(ID3D12Resource* dstResource, const void* data, unsigned int size, D3D12_RESOURCE_STATES targetState,
-						D3D12_PLACED_SUBRESOURCE_FOOTPRINT* texFootprint = NULL) {
-		// Open the Command List so we can record commands
-		resetCommandList();
-		
-		// Allocate memory in upload heap
-		ID3D12Resource* uploadBuffer;
-		D3D12_HEAP_PROPERTIES heapProps = {};
-		heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-		D3D12_RESOURCE_DESC bufferDesc = {};
-		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		bufferDesc.Width = size;
-		bufferDesc.Height = 1;
-		bufferDesc.DepthOrArraySize = 1;
-		bufferDesc.MipLevels = 1;
-		bufferDesc.SampleDesc.Count = 1;
-		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-		device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&uploadBuffer));
-
-		// Get pointer to allocated memory on upload heap (Map) - Memcpy vertex data (or any data) - Tell driver we are done (Unmap)
-		void* mappeddata = NULL;
-		uploadBuffer->Map(0, NULL, &mappeddata);
-		memcpy(mappeddata, data, size);
-		uploadBuffer->Unmap(0, NULL);
-
-		// Transition the destination resource to COPY_DEST before the copy command
-		Barrier::add(dstResource, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST, getCommandList());
-
-		// Issue copy command
+	// Copy data into a GPU resource through the staging ring
+	// Inside beginUploads()/endUploads() the copy is only queued, otherwise it is submitted and waited for here
+	void uploadResource(GPUResource* dstResource, const void* data, unsigned int size, GPUResourceState targetState,
+						GPUTextureFootprint* texFootprint = NULL) {
+		if (!streaming && !batchingUploads && !canSubmitUploads("uploadResource")) return;
+		UploadBatch& batch = streaming ? streamingUploads : uploads;
 		if (texFootprint != NULL) {
-			D3D12_TEXTURE_COPY_LOCATION src = {};
-			src.pResource = uploadBuffer;
-			src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-			src.PlacedFootprint = *texFootprint;
-			D3D12_TEXTURE_COPY_LOCATION dst = {};
-			dst.pResource = dstResource;
-			dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-			dst.SubresourceIndex = 0;
-			getCommandList()->CopyTextureRegion(&dst, 0, 0, 0, &src, NULL);
+			batch.queueTexture(dstResource, data, size, *texFootprint, targetState);
 		} else {
-			getCommandList()->CopyBufferRegion(dstResource, 0, uploadBuffer, 0, size);
+			batch.queueBuffer(dstResource, data, size, targetState);
 		}
+		if (streaming) streamingFrameBytes += size;
+		else if (!batchingUploads) uploads.flush();
+	}
 
-		// Transition buffer to final state after copying
-		Barrier::add(dstResource, D3D12_RESOURCE_STATE_COPY_DEST, targetState, getCommandList());
+	// Batch every uploadResource call until endUploads (e.g. around loading a scene)
+	// async sends the batch to the copy queue and lets frames keep rendering while it runs
+	void beginUploads(bool async = false) {
+		if (!async) canSubmitUploads("beginUploads");
+		batchingUploads = true;
+		streaming = async;
+	}
 
-		// Close and execute command lists
-		runCommandList();
+	// Submit the batch once, returns the fence value to wait on if waitForCompletion is false
+	// Asynchronous batches never wait here, useResource orders the graphics queue after them
+	uint64_t endUploads(bool waitForCompletion = true) {
+		batchingUploads = false;
+		if (streaming) {
+			streaming = false;
+			return streamingUploads.submit();
+		}
+		if (!canSubmitUploads("endUploads")) return uploads.fenceValue;  // Stays queued for the next submit
+		uint64_t value = uploads.submit();
+		if (waitForCompletion) uploads.wait(value);
+		return value;
+	}
+
+	// Synchronous uploads go to the graphics queue ahead of the frame's list, but that list has already
+	// recorded its transitions from the states the resources had before them. Use beginUploads(true) mid-frame.
+	bool canSubmitUploads(const char* caller) {
+		if (!recordingFrame) return true;
+		debugLog(std::string("Core: ") + caller + " outside a streaming batch between beginFrame and finishFrame\n");
+		assert(false);
+		return false;
+	}
+
+	// Call before recording a command that reads the resource on the graphics queue
+	void useResource(GPUResource* resource) {
+		if (resource->uploadFenceValue == 0) return;
+
+		// Still queued on the CPU side, it has to be submitted before anything can wait for it
+		if (resource->uploadFenceValue == GPU_UPLOAD_PENDING) streamingUploads.submit();
+		uint64_t value = resource->uploadFenceValue;
+		resource->uploadFenceValue = 0;
+		streamingFrame.firstUses++;
+		if (value <= streamingSafeValue || value <= streamingWaitValue) return;  // Covered by an earlier wait
 
-		// Wait for the command to finish
-		flushGraphicsQueue();
+		if (streamingUploads.isComplete(value)) {
+			streamingFrame.overlapped++;
+			streamingSafeValue = value;
+		} else {
+			streamingFrame.serialized++;
+			streamingWaitValue = value;
+		}
+	}
 
-		//Release upload heap memory
-		uploadBuffer->Release();
+	void beginStreamingFrame() {
+		// Recycle staging memory from copies that have landed
+		streamingUploads.retire();
+		streamingFrame = {};
 	}
 
-	void beginRenderPass() {
-		getCommandList()->RSSetViewports(1, &viewport);
-		getCommandList()->RSSetScissorRects(1, &scissorRect);
-		getCommandList()->SetGraphicsRootSignature(rootSignature);
+	void endStreamingFrame() {
+		streamingFrame.submits = streamingUploads.stats.submits - streamingFrameSubmits;
+		streamingFrame.bytes = streamingFrameBytes;
+		streamingFrame.copiesInFlight = streamingUploads.isComplete(streamingUploads.fenceValue) ? 0 : 1;
+		streamingFrameSubmits = streamingUploads.stats.submits;
+		streamingFrameBytes = 0;
+
+		streamingTotal.submits += streamingFrame.submits;
+		streamingTotal.bytes += streamingFrame.bytes;
+		streamingTotal.firstUses += streamingFrame.firstUses;
+		streamingTotal.overlapped += streamingFrame.overlapped;
+		streamingTotal.serialized += streamingFrame.serialized;
+		streamingTotal.copiesInFlight += streamingFrame.copiesInFlight;
 	}
-};
\ No newline at end of file
+
+	// NULL binds the default root signature
+	void beginRenderPass(GPURootSignature* signature = NULL) {
+		getCommandList()->setViewport(viewport);
+		getCommandList()->setScissorRect(scissorRect);
+		getCommandList()->setRootSignature(signature ? signature : rootSignature);
+	}
+};
@@ -0,0 +1,771 @@
+#pragma once
+
+#include <d3d12.h>
+#include <d3d12shader.h>
+#include <dxgi1_6.h>
+#include <d3dcompiler.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+
+#include "GPUDevice.h"
+#include "Platform.h"
+
+#pragma comment(lib, "d3d12")
+#pragma comment(lib, "dxgi")
+#pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "dxguid.lib")
+
+// D3D12 implementation of the GPUDevice interface
+
+inline DXGI_FORMAT toDXGIFormat(GPUFormat format) {
+	switch (format) {
+	case GPU_FORMAT_R8G8B8A8_UNORM: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case GPU_FORMAT_R32_FLOAT: return DXGI_FORMAT_R32_FLOAT;
+	case GPU_FORMAT_R32G32_FLOAT: return DXGI_FORMAT_R32G32_FLOAT;
+	case GPU_FORMAT_R32G32B32_FLOAT: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case GPU_FORMAT_R32G32B32A32_FLOAT: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case GPU_FORMAT_R16_UINT: return DXGI_FORMAT_R16_UINT;
+	case GPU_FORMAT_R32_UINT: return DXGI_FORMAT_R32_UINT;
+	case GPU_FORMAT_D32_FLOAT: return DXGI_FORMAT_D32_FLOAT;
+	default: return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+inline D3D12_COMMAND_LIST_TYPE toCommandListType(GPUQueueType type) {
+	switch (type) {
+	case GPU_QUEUE_COPY: return D3D12_COMMAND_LIST_TYPE_COPY;
+	case GPU_QUEUE_COMPUTE: return D3D12_COMMAND_LIST_TYPE_COMPUTE;
+	default: return D3D12_COMMAND_LIST_TYPE_DIRECT;
+	}
+}
+
+inline D3D12_COMPARISON_FUNC toComparisonFunc(GPUComparisonFunc func) {
+	switch (func) {
+	case GPU_COMPARISON_NEVER: return D3D12_COMPARISON_FUNC_NEVER;
+	case GPU_COMPARISON_LESS_EQUAL: return D3D12_COMPARISON_FUNC_LESS_EQUAL;
+	case GPU_COMPARISON_EQUAL: return D3D12_COMPARISON_FUNC_EQUAL;
+	case GPU_COMPARISON_ALWAYS: return D3D12_COMPARISON_FUNC_ALWAYS;
+	default: return D3D12_COMPARISON_FUNC_LESS;
+	}
+}
+
+inline D3D12_SHADER_VISIBILITY toShaderVisibility(GPUShaderVisibility visibility) {
+	switch (visibility) {
+	case GPU_VISIBILITY_VERTEX: return D3D12_SHADER_VISIBILITY_VERTEX;
+	case GPU_VISIBILITY_PIXEL: return D3D12_SHADER_VISIBILITY_PIXEL;
+	default: return D3D12_SHADER_VISIBILITY_ALL;
+	}
+}
+
+// Fixed-size RTV or DSV heap, slots come back when their texture is destroyed
+class D3D12ViewHeap {
+public:
+	ID3D12DescriptorHeap* heap = NULL;
+	unsigned int capacity = 0;
+	unsigned int increment = 0;
+	unsigned int used = 0;             // Slots handed out at least once
+	std::vector<unsigned int> freed;
+
+	void initialize(ID3D12Device5* device, D3D12_DESCRIPTOR_HEAP_TYPE type, unsigned int _capacity) {
+		capacity = _capacity;
+		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+		heapDesc.NumDescriptors = capacity;
+		heapDesc.Type = type;
+		device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heap));
+		increment = device->GetDescriptorHandleIncrementSize(type);
+	}
+
+	~D3D12ViewHeap() {
+		if (heap) heap->Release();
+	}
+
+	// False when every slot is taken, the caller must not create the view
+	bool allocate(unsigned int& slot, D3D12_CPU_DESCRIPTOR_HANDLE& handle) {
+		if (!freed.empty()) {
+			slot = freed.back();
+			freed.pop_back();
+		} else if (used < capacity) {
+			slot = used++;
+		} else {
+			debugLog("D3D12Device: all " + std::to_string(capacity) + " target views are in use, raise maxTextureViews\n");
+			assert(false);
+			return false;
+		}
+		handle = heap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += (SIZE_T)slot * increment;
+		return true;
+	}
+
+	void release(unsigned int slot) { freed.push_back(slot); }
+};
+
+class D3D12Resource : public GPUResource {
+public:
+	ID3D12Resource* resource = NULL;
+	uint64_t size = 0;
+	D3D12_CPU_DESCRIPTOR_HANDLE view = {};  // RTV or DSV if the resource is used as a target
+	D3D12ViewHeap* viewHeap = NULL;         // Where view came from, NULL if there is none
+	unsigned int viewSlot = 0;
+
+	~D3D12Resource() {
+		if (viewHeap) viewHeap->release(viewSlot);
+		if (resource) resource->Release();
+	}
+
+	void* map() override {
+		void* data = NULL;
+		resource->Map(0, NULL, &data);
+		return data;
+	}
+
+	void unmap() override { resource->Unmap(0, NULL); }
+	uint64_t getGPUAddress() const override { return resource->GetGPUVirtualAddress(); }
+	uint64_t getSize() const override { return size; }
+};
+
+class D3D12Heap : public GPUHeap {
+public:
+	ID3D12Heap* heap;
+	~D3D12Heap() { heap->Release(); }
+};
+
+class D3D12FenceObject : public GPUFenceObject {
+public:
+	ID3D12Fence* fence;
+	HANDLE eventHandle;
+
+	~D3D12FenceObject() {
+		CloseHandle(eventHandle);
+		fence->Release();
+	}
+
+	uint64_t getCompletedValue() override { return fence->GetCompletedValue(); }
+
+	void waitForValue(uint64_t value) override {
+		if (fence->GetCompletedValue() < value) {
+			fence->SetEventOnCompletion(value, eventHandle);
+			WaitForSingleObject(eventHandle, INFINITE);
+		}
+	}
+};
+
+class D3D12RootSignature : public GPURootSignature {
+public:
+	ID3D12RootSignature* rootSignature;
+	~D3D12RootSignature() { rootSignature->Release(); }
+};
+
+class D3D12PipelineState : public GPUPipelineState {
+public:
+	ID3D12PipelineState* pso;
+	~D3D12PipelineState() { pso->Release(); }
+};
+
+class D3D12CommandList : public GPUCommandList {
+public:
+	ID3D12CommandAllocator* allocator;
+	ID3D12GraphicsCommandList4* commandList;
+
+	~D3D12CommandList() {
+		commandList->Release();
+		allocator->Release();
+	}
+
+	void reset() override {
+		allocator->Reset();
+		commandList->Reset(allocator, NULL);
+	}
+
+	void close() override { commandList->Close(); }
+
+	void resourceBarriers(unsigned int count, const GPUBarrier* barriers) override {
+		// Translate in small batches so there is no allocation per call
+		D3D12_RESOURCE_BARRIER rb[16];
+		while (count > 0) {
+			unsigned int batch = (count < 16) ? count : 16;
+			for (unsigned int i = 0; i < batch; i++) {
+				rb[i] = {};
+				rb[i].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+				rb[i].Transition.pResource = ((D3D12Resource*)barriers[i].resource)->resource;
+				rb[i].Transition.StateBefore = (D3D12_RESOURCE_STATES)barriers[i].before;
+				rb[i].Transition.StateAfter = (D3D12_RESOURCE_STATES)barriers[i].after;
+				rb[i].Transition.Subresource = barriers[i].subresource;
+			}
+			commandList->ResourceBarrier(batch, rb);
+			barriers += batch;
+			count -= batch;
+		}
+	}
+
+	void copyBufferRegion(GPUResource* dst, uint64_t dstOffset, GPUResource* src, uint64_t srcOffset, uint64_t size) override {
+		commandList->CopyBufferRegion(((D3D12Resource*)dst)->resource, dstOffset, ((D3D12Resource*)src)->resource, srcOffset, size);
+	}
+
+	void copyTextureRegion(GPUResource* dst, unsigned int dstSubresource, GPUResource* src, const GPUTextureFootprint& srcFootprint) override {
+		D3D12_TEXTURE_COPY_LOCATION srcLocation = {};
+		srcLocation.pResource = ((D3D12Resource*)src)->resource;
+		srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+		srcLocation.PlacedFootprint.Offset = srcFootprint.offset;
+		srcLocation.PlacedFootprint.Footprint.Format = toDXGIFormat(srcFootprint.format);
+		srcLocation.PlacedFootprint.Footprint.Width = srcFootprint.width;
+		srcLocation.PlacedFootprint.Footprint.Height = srcFootprint.height;
+		srcLocation.PlacedFootprint.Footprint.Depth = srcFootprint.depth;
+		srcLocation.PlacedFootprint.Footprint.RowPitch = srcFootprint.rowPitch;
+		D3D12_TEXTURE_COPY_LOCATION dstLocation = {};
+		dstLocation.pResource = ((D3D12Resource*)dst)->resource;
+		dstLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+		dstLocation.SubresourceIndex = dstSubresource;
+		commandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, NULL);
+	}
+
+	void setRenderTargets(GPUResource* renderTarget, GPUResource* depthBuffer) override {
+		D3D12_CPU_DESCRIPTOR_HANDLE rtv = ((D3D12Resource*)renderTarget)->view;
+		if (depthBuffer != NULL) {
+			D3D12_CPU_DESCRIPTOR_HANDLE dsv = ((D3D12Resource*)depthBuffer)->view;
+			commandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+		} else {
+			commandList->OMSetRenderTargets(1, &rtv, FALSE, NULL);
+		}
+	}
+
+	void clearRenderTarget(GPUResource* renderTarget, const float colour[4]) override {
+		commandList->ClearRenderTargetView(((D3D12Resource*)renderTarget)->view, colour, 0, NULL);
+	}
+
+	void clearDepth(GPUResource* depthBuffer, float depth) override {
+		commandList->ClearDepthStencilView(((D3D12Resource*)depthBuffer)->view, D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, NULL);
+	}
+
+	void setViewport(const GPUViewport& viewport) override {
+		D3D12_VIEWPORT vp = { viewport.topLeftX, viewport.topLeftY, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth };
+		commandList->RSSetViewports(1, &vp);
+	}
+
+	void setScissorRect(const GPURect& rect) override {
+		D3D12_RECT r = { rect.left, rect.top, rect.right, rect.bottom };
+		commandList->RSSetScissorRects(1, &r);
+	}
+
+	void setRootSignature(GPURootSignature* rootSignature) override {
+		commandList->SetGraphicsRootSignature(((D3D12RootSignature*)rootSignature)->rootSignature);
+	}
+
+	void setPipelineState(GPUPipelineState* pso) override {
+		commandList->SetPipelineState(((D3D12PipelineState*)pso)->pso);
+	}
+
+	void setRootConstantBufferView(unsigned int index, uint64_t address) override {
+		commandList->SetGraphicsRootConstantBufferView(index, address);
+	}
+
+	void setRootConstants(unsigned int index, unsigned int count, const void* data) override {
+		commandList->SetGraphicsRoot32BitConstants(index, count, data, 0);
+	}
+
+	void setPrimitiveTopology(GPUTopology topology) override {
+		switch (topology) {
+		case GPU_TOPOLOGY_TRIANGLESTRIP: commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP); break;
+		case GPU_TOPOLOGY_LINELIST: commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST); break;
+		default: commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST); break;
+		}
+	}
+
+	void setVertexBuffers(unsigned int startSlot, unsigned int count, const GPUVertexBufferView* views) override {
+		D3D12_VERTEX_BUFFER_VIEW vbViews[D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+		for (unsigned int i = 0; i < count; i++) {
+			vbViews[i].BufferLocation = views[i].bufferLocation;
+			vbViews[i].SizeInBytes = views[i].sizeInBytes;
+			vbViews[i].StrideInBytes = views[i].strideInBytes;
+		}
+		commandList->IASetVertexBuffers(startSlot, count, vbViews);
+	}
+
+	void setIndexBuffer(const GPUIndexBufferView& view) override {
+		D3D12_INDEX_BUFFER_VIEW ibView;
+		ibView.BufferLocation = view.bufferLocation;
+		ibView.SizeInBytes = view.sizeInBytes;
+		ibView.Format = toDXGIFormat(view.format);
+		commandList->IASetIndexBuffer(&ibView);
+	}
+
+	void drawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) override {
+		commandList->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+	}
+
+	void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override {
+		commandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	}
+};
+
+class D3D12Queue : public GPUQueue {
+public:
+	ID3D12CommandQueue* queue;
+
+	~D3D12Queue() { queue->Release(); }
+
+	void executeCommandLists(unsigned int count, GPUCommandList* const* lists) override {
+		ID3D12CommandList* d3dLists[16];
+		while (count > 0) {
+			unsigned int batch = (count < 16) ? count : 16;
+			for (unsigned int i = 0; i < batch; i++) d3dLists[i] = ((D3D12CommandList*)lists[i])->commandList;
+			queue->ExecuteCommandLists(batch, d3dLists);
+			lists += batch;
+			count -= batch;
+		}
+	}
+
+	void signal(GPUFenceObject* fence, uint64_t value) override {
+		queue->Signal(((D3D12FenceObject*)fence)->fence, value);
+	}
+
+	void wait(GPUFenceObject* fence, uint64_t value) override {
+		queue->Wait(((D3D12FenceObject*)fence)->fence, value);
+	}
+};
+
+class D3D12Swapchain : public GPUSwapchain {
+public:
+	IDXGISwapChain3* swapchain;
+	ID3D12DescriptorHeap* backbufferHeap;
+	std::vector<D3D12Resource*> backbuffers;
+
+	~D3D12Swapchain() {
+		for (D3D12Resource* backbuffer : backbuffers) delete backbuffer;
+		backbufferHeap->Release();
+		swapchain->Release();
+	}
+
+	unsigned int getCurrentBackBufferIndex() override { return swapchain->GetCurrentBackBufferIndex(); }
+	GPUResource* getBackbuffer(unsigned int index) override { return backbuffers[index]; }
+	void present(unsigned int syncInterval) override { swapchain->Present(syncInterval, 0); }
+};
+
+class D3D12Device : public GPUDevice {
+public:
+	// Representation of the Adapter
+	IDXGIAdapter1* adapter;
+	IDXGIFactory6* factory;
+
+	ID3D12Device5* device;
+
+	// Views for textures created through createTexture2D
+	static const unsigned int maxTextureViews = 64;
+	D3D12ViewHeap rtvHeap;
+	D3D12ViewHeap dsvHeap;
+
+	~D3D12Device() {
+		device->Release();
+		factory->Release();
+		adapter->Release();
+	}
+
+	void initialize() override {
+		// Enable the D3D12 debug layer
+		ID3D12Debug* debugController;
+		if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController)))) {
+			debugController->EnableDebugLayer();
+			debugController->Release();
+		}
+
+		// Enumerate adapters
+		IDXGIAdapter1* adapterf;
+		std::vector<IDXGIAdapter1*> adapters;
+		factory = NULL;
+		CreateDXGIFactory(__uuidof(IDXGIFactory6), (void**)&factory);
+
+		int i = 0;
+		while (factory->EnumAdapters1(i, &adapterf) != DXGI_ERROR_NOT_FOUND) {
+			adapters.push_back(adapterf);
+			i++;
+		}
+
+		// Find the best adapter
+		long long maxVideoMemory = 0;
+		int useAdapterIndex = 0;
+		for (int i = 0; i < adapters.size(); i++) {
+			DXGI_ADAPTER_DESC desc;
+			adapters[i]->GetDesc(&desc);
+			if (desc.DedicatedVideoMemory > maxVideoMemory) {
+				maxVideoMemory = desc.DedicatedVideoMemory;
+				useAdapterIndex = i;
+			}
+		}
+		adapter = adapters[useAdapterIndex];
+		for (int i = 0; i < adapters.size(); i++)
+			if (i != useAdapterIndex) adapters[i]->Release();
+
+		// Create DX12 Device on Adapter
+		D3D12CreateDevice(adapter, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&device));
+
+		// Descriptor heaps for render target and depth views
+		rtvHeap.initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, maxTextureViews);
+		dsvHeap.initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, maxTextureViews);
+	}
+
+	GPUQueue* createQueue(GPUQueueType type) override {
+		D3D12Queue* queue = new D3D12Queue();
+		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+		queueDesc.Type = toCommandListType(type);
+		device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue->queue));
+		return queue;
+	}
+
+	GPUCommandList* createCommandList(GPUQueueType type) override {
+		// CreateCommandList1 returns the list closed, reset() opens it
+		D3D12CommandList* list = new D3D12CommandList();
+		device->CreateCommandAllocator(toCommandListType(type), IID_PPV_ARGS(&list->allocator));
+		device->CreateCommandList1(0, toCommandListType(type), D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&list->commandList));
+		return list;
+	}
+
+	GPUFenceObject* createFence(uint64_t initialValue) override {
+		D3D12FenceObject* fence = new D3D12FenceObject();
+		device->CreateFence(initialValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence->fence));
+		fence->eventHandle = CreateEvent(NULL, FALSE, FALSE, NULL);
+		return fence;
+	}
+
+	GPUSwapchain* createSwapchain(GPUQueue* presentQueue, void* windowHandle, unsigned int width, unsigned int height,
+								  unsigned int bufferCount, GPUFormat format) override {
+		D3D12Swapchain* sc = new D3D12Swapchain();
+
+		// Swapchain
+		DXGI_SWAP_CHAIN_DESC1 scDesc = {};
+		scDesc.Format = toDXGIFormat(format);
+		scDesc.Width = width;
+		scDesc.Height = height;
+		scDesc.SampleDesc.Count = 1;  // MSAA here
+		scDesc.SampleDesc.Quality = 0;
+		scDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		scDesc.BufferCount = bufferCount;
+		scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;  // Stop copying memory and start swapping pointers
+
+		// Create the swapchain
+		IDXGISwapChain1* swapChain1;
+		factory->CreateSwapChainForHwnd(((D3D12Queue*)presentQueue)->queue, (HWND)windowHandle, &scDesc, NULL, NULL, &swapChain1);
+		swapChain1->QueryInterface(&sc->swapchain);
+		swapChain1->Release();
+
+		// Create Heap
+		D3D12_DESCRIPTOR_HEAP_DESC renderTargetViewHeapDesc = {};
+		renderTargetViewHeapDesc.NumDescriptors = scDesc.BufferCount;
+		renderTargetViewHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+		device->CreateDescriptorHeap(&renderTargetViewHeapDesc, IID_PPV_ARGS(&sc->backbufferHeap));
+
+		// Get backbuffers and create views on heap
+		D3D12_CPU_DESCRIPTOR_HANDLE renderTargetViewHandle = sc->backbufferHeap->GetCPUDescriptorHandleForHeapStart();
+		unsigned int renderTargetViewDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+		for (unsigned int i = 0; i < scDesc.BufferCount; i++) {
+			D3D12Resource* backbuffer = new D3D12Resource();
+			sc->swapchain->GetBuffer(i, IID_PPV_ARGS(&backbuffer->resource));
+			device->CreateRenderTargetView(backbuffer->resource, nullptr, renderTargetViewHandle);
+			backbuffer->view = renderTargetViewHandle;
+			sc->backbuffers.push_back(backbuffer);
+			renderTargetViewHandle.ptr += renderTargetViewDescriptorSize;
+		}
+		return sc;
+	}
+
+	GPUResource* createBuffer(GPUHeapType heap, uint64_t sizeInBytes, GPUResourceState initialState) override {
+		// Default heap is fast GPU memory, upload heap is CPU visible
+		D3D12_HEAP_PROPERTIES heapprops = {};
+		heapprops.Type = (heap == GPU_HEAP_UPLOAD) ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT;
+		heapprops.CreationNodeMask = 1;
+		heapprops.VisibleNodeMask = 1;
+
+		D3D12_RESOURCE_DESC desc = bufferDesc(sizeInBytes);
+		D3D12Resource* buffer = new D3D12Resource();
+		buffer->state = initialState;
+		buffer->size = sizeInBytes;
+		device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &desc, (D3D12_RESOURCE_STATES)initialState, NULL, IID_PPV_ARGS(&buffer->resource));
+		return buffer;
+	}
+
+	GPUResource* createTexture2D(const GPUTextureDesc& desc, GPUResourceState initialState) override {
+		// Textures live in fast on chip memory
+		D3D12_HEAP_PROPERTIES heapprops = {};
+		heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
+		heapprops.CreationNodeMask = 1;
+		heapprops.VisibleNodeMask = 1;
+
+		D3D12_RESOURCE_DESC texDesc = textureDesc(desc);
+		D3D12_CLEAR_VALUE clearValue = textureClearValue(desc, texDesc);
+		bool hasClearValue = (desc.flags & (GPU_TEXTURE_DEPTH_STENCIL | GPU_TEXTURE_RENDER_TARGET)) != 0;
+
+		D3D12Resource* texture = new D3D12Resource();
+		texture->state = initialState;
+		device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &texDesc, (D3D12_RESOURCE_STATES)initialState,
+										hasClearValue ? &clearValue : NULL, IID_PPV_ARGS(&texture->resource));
+		texture->size = device->GetResourceAllocationInfo(0, 1, &texDesc).SizeInBytes;
+		createTargetView(texture, desc, texDesc);
+		return texture;
+	}
+
+	GPUHeap* createHeap(GPUHeapType type, GPUHeapUsage usage, uint64_t sizeInBytes) override {
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = sizeInBytes;
+		heapDesc.Properties.Type = (type == GPU_HEAP_UPLOAD) ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT;
+		heapDesc.Properties.CreationNodeMask = 1;
+		heapDesc.Properties.VisibleNodeMask = 1;
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		// Resource heap tier 1 needs buffers, textures and render targets kept apart
+		if (usage == GPU_HEAP_USAGE_BUFFERS) heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+		else if (usage == GPU_HEAP_USAGE_TEXTURES) heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+		else heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+
+		D3D12Heap* heap = new D3D12Heap();
+		device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap->heap));
+		return heap;
+	}
+
+	GPUResource* createPlacedBuffer(GPUHeap* heap, uint64_t offset, uint64_t sizeInBytes, GPUResourceState initialState) override {
+		D3D12_RESOURCE_DESC desc = bufferDesc(sizeInBytes);
+		D3D12Resource* buffer = new D3D12Resource();
+		buffer->state = initialState;
+		buffer->size = sizeInBytes;
+		device->CreatePlacedResource(((D3D12Heap*)heap)->heap, offset, &desc, (D3D12_RESOURCE_STATES)initialState, NULL, IID_PPV_ARGS(&buffer->resource));
+		return buffer;
+	}
+
+	GPUResource* createPlacedTexture2D(GPUHeap* heap, uint64_t offset, const GPUTextureDesc& desc, GPUResourceState initialState) override {
+		D3D12_RESOURCE_DESC texDesc = textureDesc(desc);
+		D3D12_CLEAR_VALUE clearValue = textureClearValue(desc, texDesc);
+		bool hasClearValue = (desc.flags & (GPU_TEXTURE_DEPTH_STENCIL | GPU_TEXTURE_RENDER_TARGET)) != 0;
+
+		D3D12Resource* texture = new D3D12Resource();
+		texture->state = initialState;
+		device->CreatePlacedResource(((D3D12Heap*)heap)->heap, offset, &texDesc, (D3D12_RESOURCE_STATES)initialState,
+									 hasClearValue ? &clearValue : NULL, IID_PPV_ARGS(&texture->resource));
+		texture->size = device->GetResourceAllocationInfo(0, 1, &texDesc).SizeInBytes;
+		createTargetView(texture, desc, texDesc);
+		return texture;
+	}
+
+	void getTextureAllocationInfo(const GPUTextureDesc& desc, uint64_t& sizeInBytes, uint64_t& alignment) override {
+		D3D12_RESOURCE_DESC texDesc = textureDesc(desc);
+		D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &texDesc);
+		sizeInBytes = info.SizeInBytes;
+		alignment = info.Alignment;
+	}
+
+	static D3D12_RESOURCE_DESC bufferDesc(uint64_t sizeInBytes) {
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Width = sizeInBytes;
+		desc.Height = 1;
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		desc.DepthOrArraySize = 1;
+		desc.MipLevels = 1;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		return desc;
+	}
+
+	// Specify resource information
+	static D3D12_RESOURCE_DESC textureDesc(const GPUTextureDesc& desc) {
+		D3D12_RESOURCE_DESC texDesc = {};
+		texDesc.Format = toDXGIFormat(desc.format);
+		texDesc.Width = desc.width;
+		texDesc.Height = desc.height;
+		texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+		texDesc.DepthOrArraySize = 1;
+		texDesc.MipLevels = 1;
+		texDesc.SampleDesc.Count = 1;
+		texDesc.SampleDesc.Quality = 0;
+		texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+		if (desc.flags & GPU_TEXTURE_DEPTH_STENCIL) texDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+		if (desc.flags & GPU_TEXTURE_RENDER_TARGET) texDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+		return texDesc;
+	}
+
+	static D3D12_CLEAR_VALUE textureClearValue(const GPUTextureDesc& desc, const D3D12_RESOURCE_DESC& texDesc) {
+		D3D12_CLEAR_VALUE clearValue = {};
+		clearValue.Format = texDesc.Format;
+		clearValue.DepthStencil.Depth = desc.clearDepth;
+		clearValue.DepthStencil.Stencil = 0;
+		return clearValue;
+	}
+
+	// Create DepthStencilView / RenderTargetView to Resource on descriptor heap
+	void createTargetView(D3D12Resource* texture, const GPUTextureDesc& desc, const D3D12_RESOURCE_DESC& texDesc) {
+		if (desc.flags & GPU_TEXTURE_DEPTH_STENCIL) {
+			D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
+			depthStencilDesc.Format = texDesc.Format;
+			depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+			depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
+			if (!dsvHeap.allocate(texture->viewSlot, texture->view)) return;
+			texture->viewHeap = &dsvHeap;
+			device->CreateDepthStencilView(texture->resource, &depthStencilDesc, texture->view);
+		} else if (desc.flags & GPU_TEXTURE_RENDER_TARGET) {
+			if (!rtvHeap.allocate(texture->viewSlot, texture->view)) return;
+			texture->viewHeap = &rtvHeap;
+			device->CreateRenderTargetView(texture->resource, nullptr, texture->view);
+		}
+	}
+
+	GPURootSignature* createRootSignature(const GPURootSignatureDesc& desc) override {
+		std::vector<D3D12_ROOT_PARAMETER> parameters(desc.numParameters);
+		for (unsigned int i = 0; i < desc.numParameters; i++) {
+			const GPURootParameter& param = desc.parameters[i];
+			parameters[i] = {};
+			if (param.type == GPU_ROOT_CONSTANTS) {
+				parameters[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+				parameters[i].Constants.ShaderRegister = param.shaderRegister;
+				parameters[i].Constants.RegisterSpace = param.registerSpace;
+				parameters[i].Constants.Num32BitValues = param.num32BitValues;
+			} else {
+				parameters[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+				parameters[i].Descriptor.ShaderRegister = param.shaderRegister;
+				parameters[i].Descriptor.RegisterSpace = param.registerSpace;
+			}
+			parameters[i].ShaderVisibility = toShaderVisibility(param.visibility);
+		}
+
+		// Create/Update Root Signature Descrpition
+		D3D12_ROOT_SIGNATURE_DESC rsDesc = {};
+		rsDesc.NumParameters = desc.numParameters;
+		rsDesc.pParameters = parameters.empty() ? NULL : &parameters[0];
+		rsDesc.Flags = desc.allowInputLayout ? D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT : D3D12_ROOT_SIGNATURE_FLAG_NONE;
+		ID3DBlob* serialized;
+		ID3DBlob* error = NULL;
+		if (FAILED(D3D12SerializeRootSignature(&rsDesc, D3D_ROOT_SIGNATURE_VERSION_1, &serialized, &error))) {
+			if (error) {
+				debugLog((char*)error->GetBufferPointer());
+				error->Release();
+			}
+			return NULL;
+		}
+		D3D12RootSignature* rootSignature = new D3D12RootSignature();
+		device->CreateRootSignature(0, serialized->GetBufferPointer(), serialized->GetBufferSize(), IID_PPV_ARGS(&rootSignature->rootSignature));
+		serialized->Release();
+		return rootSignature;
+	}
+
+	GPUPipelineState* createPipelineState(const GPUPipelineDesc& pipelineDesc) override {
+		// Input layout
+		std::vector<D3D12_INPUT_ELEMENT_DESC> inputLayout(pipelineDesc.inputLayout.numElements);
+		for (unsigned int i = 0; i < pipelineDesc.inputLayout.numElements; i++) {
+			const GPUInputElement& element = pipelineDesc.inputLayout.elements[i];
+			inputLayout[i] = { element.semanticName, element.semanticIndex, toDXGIFormat(element.format), element.inputSlot,
+							   element.alignedByteOffset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+		}
+
+		// Configure GPU pipeline with shaders, layout and Root Signature
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+		desc.InputLayout.NumElements = (UINT)inputLayout.size();
+		desc.InputLayout.pInputElementDescs = inputLayout.empty() ? NULL : &inputLayout[0];
+		desc.pRootSignature = ((D3D12RootSignature*)pipelineDesc.rootSignature)->rootSignature;
+		desc.VS = { pipelineDesc.vs.code, pipelineDesc.vs.size };
+		desc.PS = { pipelineDesc.ps.code, pipelineDesc.ps.size };
+
+		// Rasterizer State - Responsible for configuring the rasterizer
+		D3D12_RASTERIZER_DESC rasterDesc = {};
+		rasterDesc.FillMode = (pipelineDesc.fillMode == GPU_FILL_WIREFRAME) ? D3D12_FILL_MODE_WIREFRAME : D3D12_FILL_MODE_SOLID;
+		rasterDesc.CullMode = (pipelineDesc.cullMode == GPU_CULL_FRONT) ? D3D12_CULL_MODE_FRONT :
+							  (pipelineDesc.cullMode == GPU_CULL_BACK) ? D3D12_CULL_MODE_BACK : D3D12_CULL_MODE_NONE;
+		rasterDesc.FrontCounterClockwise = pipelineDesc.frontCounterClockwise;
+		rasterDesc.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
+		rasterDesc.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
+		rasterDesc.SlopeScaledDepthBias = D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
+		rasterDesc.DepthClipEnable = pipelineDesc.depthClipEnable;
+		rasterDesc.MultisampleEnable = FALSE;
+		rasterDesc.AntialiasedLineEnable = FALSE;
+		rasterDesc.ForcedSampleCount = 0;
+		rasterDesc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
+		desc.RasterizerState = rasterDesc;
+
+		// Depth Stencil State - Responsible for configuring the depth buffer
+		D3D12_DEPTH_STENCIL_DESC depthStencilDesc = {};
+		depthStencilDesc.DepthEnable = pipelineDesc.depthEnable;
+		depthStencilDesc.DepthWriteMask = pipelineDesc.depthWrite ? D3D12_DEPTH_WRITE_MASK_ALL : D3D12_DEPTH_WRITE_MASK_ZERO;
+		depthStencilDesc.DepthFunc = toComparisonFunc(pipelineDesc.depthFunc);
+		depthStencilDesc.StencilEnable = FALSE;
+		desc.DepthStencilState = depthStencilDesc;
+
+		// Blend State
+		D3D12_BLEND_DESC blendDesc = {};
+		blendDesc.AlphaToCoverageEnable = FALSE;
+		blendDesc.IndependentBlendEnable = FALSE;
+		const D3D12_RENDER_TARGET_BLEND_DESC defaultRenderTargetBlend =
+			{ FALSE, FALSE, D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_BLEND_ONE,
+			  D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL
+			};
+		const D3D12_RENDER_TARGET_BLEND_DESC alphaRenderTargetBlend =
+			{ TRUE, FALSE, D3D12_BLEND_SRC_ALPHA, D3D12_BLEND_INV_SRC_ALPHA, D3D12_BLEND_OP_ADD, D3D12_BLEND_ONE,
+			  D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL
+			};
+
+		for (int i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+			blendDesc.RenderTarget[i] = pipelineDesc.blendEnable ? alphaRenderTargetBlend : defaultRenderTargetBlend;
+		desc.BlendState = blendDesc;
+
+		// Render Target State and Topology
+		desc.SampleMask = UINT_MAX;
+		desc.PrimitiveTopologyType = (pipelineDesc.topologyType == GPU_TOPOLOGY_TYPE_LINE) ? D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE : D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		desc.NumRenderTargets = 1;
+		desc.RTVFormats[0] = toDXGIFormat(pipelineDesc.rtvFormat);
+		desc.DSVFormat = toDXGIFormat(pipelineDesc.dsvFormat);
+		desc.SampleDesc.Count = 1;
+
+		// Create Pipeline State Object
+		D3D12PipelineState* pso = new D3D12PipelineState();
+		if (FAILED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso->pso)))) {
+			debugLog("D3D12Device: CreateGraphicsPipelineState failed\n");
+			delete pso;
+			return NULL;
+		}
+		return pso;
+	}
+
+	bool reflectShader(const void* bytecode, size_t size, ShaderReflection& reflection) override {
+		// Reflect shader and get details (description)
+		ID3D12ShaderReflection* shaderReflection;
+		if (FAILED(D3DReflect(bytecode, size, IID_PPV_ARGS(&shaderReflection)))) return false;
+		D3D12_SHADER_DESC desc;
+		shaderReflection->GetDesc(&desc);
+
+		// Iterate over constant buffers
+		for (unsigned int i = 0; i < desc.ConstantBuffers; i++) {
+			ID3D12ShaderReflectionConstantBuffer* constantBuffer = shaderReflection->GetConstantBufferByIndex(i);
+			D3D12_SHADER_BUFFER_DESC cbDesc;
+			constantBuffer->GetDesc(&cbDesc);
+
+			ConstantBufferReflection buffer;
+			buffer.name = cbDesc.Name;
+			buffer.size = cbDesc.Size;
+			buffer.bindPoint = 0;
+			D3D12_SHADER_INPUT_BIND_DESC bindDesc;
+			if (SUCCEEDED(shaderReflection->GetResourceBindingDescByName(cbDesc.Name, &bindDesc))) buffer.bindPoint = bindDesc.BindPoint;
+
+			// Iterate over variables in constant buffer
+			for (unsigned int j = 0; j < cbDesc.Variables; j++) {
+				ID3D12ShaderReflectionVariable* var = constantBuffer->GetVariableByIndex(j);
+				D3D12_SHADER_VARIABLE_DESC vDesc;
+				var->GetDesc(&vDesc);
+				ConstantBufferVariable bufferVariable;
+				bufferVariable.name = vDesc.Name;
+				bufferVariable.offset = vDesc.StartOffset;
+				bufferVariable.size = vDesc.Size;
+				buffer.variables.push_back(bufferVariable);
+			}
+			reflection.constantBuffers.push_back(buffer);
+		}
+
+		for (unsigned int i = 0; i < desc.InputParameters; i++) {
+			D3D12_SIGNATURE_PARAMETER_DESC parameterDesc;
+			shaderReflection->GetInputParameterDesc(i, &parameterDesc);
+			ShaderInputParameter input;
+			input.semanticName = parameterDesc.SemanticName;
+			input.semanticIndex = parameterDesc.SemanticIndex;
+			input.registerIndex = parameterDesc.Register;
+			input.componentType = (unsigned int)parameterDesc.ComponentType;
+			input.mask = parameterDesc.Mask;
+			reflection.inputs.push_back(input);
+		}
+
+		shaderReflection->Release();
+		return true;
+	}
+};
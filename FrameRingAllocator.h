@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vector>
+
+#include "GPUDevice.h"
+#include "GPUMemoryAllocator.h"
+#include "Platform.h"
+
+// A CPU write pointer and the GPU address the same bytes are visible at
+struct UploadAllocation {
+	unsigned char* cpu;
+	uint64_t gpuAddress;
+};
+
+struct FrameRingStats {
+	uint64_t capacity;       // Bytes mapped across all frames in flight
+	uint64_t usedThisFrame;
+	uint64_t highWaterMark;  // Most bytes any single frame has needed
+	uint64_t allocations;    // Since start-up
+	unsigned int grows;      // Times a frame ran over its page and had to allocate more
+};
+
+/*
+ *	Persistently mapped upload memory split into one arena per frame in flight.
+ *	A frame's arena is only reused once the caller has waited for the fence of the frame last
+ *	recorded into it, so suballocations handed out during a frame stay valid until the GPU has
+ *	consumed them. The allocator keeps no fence of its own, Core::beginFrame does the wait.
+ *	Running out of space never wraps into live data - the arena chains another page and is
+ *	resized to its high-water mark the next time it is retired.
+ */
+class FrameRingAllocator {
+public:
+	struct Page {
+		GPUResource* resource;
+		unsigned char* mapped;
+		uint64_t size;
+	};
+
+	struct Arena {
+		std::vector<Page> pages;
+		unsigned int page = 0;
+		uint64_t offset = 0;
+		uint64_t used = 0;
+	};
+
+	GPUMemoryAllocator* memory;
+	std::vector<Arena> arenas;
+	unsigned int currentFrame = 0;
+	FrameRingStats stats = {};
+
+	void initialize(GPUMemoryAllocator* _memory, unsigned int framesInFlight, uint64_t bytesPerFrame) {
+		memory = _memory;
+		arenas.resize(framesInFlight);
+		for (Arena& arena : arenas) arena.pages.push_back(createPage(bytesPerFrame));
+	}
+
+	~FrameRingAllocator() {
+		for (Arena& arena : arenas)
+			for (Page& page : arena.pages) releasePage(page);
+	}
+
+	// Start recording a frame into the arena for this slot. The caller has already waited for the
+	// last frame recorded in this slot (Core::beginFrame waits on the slot's frame fence).
+	void beginFrame(unsigned int frame) {
+		currentFrame = frame;
+		Arena& arena = arenas[frame];
+
+		// Fold an overflowed arena into one page big enough for what it needed
+		if (arena.pages.size() > 1) {
+			uint64_t size = 0;
+			for (Page& page : arena.pages) {
+				size += page.size;
+				releasePage(page);
+			}
+			arena.pages.clear();
+			arena.pages.push_back(createPage(size));
+		}
+		arena.page = 0;
+		arena.offset = 0;
+		arena.used = 0;
+		stats.usedThisFrame = 0;
+	}
+
+	UploadAllocation allocate(uint64_t size, uint64_t alignment = 256) {
+		Arena& arena = arenas[currentFrame];
+		uint64_t offset = (arena.offset + alignment - 1) & ~(alignment - 1);
+
+		// Move on to (or create) another page rather than overwrite data still in flight
+		while (offset + size > arena.pages[arena.page].size) {
+			if (arena.page + 1 >= arena.pages.size()) {
+				uint64_t pageSize = arena.pages[arena.page].size * 2;
+				while (pageSize < size) pageSize *= 2;
+				arena.pages.push_back(createPage(pageSize));
+				// Counted in stats.grows, only the first one is logged since it can happen every frame
+				if (stats.grows++ == 0) debugLog("FrameRingAllocator: frame exceeded its upload budget, growing\n");
+			}
+			arena.page++;
+			offset = 0;
+		}
+
+		Page& page = arena.pages[arena.page];
+		arena.offset = offset + size;
+		arena.used += (size + alignment - 1) & ~(alignment - 1);
+		stats.allocations++;
+		stats.usedThisFrame = arena.used;
+		if (arena.used > stats.highWaterMark) stats.highWaterMark = arena.used;
+
+		UploadAllocation allocation;
+		allocation.cpu = page.mapped + offset;
+		allocation.gpuAddress = page.resource->getGPUAddress() + offset;
+		return allocation;
+	}
+
+	Page createPage(uint64_t size) {
+		Page page;
+		page.size = size;
+		page.resource = memory->createBuffer(GPU_HEAP_UPLOAD, size, GPU_STATE_GENERIC_READ);
+		page.mapped = (unsigned char*)page.resource->map();
+		stats.capacity += size;
+		return page;
+	}
+
+	void releasePage(Page& page) {
+		page.resource->unmap();
+		delete page.resource;
+		stats.capacity -= page.size;
+	}
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "MyMath.h"
+#include "VectorStream.h"
+
+enum FrustumPlane {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_PLANE_COUNT
+};
+
+/*
+ *	The six planes of a projection * view matrix (Gribb/Hartmann), normals pointing inwards and
+ *	normalised so plane.Dot(point, 1) is a distance. Uses the D3D depth range, 0 <= z <= w.
+ */
+class Frustum {
+public:
+	Vec4 planes[FRUSTUM_PLANE_COUNT];  // x, y, z normal and w offset
+
+	void fromMatrix(const Matrix& viewProjection) {
+		const float* m = viewProjection.m;
+		Vec4 row0(m[0], m[1], m[2], m[3]);
+		Vec4 row1(m[4], m[5], m[6], m[7]);
+		Vec4 row2(m[8], m[9], m[10], m[11]);
+		Vec4 row3(m[12], m[13], m[14], m[15]);
+		planes[FRUSTUM_LEFT] = row3 + row0;
+		planes[FRUSTUM_RIGHT] = row3 - row0;
+		planes[FRUSTUM_BOTTOM] = row3 + row1;
+		planes[FRUSTUM_TOP] = row3 - row1;
+		planes[FRUSTUM_NEAR] = row2;
+		planes[FRUSTUM_FAR] = row3 - row2;
+		for (Vec4& plane : planes) plane /= sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+	}
+
+	// Scalar tests, the batch kernels below do the same arithmetic in the same order
+	bool testSphere(const Vec3& centre, float radius) const {
+		for (const Vec4& plane : planes) {
+			float distance = plane.x * centre.x + plane.y * centre.y + plane.z * centre.z + plane.w;
+			if (!(distance >= -radius)) return false;
+		}
+		return true;
+	}
+
+	// Box as centre and half size
+	bool testBox(const Vec3& centre, const Vec3& extent) const {
+		for (const Vec4& plane : planes) {
+			float distance = plane.x * centre.x + plane.y * centre.y + plane.z * centre.z + plane.w;
+			float radius = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+			if (!(distance >= -radius)) return false;
+		}
+		return true;
+	}
+};
+
+// Plane components broadcast across lanes once per batch
+struct FrustumLanes {
+	StreamLane x[FRUSTUM_PLANE_COUNT], y[FRUSTUM_PLANE_COUNT], z[FRUSTUM_PLANE_COUNT], w[FRUSTUM_PLANE_COUNT];
+	StreamLane absX[FRUSTUM_PLANE_COUNT], absY[FRUSTUM_PLANE_COUNT], absZ[FRUSTUM_PLANE_COUNT];
+
+	explicit FrustumLanes(const Frustum& frustum) {
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+			const Vec4& plane = frustum.planes[p];
+			x[p] = laneSet(plane.x); y[p] = laneSet(plane.y); z[p] = laneSet(plane.z); w[p] = laneSet(plane.w);
+			absX[p] = laneSet(fabsf(plane.x)); absY[p] = laneSet(fabsf(plane.y)); absZ[p] = laneSet(fabsf(plane.z));
+		}
+	}
+
+	StreamLane distance(int p, StreamLane cx, StreamLane cy, StreamLane cz) const {
+		return laneAdd(laneAdd(laneAdd(laneMul(x[p], cx), laneMul(y[p], cy)), laneMul(z[p], cz)), w[p]);
+	}
+};
+
+// Append STREAM_WIDTH candidate indices starting at first and keep the ones whose bit is set in
+// mask. Branch free, so visible needs STREAM_WIDTH entries of slack past count.
+inline size_t compactVisible(unsigned int mask, unsigned int first, unsigned int* visible, size_t count) {
+	for (unsigned int j = 0; j < STREAM_WIDTH; j++) {
+		visible[count] = first + j;
+		count += (mask >> j) & 1;
+	}
+	return count;
+}
+
+/*
+ *	Test every sphere against the frustum STREAM_WIDTH at a time (one AVX lane group, or two SSE
+ *	ones) and write the indices of the visible ones, in order, to visible. Padding past the end
+ *	of the streams is never reported.
+ */
+inline void frustumCullSpheres(const Frustum& frustum, const Vec3Stream& centres, const FloatStream& radii, std::vector<unsigned int>& visible) {
+	const FrustumLanes lanes(frustum);
+	const StreamLane zero = laneSet(0.f);
+	const unsigned int laneBits = (1u << LANE_WIDTH) - 1;
+	size_t n = (centres.size() + STREAM_WIDTH - 1) & ~(STREAM_WIDTH - 1);
+	visible.resize(n + STREAM_WIDTH);
+	size_t count = 0;
+	for (size_t i = 0; i < n; i += STREAM_WIDTH) {
+		unsigned int inside = 0;
+		for (size_t h = 0; h < STREAM_WIDTH; h += LANE_WIDTH) {
+			StreamLane cx = laneLoad(&centres.x[i + h]), cy = laneLoad(&centres.y[i + h]), cz = laneLoad(&centres.z[i + h]);
+			StreamLane negativeRadius = laneSub(zero, laneLoad(&radii.v[i + h]));
+			unsigned int mask = laneBits;
+			for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++)
+				mask &= laneGreaterEqualMask(lanes.distance(p, cx, cy, cz), negativeRadius);
+			inside |= mask << h;
+		}
+		count = compactVisible(inside, (unsigned int)i, &visible[0], count);
+	}
+	while (count > 0 && visible[count - 1] >= centres.size()) count--;
+	visible.resize(count);
+}
+
+// Boxes as centres and half sizes, otherwise the same as frustumCullSpheres
+inline void frustumCullBoxes(const Frustum& frustum, const Vec3Stream& centres, const Vec3Stream& extents, std::vector<unsigned int>& visible) {
+	const FrustumLanes lanes(frustum);
+	const StreamLane zero = laneSet(0.f);
+	const unsigned int laneBits = (1u << LANE_WIDTH) - 1;
+	size_t n = (centres.size() + STREAM_WIDTH - 1) & ~(STREAM_WIDTH - 1);
+	visible.resize(n + STREAM_WIDTH);
+	size_t count = 0;
+	for (size_t i = 0; i < n; i += STREAM_WIDTH) {
+		unsigned int inside = 0;
+		for (size_t h = 0; h < STREAM_WIDTH; h += LANE_WIDTH) {
+			StreamLane cx = laneLoad(&centres.x[i + h]), cy = laneLoad(&centres.y[i + h]), cz = laneLoad(&centres.z[i + h]);
+			StreamLane ex = laneLoad(&extents.x[i + h]), ey = laneLoad(&extents.y[i + h]), ez = laneLoad(&extents.z[i + h]);
+			unsigned int mask = laneBits;
+			for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+				// Projected half size of the box onto the plane normal
+				StreamLane radius = laneAdd(laneAdd(laneMul(lanes.absX[p], ex), laneMul(lanes.absY[p], ey)), laneMul(lanes.absZ[p], ez));
+				mask &= laneGreaterEqualMask(lanes.distance(p, cx, cy, cz), laneSub(zero, radius));
+			}
+			inside |= mask << h;
+		}
+		count = compactVisible(inside, (unsigned int)i, &visible[0], count);
+	}
+	while (count > 0 && visible[count - 1] >= centres.size()) count--;
+	visible.resize(count);
+}
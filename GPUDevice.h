@@ -0,0 +1,353 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ShaderReflection.h"
+
+/*
+ *	Thin device/queue/command-list interface that the renderer talks to instead of ID3D12Device5 directly.
+ *	D3D12Device.h implements it on Windows, NullDevice.h implements it everywhere (headless, records and counts calls).
+ *	Enum values mirror their D3D12 counterparts where that lets the D3D12 backend cast instead of translate.
+ */
+
+enum GPUQueueType { GPU_QUEUE_GRAPHICS, GPU_QUEUE_COPY, GPU_QUEUE_COMPUTE };
+
+enum GPUHeapType { GPU_HEAP_DEFAULT, GPU_HEAP_UPLOAD };
+
+// What a heap may hold - tier 1 hardware cannot mix these in one heap
+enum GPUHeapUsage { GPU_HEAP_USAGE_BUFFERS, GPU_HEAP_USAGE_TEXTURES, GPU_HEAP_USAGE_TARGETS };
+
+// Same bit values as D3D12_RESOURCE_STATES
+enum GPUResourceState {
+	GPU_STATE_COMMON = 0,
+	GPU_STATE_PRESENT = 0,
+	GPU_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+	GPU_STATE_INDEX_BUFFER = 0x2,
+	GPU_STATE_RENDER_TARGET = 0x4,
+	GPU_STATE_UNORDERED_ACCESS = 0x8,
+	GPU_STATE_DEPTH_WRITE = 0x10,
+	GPU_STATE_DEPTH_READ = 0x20,
+	GPU_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+	GPU_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+	GPU_STATE_COPY_DEST = 0x400,
+	GPU_STATE_COPY_SOURCE = 0x800,
+	GPU_STATE_GENERIC_READ = 0xac3
+};
+
+enum GPUFormat {
+	GPU_FORMAT_UNKNOWN,
+	GPU_FORMAT_R8G8B8A8_UNORM,
+	GPU_FORMAT_R32_FLOAT,
+	GPU_FORMAT_R32G32_FLOAT,
+	GPU_FORMAT_R32G32B32_FLOAT,
+	GPU_FORMAT_R32G32B32A32_FLOAT,
+	GPU_FORMAT_R16_UINT,
+	GPU_FORMAT_R32_UINT,
+	GPU_FORMAT_D32_FLOAT
+};
+
+enum GPUTopology { GPU_TOPOLOGY_TRIANGLELIST, GPU_TOPOLOGY_TRIANGLESTRIP, GPU_TOPOLOGY_LINELIST };
+enum GPUTopologyType { GPU_TOPOLOGY_TYPE_TRIANGLE, GPU_TOPOLOGY_TYPE_LINE };
+
+enum GPUFillMode { GPU_FILL_SOLID, GPU_FILL_WIREFRAME };
+enum GPUCullMode { GPU_CULL_NONE, GPU_CULL_FRONT, GPU_CULL_BACK };
+enum GPUComparisonFunc { GPU_COMPARISON_NEVER, GPU_COMPARISON_LESS, GPU_COMPARISON_LESS_EQUAL, GPU_COMPARISON_EQUAL, GPU_COMPARISON_ALWAYS };
+
+enum GPURootParameterType { GPU_ROOT_CBV, GPU_ROOT_CONSTANTS };
+enum GPUShaderVisibility { GPU_VISIBILITY_ALL, GPU_VISIBILITY_VERTEX, GPU_VISIBILITY_PIXEL };
+
+// Texture usage flags
+enum GPUTextureFlags { GPU_TEXTURE_NONE = 0, GPU_TEXTURE_RENDER_TARGET = 1, GPU_TEXTURE_DEPTH_STENCIL = 2 };
+
+const unsigned int GPU_ALL_SUBRESOURCES = 0xffffffff;
+const unsigned int GPU_APPEND_ALIGNED_ELEMENT = 0xffffffff;
+const uint64_t GPU_UPLOAD_PENDING = 0xffffffffffffffffull;  // Upload queued but not submitted yet
+const uint64_t GPU_PLACEMENT_ALIGNMENT = 64 * 1024;         // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT
+
+// Size in bytes of one element of a format
+inline unsigned int formatSize(GPUFormat format) {
+	switch (format) {
+	case GPU_FORMAT_R8G8B8A8_UNORM: return 4;
+	case GPU_FORMAT_R32_FLOAT: return 4;
+	case GPU_FORMAT_R32G32_FLOAT: return 8;
+	case GPU_FORMAT_R32G32B32_FLOAT: return 12;
+	case GPU_FORMAT_R32G32B32A32_FLOAT: return 16;
+	case GPU_FORMAT_R16_UINT: return 2;
+	case GPU_FORMAT_R32_UINT: return 4;
+	case GPU_FORMAT_D32_FLOAT: return 4;
+	default: return 0;
+	}
+}
+
+// Plain descriptions passed across the interface
+struct GPUViewport {
+	float topLeftX, topLeftY;
+	float width, height;
+	float minDepth, maxDepth;
+};
+
+struct GPURect {
+	long left, top, right, bottom;
+};
+
+struct GPUVertexBufferView {
+	uint64_t bufferLocation;
+	unsigned int sizeInBytes;
+	unsigned int strideInBytes;
+};
+
+struct GPUIndexBufferView {
+	uint64_t bufferLocation;
+	unsigned int sizeInBytes;
+	GPUFormat format;  // GPU_FORMAT_R16_UINT or GPU_FORMAT_R32_UINT
+};
+
+struct GPUTextureFootprint {
+	uint64_t offset;  // Offset of the first texel in the source buffer
+	GPUFormat format;
+	unsigned int width, height, depth;
+	unsigned int rowPitch;
+};
+
+struct GPUTextureDesc {
+	unsigned int width, height;
+	GPUFormat format;
+	unsigned int flags;        // GPUTextureFlags
+	float clearDepth = 1.0f;   // Optimised clear value for depth targets
+};
+
+struct GPUShaderBytecode {
+	const void* code;
+	size_t size;
+	uint64_t hash;  // Of the code, 0 to have PipelineCache hash it
+};
+
+struct GPUInputElement {
+	const char* semanticName;
+	unsigned int semanticIndex;
+	GPUFormat format;
+	unsigned int inputSlot;
+	unsigned int alignedByteOffset;
+};
+
+struct GPUInputLayout {
+	const GPUInputElement* elements;
+	unsigned int numElements;
+};
+
+struct GPURootParameter {
+	GPURootParameterType type;
+	unsigned int shaderRegister;   // Register(bN)
+	unsigned int registerSpace;
+	unsigned int num32BitValues;   // Only for GPU_ROOT_CONSTANTS
+	GPUShaderVisibility visibility;
+};
+
+struct GPURootSignatureDesc {
+	const GPURootParameter* parameters;
+	unsigned int numParameters;
+	bool allowInputLayout;
+};
+
+class GPURootSignature;
+
+struct GPUPipelineDesc {
+	GPURootSignature* rootSignature;
+	GPUShaderBytecode vs;
+	GPUShaderBytecode ps;
+	GPUInputLayout inputLayout;
+
+	// Rasterizer State
+	GPUFillMode fillMode;
+	GPUCullMode cullMode;
+	bool frontCounterClockwise;
+	bool depthClipEnable;
+
+	// Depth Stencil State
+	bool depthEnable;
+	bool depthWrite;
+	GPUComparisonFunc depthFunc;
+
+	// Blend State (alpha blending on all targets when enabled)
+	bool blendEnable;
+
+	// Render Target State and Topology
+	GPUTopologyType topologyType;
+	GPUFormat rtvFormat;
+	GPUFormat dsvFormat;
+};
+
+// Large block of GPU memory that placed resources are created in
+class GPUHeap {
+public:
+	virtual ~GPUHeap() {}
+};
+
+// Gets placed resource memory back when the resource is destroyed
+class GPUMemoryOwner {
+public:
+	virtual ~GPUMemoryOwner() {}
+	virtual void releaseMemory(unsigned int heap, unsigned int block) = 0;
+};
+
+// GPU memory (buffer or texture)
+class GPUResource {
+public:
+	virtual ~GPUResource() {
+		if (memoryOwner) memoryOwner->releaseMemory(memoryHeap, memoryBlock);
+	}
+	virtual void* map() = 0;
+	virtual void unmap() = 0;
+	virtual uint64_t getGPUAddress() const = 0;
+	virtual uint64_t getSize() const = 0;
+
+	// Copy queue fence value the contents are valid at, 0 once nothing is in flight
+	uint64_t uploadFenceValue = 0;
+
+	// State as of the last closed command list, kept by ResourceStateTracker
+	// subresourceStates is empty while every subresource shares state
+	GPUResourceState state = GPU_STATE_COMMON;
+	std::vector<GPUResourceState> subresourceStates;
+	unsigned int subresourceCount = 1;
+
+	// Set for resources placed in a heap by GPUMemoryAllocator, NULL for committed resources
+	GPUMemoryOwner* memoryOwner = NULL;
+	unsigned int memoryHeap = 0;
+	unsigned int memoryBlock = 0;
+};
+
+struct GPUBarrier {
+	GPUResource* resource;
+	unsigned int subresource;
+	GPUResourceState before;
+	GPUResourceState after;
+};
+
+// Value that a queue raises when it reaches a point in its stream
+class GPUFenceObject {
+public:
+	virtual ~GPUFenceObject() {}
+	virtual uint64_t getCompletedValue() = 0;
+	virtual void waitForValue(uint64_t value) = 0;  // Block the CPU until the value is reached
+};
+
+class GPURootSignature {
+public:
+	virtual ~GPURootSignature() {}
+	uint64_t layoutHash = 0;  // hashRootSignature of the description, set by RootSignatureCache
+};
+
+class GPUPipelineState {
+public:
+	virtual ~GPUPipelineState() {}
+};
+
+// Command list with its own allocator
+class GPUCommandList {
+public:
+	virtual ~GPUCommandList() {}
+	virtual void reset() = 0;
+	virtual void close() = 0;
+
+	virtual void resourceBarriers(unsigned int count, const GPUBarrier* barriers) = 0;
+	virtual void copyBufferRegion(GPUResource* dst, uint64_t dstOffset, GPUResource* src, uint64_t srcOffset, uint64_t size) = 0;
+	virtual void copyTextureRegion(GPUResource* dst, unsigned int dstSubresource, GPUResource* src, const GPUTextureFootprint& srcFootprint) = 0;
+
+	virtual void setRenderTargets(GPUResource* renderTarget, GPUResource* depthBuffer) = 0;
+	virtual void clearRenderTarget(GPUResource* renderTarget, const float colour[4]) = 0;
+	virtual void clearDepth(GPUResource* depthBuffer, float depth) = 0;
+	virtual void setViewport(const GPUViewport& viewport) = 0;
+	virtual void setScissorRect(const GPURect& rect) = 0;
+
+	virtual void setRootSignature(GPURootSignature* rootSignature) = 0;
+	virtual void setPipelineState(GPUPipelineState* pso) = 0;
+	virtual void setRootConstantBufferView(unsigned int index, uint64_t address) = 0;
+	virtual void setRootConstants(unsigned int index, unsigned int count, const void* data) = 0;  // count 32-bit values
+
+	virtual void setPrimitiveTopology(GPUTopology topology) = 0;
+	virtual void setVertexBuffers(unsigned int startSlot, unsigned int count, const GPUVertexBufferView* views) = 0;
+	virtual void setIndexBuffer(const GPUIndexBufferView& view) = 0;
+	virtual void drawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) = 0;
+	virtual void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+};
+
+class GPUQueue {
+public:
+	virtual ~GPUQueue() {}
+	virtual void executeCommandLists(unsigned int count, GPUCommandList* const* lists) = 0;
+	virtual void signal(GPUFenceObject* fence, uint64_t value) = 0;
+	virtual void wait(GPUFenceObject* fence, uint64_t value) = 0;  // GPU-side wait, the CPU does not block
+};
+
+class GPUSwapchain {
+public:
+	virtual ~GPUSwapchain() {}
+	virtual unsigned int getCurrentBackBufferIndex() = 0;
+	virtual GPUResource* getBackbuffer(unsigned int index) = 0;
+	virtual void present(unsigned int syncInterval) = 0;
+};
+
+class GPUDevice {
+public:
+	virtual ~GPUDevice() {}
+	virtual void initialize() = 0;
+
+	virtual GPUQueue* createQueue(GPUQueueType type) = 0;
+	virtual GPUCommandList* createCommandList(GPUQueueType type) = 0;
+	virtual GPUFenceObject* createFence(uint64_t initialValue) = 0;
+	virtual GPUSwapchain* createSwapchain(GPUQueue* presentQueue, void* windowHandle, unsigned int width, unsigned int height,
+										  unsigned int bufferCount, GPUFormat format) = 0;
+
+	// Committed resources, each with its own implicit heap
+	virtual GPUResource* createBuffer(GPUHeapType heap, uint64_t sizeInBytes, GPUResourceState initialState) = 0;
+	virtual GPUResource* createTexture2D(const GPUTextureDesc& desc, GPUResourceState initialState) = 0;
+
+	// Placed resources, offset must respect the alignment the resource needs
+	virtual GPUHeap* createHeap(GPUHeapType type, GPUHeapUsage usage, uint64_t sizeInBytes) = 0;
+	virtual GPUResource* createPlacedBuffer(GPUHeap* heap, uint64_t offset, uint64_t sizeInBytes, GPUResourceState initialState) = 0;
+	virtual GPUResource* createPlacedTexture2D(GPUHeap* heap, uint64_t offset, const GPUTextureDesc& desc, GPUResourceState initialState) = 0;
+	virtual void getTextureAllocationInfo(const GPUTextureDesc& desc, uint64_t& sizeInBytes, uint64_t& alignment) = 0;
+
+	virtual GPURootSignature* createRootSignature(const GPURootSignatureDesc& desc) = 0;
+	virtual GPUPipelineState* createPipelineState(const GPUPipelineDesc& desc) = 0;
+
+	// Extract constant buffer layouts from compiled shader bytecode
+	virtual bool reflectShader(const void* bytecode, size_t size, ShaderReflection& reflection) = 0;
+};
+
+// One monotonically increasing fence per queue - each submission signals the next value
+// (Wait for a value before reusing its resources or starting dependent tasks on another queue)
+class GPUFence {
+public:
+	GPUFenceObject* fence = NULL;
+	uint64_t value = 0;  // Last value signalled
+
+	~GPUFence() {
+		delete fence;
+	}
+
+	void create(GPUDevice* device) {
+		fence = device->createFence(value);
+	}
+
+	uint64_t signal(GPUQueue* queue) {
+		queue->signal(fence, ++value);
+		return value;
+	}
+
+	bool isComplete(uint64_t target) {
+		return fence->getCompletedValue() >= target;
+	}
+
+	void wait(uint64_t target) {
+		if (fence->getCompletedValue() < target) {
+			fence->waitForValue(target);
+		}
+	}
+
+	void wait() {
+		wait(value);
+	}
+};
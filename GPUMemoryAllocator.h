@@ -0,0 +1,203 @@
+#pragma once
+
+#include <vector>
+
+#include "GPUDevice.h"
+#include "Platform.h"
+#include "TLSFAllocator.h"
+
+struct GPUMemoryStats {
+	uint64_t heaps;
+	uint64_t heapBytes;           // Reserved in heaps
+	uint64_t usedBytes;           // Handed out to placed resources, including alignment
+	uint64_t placedResources;     // Live
+	uint64_t committedResources;  // Too big for a heap, created committed instead
+	uint64_t retiringBlocks;      // Freed by deleted resources the GPU may still be using
+	uint64_t largestFreeBlock;
+	float fragmentation;          // 1 - largest free block / free bytes, across all heaps
+};
+
+/*
+ *	Places buffers and textures in a few large heaps instead of giving each one a committed
+ *	resource (and with it an OS-level allocation). Heaps are split by CPU visibility and by
+ *	what they may hold, each heap is carved up by a TLSFAllocator, and a new heap is only
+ *	created when none of the existing ones has room. The first heap of each kind is small and
+ *	every later one twice the size of the biggest so far, up to maxHeapSize, so a kind that only
+ *	ever holds a few resources doesn't reserve a full-size heap.
+ *	Memory goes back to the heap once the GPU is done with it. A placed resource deleted while a
+ *	frame is being recorded may still be used by that frame's list, so its block waits for the
+ *	fence value endFrame() is given for the frame. Other lists signal the same fence before the
+ *	frame is submitted, so the next value of retireFence is not enough. Deleted between frames,
+ *	everything that could use it has already signalled, so the last value is. retire() frees what
+ *	has completed. Without a retireFence blocks are freed on delete.
+ */
+class GPUMemoryAllocator : public GPUMemoryOwner {
+public:
+	struct Heap {
+		GPUHeap* heap;
+		GPUHeapType type;
+		GPUHeapUsage usage;
+		uint64_t size;
+		TLSFAllocator allocator;
+	};
+
+	// Block freed by a deleted resource, reusable once fenceValue has completed (UNSTAMPED until the frame ends)
+	static const uint64_t UNSTAMPED = ~0ull;
+	struct RetiredBlock {
+		unsigned int heap;
+		unsigned int block;
+		uint64_t fenceValue;
+	};
+
+	GPUDevice* device;
+	uint64_t firstHeapSize;  // Of each type and usage
+	uint64_t maxHeapSize;    // Heaps stop doubling here, bigger resources are committed
+	std::vector<Heap*> heaps;
+	GPUFence* retireFence = NULL;  // Graphics queue timeline, set by Core
+	std::vector<RetiredBlock> retired;
+	bool recordingFrame = false;
+	GPUMemoryStats stats = {};
+
+	void initialize(GPUDevice* _device, uint64_t _maxHeapSize = 64 * 1024 * 1024, uint64_t _firstHeapSize = 4 * 1024 * 1024) {
+		device = _device;
+		maxHeapSize = _maxHeapSize;
+		firstHeapSize = (_firstHeapSize < _maxHeapSize) ? _firstHeapSize : _maxHeapSize;
+	}
+
+	~GPUMemoryAllocator() {
+		for (Heap* heap : heaps) {
+			delete heap->heap;
+			delete heap;
+		}
+	}
+
+	GPUResource* createBuffer(GPUHeapType type, uint64_t sizeInBytes, GPUResourceState initialState) {
+		unsigned int heap;
+		TLSFAllocation allocation;
+		if (!allocate(type, GPU_HEAP_USAGE_BUFFERS, sizeInBytes, GPU_PLACEMENT_ALIGNMENT, heap, allocation)) {
+			stats.committedResources++;
+			return device->createBuffer(type, sizeInBytes, initialState);
+		}
+		GPUResource* buffer = device->createPlacedBuffer(heaps[heap]->heap, allocation.offset, sizeInBytes, initialState);
+		attach(buffer, heap, allocation);
+		return buffer;
+	}
+
+	GPUResource* createTexture2D(const GPUTextureDesc& desc, GPUResourceState initialState) {
+		uint64_t sizeInBytes, alignment;
+		device->getTextureAllocationInfo(desc, sizeInBytes, alignment);
+		GPUHeapUsage usage = (desc.flags & (GPU_TEXTURE_DEPTH_STENCIL | GPU_TEXTURE_RENDER_TARGET)) ? GPU_HEAP_USAGE_TARGETS : GPU_HEAP_USAGE_TEXTURES;
+
+		unsigned int heap;
+		TLSFAllocation allocation;
+		if (!allocate(GPU_HEAP_DEFAULT, usage, sizeInBytes, alignment, heap, allocation)) {
+			stats.committedResources++;
+			return device->createTexture2D(desc, initialState);
+		}
+		GPUResource* texture = device->createPlacedTexture2D(heaps[heap]->heap, allocation.offset, desc, initialState);
+		attach(texture, heap, allocation);
+		return texture;
+	}
+
+	void releaseMemory(unsigned int heap, unsigned int block) override {
+		if (!retireFence) {
+			free(heap, block);
+			return;
+		}
+		RetiredBlock retiredBlock = { heap, block, recordingFrame ? UNSTAMPED : retireFence->value };
+		retired.push_back(retiredBlock);
+		stats.retiringBlocks++;
+	}
+
+	// Call once per frame after waiting for the frame slot
+	void beginFrame() {
+		retire();
+		recordingFrame = true;
+	}
+
+	// frameFenceValue is what the graphics queue signals after the frame's list
+	void endFrame(uint64_t frameFenceValue) {
+		for (RetiredBlock& retiredBlock : retired)
+			if (retiredBlock.fenceValue == UNSTAMPED) retiredBlock.fenceValue = frameFenceValue;
+		recordingFrame = false;
+	}
+
+	// Free every block whose fence value has completed
+	void retire() {
+		if (retired.empty()) return;
+		uint64_t completed = retireFence->fence->getCompletedValue();
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < retired.size(); i++) {
+			if (retired[i].fenceValue <= completed) {
+				free(retired[i].heap, retired[i].block);
+				stats.retiringBlocks--;
+			} else {
+				retired[kept++] = retired[i];
+			}
+		}
+		retired.resize(kept);
+	}
+
+	const GPUMemoryStats& getStats() {
+		stats.usedBytes = 0;
+		stats.largestFreeBlock = 0;
+		uint64_t freeBytes = 0;
+		for (Heap* heap : heaps) {
+			const TLSFStats& heapStats = heap->allocator.getStats();
+			stats.usedBytes += heapStats.usedBytes;
+			freeBytes += heapStats.freeBytes;
+			if (heapStats.largestFreeBlock > stats.largestFreeBlock) stats.largestFreeBlock = heapStats.largestFreeBlock;
+		}
+		stats.fragmentation = freeBytes ? 1.0f - (float)stats.largestFreeBlock / (float)freeBytes : 0.0f;
+		return stats;
+	}
+
+private:
+	bool allocate(GPUHeapType type, GPUHeapUsage usage, uint64_t sizeInBytes, uint64_t alignment,
+				  unsigned int& heap, TLSFAllocation& allocation) {
+		// Anything bigger than a whole heap is better off committed
+		if (sizeInBytes > maxHeapSize) return false;
+
+		uint64_t heapSize = firstHeapSize;
+		for (unsigned int i = 0; i < heaps.size(); i++) {
+			if (heaps[i]->type != type || heaps[i]->usage != usage) continue;
+			if (heaps[i]->allocator.allocate(sizeInBytes, alignment, allocation)) {
+				heap = i;
+				return true;
+			}
+			if (heaps[i]->size * 2 > heapSize) heapSize = heaps[i]->size * 2;
+		}
+		while (heapSize < sizeInBytes) heapSize *= 2;
+		if (heapSize > maxHeapSize) heapSize = maxHeapSize;
+
+		// Only keep the new heap if the request fits in it (an over-aligned one near heapSize may not)
+		Heap* newHeap = new Heap();
+		newHeap->allocator.initialize(heapSize, GPU_PLACEMENT_ALIGNMENT);
+		if (!newHeap->allocator.allocate(sizeInBytes, alignment, allocation)) {
+			delete newHeap;
+			return false;
+		}
+		newHeap->heap = device->createHeap(type, usage, heapSize);
+		newHeap->type = type;
+		newHeap->usage = usage;
+		newHeap->size = heapSize;
+		heaps.push_back(newHeap);
+		stats.heaps++;
+		stats.heapBytes += heapSize;
+
+		heap = (unsigned int)heaps.size() - 1;
+		return true;
+	}
+
+	void free(unsigned int heap, unsigned int block) {
+		heaps[heap]->allocator.free(block);
+		stats.placedResources--;
+	}
+
+	void attach(GPUResource* resource, unsigned int heap, TLSFAllocation& allocation) {
+		resource->memoryOwner = this;
+		resource->memoryHeap = heap;
+		resource->memoryBlock = allocation.block;
+		stats.placedResources++;
+	}
+};
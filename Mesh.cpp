@@ -1,43 +1,118 @@
 #include "Mesh.h"
 
 void Mesh::initialize(Core* core, void* vertices, int vertexSizeInBytes, int numVertices) {
-	// Specify vertex buffer will be in GPU memory heap
-	D3D12_HEAP_PROPERTIES heapprops = {};
-	heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
-	heapprops.CreationNodeMask = 1;
-	heapprops.VisibleNodeMask = 1;
-
-	// Create a vertex buffer on heap
-	D3D12_RESOURCE_DESC vbDesc = {};
-	vbDesc.Width = numVertices * vertexSizeInBytes;
-	vbDesc.Height = 1;
-	vbDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-	vbDesc.DepthOrArraySize = 1;
-	vbDesc.MipLevels = 1;
-	vbDesc.SampleDesc.Count = 1;
-	vbDesc.SampleDesc.Quality = 0;
-	vbDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-	// Allocate memory
-	core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &vbDesc, D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&vertexBuffer));
+	createVertexBuffer(core, vertices, vertexSizeInBytes, numVertices);
+	createLayout();
+}
+
+void Mesh::initialize(Core* core, const void* vertices, int vertexSizeInBytes, int _numVertices, const unsigned int* indices, int _numIndices, bool optimize) {
+	// Nothing to index, draw the vertices as they are
+	if (!indices || _numIndices <= 0) {
+		createVertexBuffer(core, vertices, vertexSizeInBytes, _numVertices);
+		createLayout();
+		return;
+	}
+
+	// The optimisers index their tables with these, and a partial triangle would be drawn from padding
+	if (_numIndices % 3 != 0) {
+		debugLog("Mesh: " + std::to_string(_numIndices) + " indices is not whole triangles, dropping the last " + std::to_string(_numIndices % 3) + "\n");
+		_numIndices -= _numIndices % 3;
+	}
+	std::vector<unsigned int> indexData;
+	indexData.reserve(_numIndices);
+	unsigned int dropped = 0;
+	for (int i = 0; i < _numIndices; i += 3) {
+		if (indices[i] >= (unsigned int)_numVertices || indices[i + 1] >= (unsigned int)_numVertices || indices[i + 2] >= (unsigned int)_numVertices) {
+			dropped++;
+			continue;
+		}
+		indexData.insert(indexData.end(), indices + i, indices + i + 3);
+	}
+	if (dropped) debugLog("Mesh: dropped " + std::to_string(dropped) + " triangles indexing past " + std::to_string(_numVertices) + " vertices\n");
+	_numIndices = (int)indexData.size();
+	if (_numIndices == 0) {  // Nothing valid left to index
+		createVertexBuffer(core, vertices, vertexSizeInBytes, _numVertices);
+		createLayout();
+		return;
+	}
+
+	std::vector<unsigned char> vertexData((const unsigned char*)vertices, (const unsigned char*)vertices + (size_t)_numVertices * vertexSizeInBytes);
+	cacheStatsBefore = analyzeVertexCache(indexData.data(), indexData.size(), _numVertices);
+
+	if (optimize) {
+		// Triangle order for the post-transform cache, then vertex order for fetch locality
+		std::vector<unsigned int> reordered(indexData.size());
+		optimizeVertexCache(reordered.data(), indexData.data(), indexData.size(), _numVertices);
+		std::vector<unsigned char> fetchOrdered(vertexData.size());
+		_numVertices = (int)optimizeVertexFetch(fetchOrdered.data(), reordered.data(), reordered.size(), vertexData.data(), _numVertices, vertexSizeInBytes);
+		fetchOrdered.resize((size_t)_numVertices * vertexSizeInBytes);
+		indexData.swap(reordered);
+		vertexData.swap(fetchOrdered);
+	}
+	cacheStatsAfter = analyzeVertexCache(indexData.data(), indexData.size(), _numVertices);
+
+	createVertexBuffer(core, vertexData.data(), vertexSizeInBytes, _numVertices);
+
+	// Halve the index memory when every index fits in 16 bits
+	numIndices = _numIndices;
+	GPUFormat format = (_numVertices <= 0xffff) ? GPU_FORMAT_R16_UINT : GPU_FORMAT_R32_UINT;
+	unsigned int ibSize = numIndices * formatSize(format);
+	std::vector<unsigned short> shortIndices;
+	const void* ibData = indexData.data();
+	if (format == GPU_FORMAT_R16_UINT) {
+		shortIndices.assign(indexData.begin(), indexData.end());
+		ibData = shortIndices.data();
+	}
+	indexBuffer = core->memory.createBuffer(GPU_HEAP_DEFAULT, ibSize, GPU_STATE_COMMON);
+	core->uploadResource(indexBuffer, ibData, ibSize, GPU_STATE_INDEX_BUFFER);
+
+	ibView.bufferLocation = indexBuffer->getGPUAddress();
+	ibView.sizeInBytes = ibSize;
+	ibView.format = format;
+
+	createLayout();
+}
+
+void Mesh::initialize(Core* core, const void* vertices, int vertexSizeInBytes, int _numVertices, const unsigned short* indices, int _numIndices, bool optimize) {
+	std::vector<unsigned int> wideIndices;
+	if (indices && _numIndices > 0) wideIndices.assign(indices, indices + _numIndices);
+	initialize(core, vertices, vertexSizeInBytes, _numVertices, wideIndices.data(), (int)wideIndices.size(), optimize);
+}
+
+void Mesh::createVertexBuffer(Core* core, const void* vertices, int vertexSizeInBytes, int _numVertices) {
+	numVertices = _numVertices;
+
+	// Create a vertex buffer in GPU memory heap
+	vertexBuffer = core->memory.createBuffer(GPU_HEAP_DEFAULT, numVertices * vertexSizeInBytes, GPU_STATE_COMMON);
 
 	// Copy vertices using our helper function
-	core->uploadResource(vertexBuffer, vertices, numVertices * vertexSizeInBytes, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	core->uploadResource(vertexBuffer, vertices, numVertices * vertexSizeInBytes, GPU_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
 	// Fill in view in helper function
-	vbView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
-	vbView.StrideInBytes = vertexSizeInBytes;
-	vbView.SizeInBytes = numVertices * vertexSizeInBytes;
+	vbView.bufferLocation = vertexBuffer->getGPUAddress();
+	vbView.strideInBytes = vertexSizeInBytes;
+	vbView.sizeInBytes = numVertices * vertexSizeInBytes;
+}
 
+void Mesh::createLayout() {
 	// Fill in Layout
-	inputLayout[0] = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
-	inputLayout[1] = { "COLOUR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
-	inputLayoutDesc.NumElements = 2;
-	inputLayoutDesc.pInputElementDescs = inputLayout;
+	inputLayout[0] = { "POSITION", 0, GPU_FORMAT_R32G32B32_FLOAT, 0, GPU_APPEND_ALIGNED_ELEMENT };
+	inputLayout[1] = { "COLOUR", 0, GPU_FORMAT_R32G32B32_FLOAT, 0, GPU_APPEND_ALIGNED_ELEMENT };
+	inputLayoutDesc.numElements = 2;
+	inputLayoutDesc.elements = inputLayout;
 }
 
 void Mesh::draw(Core* core) const {
-	core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
-	core->getCommandList()->DrawInstanced(3, 1, 0, 0);
-}
\ No newline at end of file
+	core->useResource(vertexBuffer);
+	core->getCommandList()->transition(vertexBuffer, GPU_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	core->getCommandList()->setPrimitiveTopology(GPU_TOPOLOGY_TRIANGLELIST);
+	core->getCommandList()->setVertexBuffers(0, 1, &vbView);
+	if (indexBuffer) {
+		core->useResource(indexBuffer);
+		core->getCommandList()->transition(indexBuffer, GPU_STATE_INDEX_BUFFER);
+		core->getCommandList()->setIndexBuffer(ibView);
+		core->getCommandList()->drawIndexedInstanced(numIndices, 1, 0, 0, 0);
+	} else {
+		core->getCommandList()->drawInstanced(numVertices, 1, 0, 0);
+	}
+}
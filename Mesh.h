@@ -1,28 +1,37 @@
 #pragma once
 
-#include <d3d12.h>
-#include <dxgi1_6.h>
-#include <d3dcompiler.h>
-
 #include "Core.h"
-
-#pragma comment(lib, "d3d12")
-#pragma comment(lib, "dxgi")
-#pragma comment(lib, "d3dcompiler.lib")
+#include "MeshOptimizer.h"
 
 class Mesh {
 public:
 	// Create buffer and upload vertices to GPU
-	ID3D12Resource* vertexBuffer;
+	GPUResource* vertexBuffer;
+	unsigned int numVertices = 0;
+
+	// Optional index buffer, 16-bit whenever the vertex count allows it
+	GPUResource* indexBuffer = NULL;
+	unsigned int numIndices = 0;
 
-	// Create view member variable
-	D3D12_VERTEX_BUFFER_VIEW vbView;
+	// Create view member variables
+	GPUVertexBufferView vbView;
+	GPUIndexBufferView ibView;
+
+	// Vertex cache behaviour of the index order before and after optimisation
+	VertexCacheStats cacheStatsBefore = {};
+	VertexCacheStats cacheStatsAfter = {};
 
 	// Define layout
-	D3D12_INPUT_ELEMENT_DESC inputLayout[2];
-	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
+	GPUInputElement inputLayout[2];
+	GPUInputLayout inputLayoutDesc;
 
 	// Methods
 	void initialize(Core* core, void* vertices, int vertexSizeInBytes, int numVertices);
+	void initialize(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices, const unsigned int* indices, int numIndices, bool optimize = true);
+	void initialize(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices, const unsigned short* indices, int numIndices, bool optimize = true);
 	void draw(Core* core) const;
-};
\ No newline at end of file
+
+private:
+	void createVertexBuffer(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices);
+	void createLayout();
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// How well an index order reuses the post-transform vertex cache
+struct VertexCacheStats {
+	float acmr;  // Average cache miss ratio - vertex shader runs per triangle (0.5 is ideal for a big grid, 3 is no reuse)
+	float atvr;  // Average transform to vertex ratio - vertex shader runs per unique vertex (1 is ideal)
+};
+
+// Simulate a FIFO post-transform cache over a triangle list
+inline VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16) {
+	VertexCacheStats result = {};
+	if (indexCount < 3) return result;
+
+	// A vertex is cached if fewer than cacheSize misses have happened since it was last transformed
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int transforms = 0, unique = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		unsigned int v = indices[i];
+		if (!used[v]) {
+			used[v] = true;
+			unique++;
+		}
+		if (timestamps[v] == 0 || transforms + 1 - timestamps[v] > cacheSize) {
+			transforms++;
+			timestamps[v] = transforms;
+		}
+	}
+	result.acmr = (float)transforms / (float)(indexCount / 3);
+	result.atvr = unique ? (float)transforms / (float)unique : 0.0f;
+	return result;
+}
+
+/*
+ *	Reorder triangles for post-transform cache reuse (Tom Forsyth's linear-speed optimiser).
+ *	Every vertex scores higher the more recently it was used and the fewer triangles it has
+ *	left, each step emits the best scoring triangle touching the simulated LRU cache.
+ *	destination and indices may not overlap. indexCount has to be a multiple of 3 and every index
+ *	below vertexCount, Mesh::initialize makes sure of both.
+ */
+inline void optimizeVertexCache(unsigned int* destination, const unsigned int* indices, size_t indexCount, size_t vertexCount) {
+	const int cacheSize = 32;
+	const unsigned int NONE = 0xffffffff;
+	size_t triangleCount = indexCount / 3;
+
+	// Vertex score tables by cache position and by remaining triangles
+	float cacheScore[cacheSize];
+	for (int i = 0; i < cacheSize; i++)
+		cacheScore[i] = (i < 3) ? 0.75f : powf(1.0f - (float)(i - 3) / (cacheSize - 3), 1.5f);
+	float valenceScore[64];
+	for (int i = 1; i < 64; i++) valenceScore[i] = 2.0f / sqrtf((float)i);
+	auto score = [&](int position, unsigned int live) -> float {
+		if (live == 0) return -1.0f;
+		float s = (position >= 0) ? cacheScore[position] : 0.0f;
+		return s + ((live < 64) ? valenceScore[live] : 2.0f / sqrtf((float)live));
+	};
+
+	// Triangles that use each vertex, packed into one array
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) liveTriangles[indices[i]]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + liveTriangles[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vertexScore[v] = score(-1, liveTriangles[v]);
+
+	std::vector<bool> emitted(triangleCount, false);
+
+	unsigned int cache[cacheSize + 3];
+	unsigned int newCache[cacheSize + 3];
+	int cacheCount = 0;
+	unsigned int best = NONE;
+	size_t scan = 0;  // Fallback search position, everything before it has been emitted
+
+	for (size_t output = 0; output < triangleCount; output++) {
+		if (best == NONE) {
+			// Nothing in the cache has triangles left, start again from the next unemitted one
+			while (emitted[scan]) scan++;
+			best = (unsigned int)scan;
+		}
+
+		unsigned int t = best;
+		emitted[t] = true;
+		const unsigned int* tri = &indices[t * 3];
+		destination[output * 3 + 0] = tri[0];
+		destination[output * 3 + 1] = tri[1];
+		destination[output * 3 + 2] = tri[2];
+
+		// Take the triangle off its vertices' lists
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = tri[k];
+			unsigned int* list = &adjacency[offsets[v]];
+			unsigned int count = liveTriangles[v];
+			for (unsigned int i = 0; i < count; i++) {
+				if (list[i] == t) {
+					list[i] = list[count - 1];
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// Push the triangle's vertices to the front of the LRU cache
+		int newCount = 0;
+		for (int k = 0; k < 3; k++) newCache[newCount++] = tri[k];
+		for (int i = 0; i < cacheCount; i++) {
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was or is in the cache, the evicted tail drops out
+		for (int i = 0; i < newCount; i++) {
+			unsigned int v = newCache[i];
+			cachePosition[v] = (i < cacheSize) ? i : -1;
+			vertexScore[v] = score(cachePosition[v], liveTriangles[v]);
+		}
+
+		best = NONE;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++) {
+			unsigned int v = newCache[i];
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < liveTriangles[v]; j++) {
+				unsigned int other = list[j];
+				const unsigned int* o = &indices[other * 3];
+				float s = vertexScore[o[0]] + vertexScore[o[1]] + vertexScore[o[2]];
+				if (s > bestScore) {
+					bestScore = s;
+					best = other;
+				}
+			}
+		}
+
+		cacheCount = (newCount < cacheSize) ? newCount : cacheSize;
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+	}
+}
+
+/*
+ *	Reorder vertices into the order the indices first use them so fetches walk memory forwards.
+ *	Indices are remapped in place, unreferenced vertices are dropped. Returns the new vertex count.
+ */
+inline size_t optimizeVertexFetch(void* destination, unsigned int* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize) {
+	const unsigned int NONE = 0xffffffff;
+	std::vector<unsigned int> remap(vertexCount, NONE);
+	unsigned int next = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		unsigned int v = indices[i];
+		if (remap[v] == NONE) {
+			remap[v] = next;
+			memcpy((unsigned char*)destination + (size_t)next * vertexSize, (const unsigned char*)vertices + (size_t)v * vertexSize, vertexSize);
+			next++;
+		}
+		indices[i] = remap[v];
+	}
+	return next;
+}
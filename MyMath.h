@@ -7,7 +7,21 @@
 #include <cmath>
 #include <iostream>
 
+#ifdef _WIN32
 #include "GamesEngineeringBase.h"
+#endif
+
+// SIMD paths for the hot Matrix functions, define MYMATH_NO_SIMD to build the scalar code only
+#if !defined(MYMATH_NO_SIMD) && defined(__AVX__)
+#define MYMATH_SSE
+#define MYMATH_AVX
+#elif !defined(MYMATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MYMATH_SSE
+#endif
+
+#ifdef MYMATH_SSE
+#include <immintrin.h>
+#endif
 
 // Vec3 Class
 class Vec3 {
@@ -96,11 +110,11 @@ public:
 	float Min() const { return std::min<float>(x, std::min<float>(y, z)); }
 };
 
-float Dot(const Vec3& v1, const Vec3& v2) { return (v1.v[0] * v2.v[0] + v1.v[1] * v2.v[1] + v1.v[2] * v2.v[2]); }
-Vec3 Cross(const Vec3& v1, const Vec3& v2) { return Vec3((v1.v[1] * v2.v[2] - v1.v[2] * v2.v[1]), (v1.v[2] * v2.v[0] - v1.v[0] * v2.v[2]),
+inline float Dot(const Vec3& v1, const Vec3& v2) { return (v1.v[0] * v2.v[0] + v1.v[1] * v2.v[1] + v1.v[2] * v2.v[2]); }
+inline Vec3 Cross(const Vec3& v1, const Vec3& v2) { return Vec3((v1.v[1] * v2.v[2] - v1.v[2] * v2.v[1]), (v1.v[2] * v2.v[0] - v1.v[0] * v2.v[2]),
 														 (v1.v[0] * v2.v[1] - v1.v[1] * v2.v[0])); }
-Vec3 Max(const Vec3& v1, const Vec3& v2) { return Vec3(std::max<float>(v1.v[0], v2.v[0]), std::max<float>(v1.v[1], v2.v[1]), std::max<float>(v1.v[2], v2.v[2])); }
-Vec3 Min(const Vec3& v1, const Vec3& v2) { return Vec3(std::min<float>(v1.v[0], v2.v[0]), std::min<float>(v1.v[1], v2.v[1]), std::min<float>(v1.v[2], v2.v[2])); }
+inline Vec3 Max(const Vec3& v1, const Vec3& v2) { return Vec3(std::max<float>(v1.v[0], v2.v[0]), std::max<float>(v1.v[1], v2.v[1]), std::max<float>(v1.v[2], v2.v[2])); }
+inline Vec3 Min(const Vec3& v1, const Vec3& v2) { return Vec3(std::min<float>(v1.v[0], v2.v[0]), std::min<float>(v1.v[1], v2.v[1]), std::min<float>(v1.v[2], v2.v[2])); }
 
 // Vec4 Class
 class Vec4 {
@@ -197,10 +211,10 @@ public:
 	}
 };
 
-float Dot(const Vec4& v1, const Vec4& v2) { return (v1.v[0] * v2.v[0] + v1.v[1] * v2.v[1] + v1.v[2] * v2.v[2] + v1.v[3] * v2.v[3]); }
-Vec4 Max(const Vec4& v1, const Vec4& v2) { return Vec4(std::max<float>(v1.v[0], v2.v[0]), std::max<float>(v1.v[1], v2.v[1]),
+inline float Dot(const Vec4& v1, const Vec4& v2) { return (v1.v[0] * v2.v[0] + v1.v[1] * v2.v[1] + v1.v[2] * v2.v[2] + v1.v[3] * v2.v[3]); }
+inline Vec4 Max(const Vec4& v1, const Vec4& v2) { return Vec4(std::max<float>(v1.v[0], v2.v[0]), std::max<float>(v1.v[1], v2.v[1]),
 													   std::max<float>(v1.v[2], v2.v[2]), std::max<float>(v1.v[3], v2.v[3])); }
-Vec4 Min(const Vec4& v1, const Vec4& v2) { return Vec4(std::min<float>(v1.v[0], v2.v[0]), std::min<float>(v1.v[1], v2.v[1]),
+inline Vec4 Min(const Vec4& v1, const Vec4& v2) { return Vec4(std::min<float>(v1.v[0], v2.v[0]), std::min<float>(v1.v[1], v2.v[1]),
 													   std::min<float>(v1.v[2], v2.v[2]), std::min<float>(v1.v[3], v2.v[3])); }
 
 // 4x4 Matrix Class
@@ -214,8 +228,9 @@ public:
 
 	// Constructors
 	Matrix() {
-		// Initialize to identity matrix
-		for (int i = 0; i < 16; i++) (i % 5 == 0) ? m[i] = 1 : m[i] = 0;
+		// Initialize to identity matrix (no modulo in the loop, this runs for every temporary)
+		for (int i = 0; i < 16; i++) m[i] = 0;
+		m[0] = m[5] = m[10] = m[15] = 1;
 	}
 
 	Matrix(float f1, float f2, float f3, float f4, float f5, float f6, float f7, float f8,
@@ -238,15 +253,32 @@ public:
 		return iden;
 	}
 
+	/*
+	 *	The SIMD versions below do the same multiplies and adds in the same order as the scalar
+	 *	ones (no FMA, no horizontal adds), so both give bit-identical results.
+	 */
+
 	// Matrix & Vector Multiplication
-	Vec4 mul(const Vec4& v) {
+	Vec4 mul(const Vec4& v) const {
+#ifdef MYMATH_SSE
+		Vec4 ret;
+		_mm_storeu_ps(ret.v, mulRows(m, _mm_loadu_ps(v.v)));
+		return ret;
+#else
+		return mulScalar(v);
+#endif
+	}
+
+	Vec4 mulScalar(const Vec4& v) const {
 		return Vec4((v.x * m[0] + v.y * m[1] + v.z * m[2] + v.w * m[3]),
 					(v.x * m[4] + v.y * m[5] + v.z * m[6] + v.w * m[7]),
 					(v.x * m[8] + v.y * m[9] + v.z * m[10] + v.w * m[11]),
 					(v.x * m[12] + v.y * m[13] + v.z * m[14] + v.w * m[15]));
 	}
 
-	Vec3 mulPoint(const Vec3& v) {
+	// Scalar on purpose: packing v and transposing the products costs more than it saves for one
+	// point. transformPoints is the SIMD path for many points through the same matrix.
+	Vec3 mulPoint(const Vec3& v) const {
 		// w = 1
 		return Vec3((v.x * m[0] + v.y * m[1] + v.z * m[2]) + m[3],
 					(v.x * m[4] + v.y * m[5] + v.z * m[6]) + m[7],
@@ -260,8 +292,31 @@ public:
 					(v.x * m[8] + v.y * m[9] + v.z * m[10]));
 	}
 
-	// 4x4 Matrix Multiplication
+	// 4x4 Matrix Multiplication. Only the AVX kernel beats the scalar code; the 4-wide SSE one
+	// spends what it saves on broadcasting each element, so SSE builds use the scalar version.
 	Matrix mul(const Matrix& matrix) const {
+#if defined(MYMATH_AVX)
+		// Two rows at a time, each row of matrix repeated in both halves
+		Matrix ret((Uninitialized()));
+		__m256 b0 = _mm256_broadcast_ps((const __m128*)&matrix.m[0]);
+		__m256 b1 = _mm256_broadcast_ps((const __m128*)&matrix.m[4]);
+		__m256 b2 = _mm256_broadcast_ps((const __m128*)&matrix.m[8]);
+		__m256 b3 = _mm256_broadcast_ps((const __m128*)&matrix.m[12]);
+		for (int i = 0; i < 16; i += 8) {
+			__m256 a = _mm256_loadu_ps(&m[i]);
+			__m256 r = _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x00), b0);
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x55), b1));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xaa), b2));
+			r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xff), b3));
+			_mm256_storeu_ps(&ret.m[i], r);
+		}
+		return ret;
+#else
+		return mulScalar(matrix);
+#endif
+	}
+
+	Matrix mulScalar(const Matrix& matrix) const {
 		Matrix ret;
 		ret.m[0] = m[0] * matrix.m[0] + m[1] * matrix.m[4] + m[2] * matrix.m[8] + m[3] * matrix.m[12];
 		ret.m[1] = m[0] * matrix.m[1] + m[1] * matrix.m[5] + m[2] * matrix.m[9] + m[3] * matrix.m[13];
@@ -377,10 +432,78 @@ public:
 		return inv;
 	}
 
+	/*
+	 *	Inverse of a matrix whose last row is 0 0 0 1 (rotation, scale and translation only).
+	 *	The 3x3 part is inverted with the cross products of its rows, the translation is then
+	 *	just the inverse rotation applied to the negated translation. Much cheaper than invert().
+	 */
+	Matrix invertAffine() const {
+#ifdef MYMATH_SSE
+		__m128 r0 = _mm_loadu_ps(&m[0]);
+		__m128 r1 = _mm_loadu_ps(&m[4]);
+		__m128 r2 = _mm_loadu_ps(&m[8]);
+
+		// Columns of the adjugate
+		__m128 c0 = cross(r1, r2);
+		__m128 c1 = cross(r2, r0);
+		__m128 c2 = cross(r0, r1);
+
+		float p[4];
+		_mm_storeu_ps(p, _mm_mul_ps(r0, c0));
+		float det = p[0] + p[1] + p[2];
+		if (det == 0) {
+			std::cout << "det(M) = 0 [This matrix doesn't have an inverse... returning identity matrix for graceful termination]" << std::endl;
+			return Matrix();
+		}
+		__m128 invDet = _mm_set1_ps(1.f / det);
+		c0 = _mm_mul_ps(c0, invDet);
+		c1 = _mm_mul_ps(c1, invDet);
+		c2 = _mm_mul_ps(c2, invDet);
+
+		// Negate with the sign bit so -0 comes out the same as in the scalar code
+		__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(m[3])), _mm_mul_ps(c1, _mm_set1_ps(m[7]))), _mm_mul_ps(c2, _mm_set1_ps(m[11])));
+		t = _mm_xor_ps(t, _mm_set1_ps(-0.f));
+
+		_MM_TRANSPOSE4_PS(c0, c1, c2, t);
+		Matrix inv((Uninitialized()));
+		_mm_storeu_ps(&inv.m[0], c0);
+		_mm_storeu_ps(&inv.m[4], c1);
+		_mm_storeu_ps(&inv.m[8], c2);
+		_mm_storeu_ps(&inv.m[12], _mm_setr_ps(0.f, 0.f, 0.f, 1.f));
+		return inv;
+#else
+		return invertAffineScalar();
+#endif
+	}
+
+	Matrix invertAffineScalar() const {
+		Vec3 r0(m[0], m[1], m[2]), r1(m[4], m[5], m[6]), r2(m[8], m[9], m[10]);
+		Vec3 c[3] = { Cross(r1, r2), Cross(r2, r0), Cross(r0, r1) };
+		float det = Dot(r0, c[0]);
+		if (det == 0) {
+			std::cout << "det(M) = 0 [This matrix doesn't have an inverse... returning identity matrix for graceful termination]" << std::endl;
+			return Matrix();
+		}
+		float invDet = 1.f / det;
+
+		Matrix inv;
+		for (int row = 0; row < 3; row++) {
+			for (int col = 0; col < 3; col++) inv.a[row][col] = c[col].v[row] * invDet;
+			inv.a[row][3] = -(inv.a[row][0] * m[3] + inv.a[row][1] * m[7] + inv.a[row][2] * m[11]);
+		}
+		return inv;
+	}
+
 	// Projection Matrix
+#ifdef _WIN32
 	static Matrix projection(GamesEngineeringBase::Window& canvas, float zFar, float zNear, float fovTheta = 90.f) {
+		return projection(canvas.getWidth(), canvas.getHeight(), zFar, zNear, fovTheta);
+	}
+#endif
+
+	static Matrix projection(int width, int height, float zFar, float zNear, float fovTheta = 90.f) {
 		// Calculate FOV (Field of View) and Aspect Ratio
-		float aspect = static_cast<float>(canvas.getWidth()) / canvas.getHeight();
+		float aspect = static_cast<float>(width) / height;
 		float fov = tan((fovTheta * (M_PI / 180.f)) / 2.f);
 		
 		// Initialize Projection Matrix
@@ -418,6 +541,195 @@ public:
 
 		return look;
 	}
+
+#ifdef MYMATH_SSE
+private:
+	// Skips the identity fill for results that are about to be overwritten with whole-row stores
+	struct Uninitialized {};
+	explicit Matrix(Uninitialized) {}
+
+	// Each row of m times v, the four products summed left to right like the scalar code
+	static __m128 mulRows(const float* m, __m128 v) {
+		__m128 p0 = _mm_mul_ps(_mm_loadu_ps(&m[0]), v);
+		__m128 p1 = _mm_mul_ps(_mm_loadu_ps(&m[4]), v);
+		__m128 p2 = _mm_mul_ps(_mm_loadu_ps(&m[8]), v);
+		__m128 p3 = _mm_mul_ps(_mm_loadu_ps(&m[12]), v);
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		return _mm_add_ps(_mm_add_ps(_mm_add_ps(p0, p1), p2), p3);
+	}
+
+	// x, y and z of a cross b (w is garbage)
+	static __m128 cross(__m128 a, __m128 b) {
+		__m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 aZXY = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+		__m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bZXY = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+		return _mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX));
+	}
+#endif
+};
+
+/*
+ *	out[i] = matrix * (in[i], 1) for n points, w kept for the perspective divide.
+ *	The matrix is transposed into columns once, then each point is three multiply-adds.
+ */
+inline void transformPoints(const Matrix& matrix, const Vec3* in, Vec4* out, size_t n) {
+	size_t i = 0;
+#ifdef MYMATH_SSE
+	__m128 c0 = _mm_loadu_ps(&matrix.m[0]);
+	__m128 c1 = _mm_loadu_ps(&matrix.m[4]);
+	__m128 c2 = _mm_loadu_ps(&matrix.m[8]);
+	__m128 c3 = _mm_loadu_ps(&matrix.m[12]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+#ifdef MYMATH_AVX
+	// Two points per register, the columns repeated in both halves
+	__m256 wc0 = _mm256_insertf128_ps(_mm256_castps128_ps256(c0), c0, 1);
+	__m256 wc1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c1), c1, 1);
+	__m256 wc2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c2), c2, 1);
+	__m256 wc3 = _mm256_insertf128_ps(_mm256_castps128_ps256(c3), c3, 1);
+	for (; i + 2 <= n; i += 2) {
+		__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[i].x)), _mm_set1_ps(in[i + 1].x), 1);
+		__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[i].y)), _mm_set1_ps(in[i + 1].y), 1);
+		__m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(in[i].z)), _mm_set1_ps(in[i + 1].z), 1);
+		__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, wc0), _mm256_mul_ps(y, wc1)), _mm256_mul_ps(z, wc2)), wc3);
+		_mm256_storeu_ps(out[i].v, r);
+	}
+#endif
+	for (; i < n; i++) {
+		__m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(in[i].x), c0), _mm_mul_ps(_mm_set1_ps(in[i].y), c1));
+		r = _mm_add_ps(_mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(in[i].z), c2)), c3);
+		_mm_storeu_ps(out[i].v, r);
+	}
+#else
+	for (; i < n; i++) out[i] = matrix.mulScalar(Vec4(in[i].x, in[i].y, in[i].z, 1.f));
+#endif
+}
+
+/*
+ *	3x4 matrix for transforms whose last row is always 0 0 0 1 (rotation, scale, translation).
+ *	The rows are Matrix's first three rows, so it is 48 bytes instead of 64 and has the layout of
+ *	an HLSL row_major float3x4: it can be copied into constant and instance buffers as it is.
+ *	As with Matrix, the SIMD paths keep the scalar operation order and give identical results.
+ */
+class AffineMatrix {
+public:
+	union {
+		float a[3][4];
+		float m[12];
+	};
+
+	AffineMatrix() {
+		for (int i = 0; i < 12; i++) m[i] = 0;
+		m[0] = m[5] = m[10] = 1;
+	}
+
+	// Drops the last row, which has to be 0 0 0 1
+	explicit AffineMatrix(const Matrix& matrix) {
+		for (int i = 0; i < 12; i++) m[i] = matrix.m[i];
+	}
+
+	Matrix toMatrix() const {
+		Matrix ret;
+		for (int i = 0; i < 12; i++) ret.m[i] = m[i];
+		return ret;
+	}
+
+	float& operator[](const int index) { return m[index]; }
+
+	// Row i of the result is a[i][0] * row 0 + a[i][1] * row 1 + a[i][2] * row 2 of matrix, plus the
+	// translation. Same result as Matrix::mul without the multiplies by the constant last row.
+	AffineMatrix mul(const AffineMatrix& matrix) const {
+#ifdef MYMATH_SSE
+		AffineMatrix ret((Uninitialized()));
+		__m128 b0 = _mm_loadu_ps(&matrix.m[0]);
+		__m128 b1 = _mm_loadu_ps(&matrix.m[4]);
+		__m128 b2 = _mm_loadu_ps(&matrix.m[8]);
+		for (int i = 0; i < 12; i += 4) {
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[i]), b0), _mm_mul_ps(_mm_set1_ps(m[i + 1]), b1)), _mm_mul_ps(_mm_set1_ps(m[i + 2]), b2));
+			_mm_storeu_ps(&ret.m[i], _mm_add_ps(r, _mm_setr_ps(0.f, 0.f, 0.f, m[i + 3])));
+		}
+		return ret;
+#else
+		return mulScalar(matrix);
+#endif
+	}
+
+	AffineMatrix mulScalar(const AffineMatrix& matrix) const {
+		AffineMatrix ret;
+		for (int row = 0; row < 3; row++) {
+			const float* r = a[row];
+			ret.a[row][0] = (r[0] * matrix.m[0] + r[1] * matrix.m[4] + r[2] * matrix.m[8]) + 0.f;
+			ret.a[row][1] = (r[0] * matrix.m[1] + r[1] * matrix.m[5] + r[2] * matrix.m[9]) + 0.f;
+			ret.a[row][2] = (r[0] * matrix.m[2] + r[1] * matrix.m[6] + r[2] * matrix.m[10]) + 0.f;
+			ret.a[row][3] = (r[0] * matrix.m[3] + r[1] * matrix.m[7] + r[2] * matrix.m[11]) + r[3];
+		}
+		return ret;
+	}
+
+	Matrix operator* (const Matrix& matrix) const { return toMatrix().mul(matrix); }
+	AffineMatrix operator* (const AffineMatrix& matrix) const { return mul(matrix); }
+
+	Vec3 mulPoint(const Vec3& v) const {
+		return Vec3((v.x * m[0] + v.y * m[1] + v.z * m[2]) + m[3],
+					(v.x * m[4] + v.y * m[5] + v.z * m[6]) + m[7],
+					(v.x * m[8] + v.y * m[9] + v.z * m[10]) + m[11]);
+	}
+
+	Vec3 mulVec(const Vec3& v) const {
+		return Vec3((v.x * m[0] + v.y * m[1] + v.z * m[2]),
+					(v.x * m[4] + v.y * m[5] + v.z * m[6]),
+					(v.x * m[8] + v.y * m[9] + v.z * m[10]));
+	}
+
+	// Any invertible affine matrix, through Matrix::invertAffine
+	AffineMatrix invert() const { return AffineMatrix(toMatrix().invertAffine()); }
+
+	/*
+	 *	Inverse when the three axes (columns of the 3x3 part) are perpendicular - rotations with
+	 *	any scale per axis, which is every transform built from rotate, scale and translate. The
+	 *	3x3 part is transposed with each axis divided by its squared length, then the translation
+	 *	is the negated inverse applied to the old one. No determinant or cofactors.
+	 */
+	AffineMatrix invertOrthogonal() const {
+#ifdef MYMATH_SSE
+		__m128 r0 = _mm_loadu_ps(&m[0]);
+		__m128 r1 = _mm_loadu_ps(&m[4]);
+		__m128 r2 = _mm_loadu_ps(&m[8]);
+
+		// Squared axis lengths across x, y and z (w is the translation's and unused)
+		__m128 scale = _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, r0), _mm_mul_ps(r1, r1)), _mm_mul_ps(r2, r2)));
+		__m128 q0 = _mm_mul_ps(r0, scale);
+		__m128 q1 = _mm_mul_ps(r1, scale);
+		__m128 q2 = _mm_mul_ps(r2, scale);
+		__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q0, _mm_set1_ps(m[3])), _mm_mul_ps(q1, _mm_set1_ps(m[7]))), _mm_mul_ps(q2, _mm_set1_ps(m[11])));
+		t = _mm_xor_ps(t, _mm_set1_ps(-0.f));
+
+		_MM_TRANSPOSE4_PS(q0, q1, q2, t);
+		AffineMatrix inv((Uninitialized()));
+		_mm_storeu_ps(&inv.m[0], q0);
+		_mm_storeu_ps(&inv.m[4], q1);
+		_mm_storeu_ps(&inv.m[8], q2);
+		return inv;
+#else
+		return invertOrthogonalScalar();
+#endif
+	}
+
+	AffineMatrix invertOrthogonalScalar() const {
+		AffineMatrix inv;
+		for (int col = 0; col < 3; col++) {
+			float scale = 1.f / ((a[0][col] * a[0][col] + a[1][col] * a[1][col]) + a[2][col] * a[2][col]);
+			for (int row = 0; row < 3; row++) inv.a[col][row] = a[row][col] * scale;
+			inv.a[col][3] = -((inv.a[col][0] * m[3] + inv.a[col][1] * m[7]) + inv.a[col][2] * m[11]);
+		}
+		return inv;
+	}
+
+#ifdef MYMATH_SSE
+private:
+	struct Uninitialized {};
+	explicit AffineMatrix(Uninitialized) {}
+#endif
 };
 
 // Spherical Coordinate Class
@@ -535,9 +847,9 @@ public:
 	float Dot(const Quaternion& q) const { return d * q.d + a * q.a + b * q.b + c * q.c; }
 };
 
-float Dot(const Quaternion& q1, const Quaternion& q2) { return q1.d * q2.d + q1.a * q2.a + q1.b * q2.b + q1.c * q2.c; }
+inline float Dot(const Quaternion& q1, const Quaternion& q2) { return q1.d * q2.d + q1.a * q2.a + q1.b * q2.b + q1.c * q2.c; }
 
-Quaternion multiply(const Quaternion& q1, const Quaternion& q2) {
+inline Quaternion multiply(const Quaternion& q1, const Quaternion& q2) {
 	return Quaternion((q1.d * q2.d - q1.a * q2.a - q1.b * q2.b - q1.c * q2.c),
 					  (q1.d * q2.a + q1.a * q2.d + q1.b * q2.c - q1.c * q2.b),
 					  (q1.d * q2.b - q1.a * q2.c + q1.b * q2.d + q1.c * q2.a),
@@ -551,7 +863,7 @@ static Type lerp(const Type a, const Type b, float t) {
 }
 
 // Spherical Linear Interpolation
-static Quaternion slerp(Quaternion q1, Quaternion q2, float t) {
+inline Quaternion slerp(Quaternion q1, Quaternion q2, float t) {
 	float dot = Dot(q1, q2);
 
 	// Check if q1.q2 < 0
@@ -594,37 +906,41 @@ public:
 // Triangle Class
 class Triangle {
 public:
-	// Union elements can be accessed in the same memory address, unlike structs
-	union {
-		Vec4 v[3];
-		struct { Vec4 v0, v1, v2; };
-	};
+	// Vertices (an anonymous struct of Vec4 inside a union only compiles on MSVC, so index v[] instead)
+	Vec4 v[3];
 
 	// Constructor
-	Triangle(const Vec4& _v0, const Vec4& _v1, const Vec4& _v2) : v0(_v0), v1(_v1), v2(_v2) {}
+	Triangle(const Vec4& _v0, const Vec4& _v1, const Vec4& _v2) { v[0] = _v0; v[1] = _v1; v[2] = _v2; }
 };
 
 // Edge Function
-float edgeFunction(const Vec4& v0, const Vec4& v1, const Vec4& p) { return (((p.x - v0.x) * (v1.y - v0.y)) - ((v1.x - v0.x) * (p.y - v0.y))); }
+inline float edgeFunction(const Vec4& v0, const Vec4& v1, const Vec4& p) { return (((p.x - v0.x) * (v1.y - v0.y)) - ((v1.x - v0.x) * (p.y - v0.y))); }
 
 // Find Bounds
-void findBounds(GamesEngineeringBase::Window& canvas, const Vec4& v0, const Vec4& v1, const Vec4& v2, Vec4& tr, Vec4& bl)
+inline void findBounds(int width, int height, const Vec4& v0, const Vec4& v1, const Vec4& v2, Vec4& tr, Vec4& bl)
 {
-	tr.x = std::min<float>(std::max<float>(std::max<float>(v0.x, v1.x), v2.x), canvas.getWidth() - 1 / 1.f);
-	tr.y = std::min<float>(std::max<float>(std::max<float>(v0.y, v1.y), v2.y), canvas.getHeight() - 1 / 1.f);
+	tr.x = std::min<float>(std::max<float>(std::max<float>(v0.x, v1.x), v2.x), width - 1 / 1.f);
+	tr.y = std::min<float>(std::max<float>(std::max<float>(v0.y, v1.y), v2.y), height - 1 / 1.f);
 	bl.x = std::max<float>(std::min<float>(std::min<float>(v0.x, v1.x), v2.x), 0.f);
 	bl.y = std::max<float>(std::min<float>(std::min<float>(v0.y, v1.y), v2.y), 0.f);
 }
 
+#ifdef _WIN32
+inline void findBounds(GamesEngineeringBase::Window& canvas, const Vec4& v0, const Vec4& v1, const Vec4& v2, Vec4& tr, Vec4& bl)
+{
+	findBounds(canvas.getWidth(), canvas.getHeight(), v0, v1, v2, tr, bl);
+}
+#endif
+
 // Simple Interpolate Function
 template<typename Type>
 Type simpleInterpolateAttribute(Type a0, Type a1, Type a2, float alpha, float beta, float gamma) {
 	return (a0 * alpha) + (a1 * beta) + (a2 * gamma);
 }
 
-// Perspective Correct Interpolation
-template<typename Type>
-Type perspectiveCorrectInterpolateAttribute(Type a0, Type a1, Type a2, float v0_w, float v1_w, float v2_w, float alpha, float beta, float gamma, float frag_w) {
+// Perspective Correct Interpolation (Weight is float, or a SIMD lane type to interpolate several pixels at once)
+template<typename Type, typename Weight>
+Type perspectiveCorrectInterpolateAttribute(Type a0, Type a1, Type a2, Weight v0_w, Weight v1_w, Weight v2_w, Weight alpha, Weight beta, Weight gamma, Weight frag_w) {
 	Type t0 = a0 * (alpha * v0_w);
 	Type t1 = a1 * (beta * v1_w);
 	Type t2 = a2 * (gamma * v2_w);
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "GPUDevice.h"
+#include "Platform.h"
+#include "ShaderReflection.h"
+
+/*
+ *	Headless implementation of the GPUDevice interface.
+ *	Command lists record their calls, queues "execute" them on submit (buffer copies really happen in host memory)
+ *	and fences complete after a configurable number of submissions, so the CPU side of the renderer runs unchanged.
+ */
+
+enum NullCommandType {
+	NULL_CMD_BARRIER,
+	NULL_CMD_COPY_BUFFER,
+	NULL_CMD_COPY_TEXTURE,
+	NULL_CMD_SET_RENDER_TARGETS,
+	NULL_CMD_CLEAR_RENDER_TARGET,
+	NULL_CMD_CLEAR_DEPTH,
+	NULL_CMD_SET_VIEWPORT,
+	NULL_CMD_SET_SCISSOR,
+	NULL_CMD_SET_ROOT_SIGNATURE,
+	NULL_CMD_SET_PIPELINE_STATE,
+	NULL_CMD_SET_ROOT_CBV,
+	NULL_CMD_SET_ROOT_CONSTANTS,
+	NULL_CMD_SET_TOPOLOGY,
+	NULL_CMD_SET_VERTEX_BUFFERS,
+	NULL_CMD_SET_INDEX_BUFFER,
+	NULL_CMD_DRAW,
+	NULL_CMD_DRAW_INDEXED,
+	NULL_CMD_COUNT
+};
+
+// Everything the null device counts, reset between measurements
+struct NullDeviceStats {
+	uint64_t commands[NULL_CMD_COUNT];
+	uint64_t commandListsExecuted;
+	uint64_t barriers;
+	uint64_t drawCalls;
+	uint64_t verticesDrawn;
+	uint64_t indicesDrawn;
+	uint64_t bytesCopied;
+	uint64_t bytesAllocated;
+	uint64_t resourcesCreated;
+	uint64_t heapsCreated;
+	uint64_t pipelineStatesCreated;
+	uint64_t fenceSignals;
+	uint64_t queueWaits;   // GPU-side waits between queues
+	uint64_t cpuWaits;     // waitForValue calls that found the value not reached yet
+	uint64_t presents;
+
+	void reset() { memset(this, 0, sizeof(NullDeviceStats)); }
+
+	uint64_t totalCommands() const {
+		uint64_t total = 0;
+		for (int i = 0; i < NULL_CMD_COUNT; i++) total += commands[i];
+		return total;
+	}
+};
+
+class NullDevice;
+
+class NullResource : public GPUResource {
+public:
+	std::vector<unsigned char> storage;  // Only buffers get backing memory
+	uint64_t gpuAddress = 0;
+	uint64_t size = 0;
+
+	void* map() override { return storage.empty() ? NULL : &storage[0]; }
+	void unmap() override {}
+	uint64_t getGPUAddress() const override { return gpuAddress; }
+	uint64_t getSize() const override { return size; }
+};
+
+class NullFenceObject : public GPUFenceObject {
+public:
+	struct Pending {
+		uint64_t value;
+		uint64_t submission;  // Device submission count when the signal was queued
+	};
+
+	NullDevice* device;
+	uint64_t completedValue = 0;
+	std::vector<Pending> pending;
+
+	uint64_t getCompletedValue() override;
+	void waitForValue(uint64_t value) override;
+
+	void complete(uint64_t value) {
+		// Retire every signal up to value (signals on a fence are monotonic)
+		unsigned int retired = 0;
+		while (retired < pending.size() && pending[retired].value <= value) {
+			completedValue = pending[retired].value;
+			retired++;
+		}
+		pending.erase(pending.begin(), pending.begin() + retired);
+	}
+};
+
+class NullHeap : public GPUHeap {
+public:
+	uint64_t gpuAddress = 0;
+	uint64_t size = 0;
+};
+
+class NullRootSignature : public GPURootSignature {};
+class NullPipelineState : public GPUPipelineState {};
+
+struct NullCommand {
+	NullCommandType type;
+	NullResource* dst;
+	NullResource* src;
+	uint64_t dstOffset;
+	uint64_t srcOffset;
+	uint64_t size;
+	unsigned int count;  // Barriers in the batch, or vertices and instances of a draw
+	unsigned int instances;
+};
+
+class NullCommandList : public GPUCommandList {
+public:
+	std::vector<NullCommand> commands;  // Recorded since the last reset
+	bool recording = false;
+
+	void record(NullCommandType type, NullResource* dst = NULL, NullResource* src = NULL, uint64_t dstOffset = 0, uint64_t srcOffset = 0,
+				uint64_t size = 0, unsigned int count = 0, unsigned int instances = 0) {
+		if (!recording) debugLog("NullCommandList: command recorded on a closed list\n");
+		NullCommand command = { type, dst, src, dstOffset, srcOffset, size, count, instances };
+		commands.push_back(command);
+	}
+
+	void reset() override {
+		commands.clear();
+		recording = true;
+	}
+
+	void close() override { recording = false; }
+
+	void resourceBarriers(unsigned int count, const GPUBarrier* barriers) override { record(NULL_CMD_BARRIER, NULL, NULL, 0, 0, 0, count); }
+
+	void copyBufferRegion(GPUResource* dst, uint64_t dstOffset, GPUResource* src, uint64_t srcOffset, uint64_t size) override {
+		record(NULL_CMD_COPY_BUFFER, (NullResource*)dst, (NullResource*)src, dstOffset, srcOffset, size);
+	}
+
+	void copyTextureRegion(GPUResource* dst, unsigned int dstSubresource, GPUResource* src, const GPUTextureFootprint& srcFootprint) override {
+		record(NULL_CMD_COPY_TEXTURE, (NullResource*)dst, (NullResource*)src, 0, srcFootprint.offset, (uint64_t)srcFootprint.rowPitch * srcFootprint.height * srcFootprint.depth);
+	}
+
+	void setRenderTargets(GPUResource* renderTarget, GPUResource* depthBuffer) override { record(NULL_CMD_SET_RENDER_TARGETS); }
+	void clearRenderTarget(GPUResource* renderTarget, const float colour[4]) override { record(NULL_CMD_CLEAR_RENDER_TARGET); }
+	void clearDepth(GPUResource* depthBuffer, float depth) override { record(NULL_CMD_CLEAR_DEPTH); }
+	void setViewport(const GPUViewport& viewport) override { record(NULL_CMD_SET_VIEWPORT); }
+	void setScissorRect(const GPURect& rect) override { record(NULL_CMD_SET_SCISSOR); }
+	void setRootSignature(GPURootSignature* rootSignature) override { record(NULL_CMD_SET_ROOT_SIGNATURE); }
+	void setPipelineState(GPUPipelineState* pso) override { record(NULL_CMD_SET_PIPELINE_STATE); }
+	void setRootConstantBufferView(unsigned int index, uint64_t address) override { record(NULL_CMD_SET_ROOT_CBV, NULL, NULL, address); }
+	void setRootConstants(unsigned int index, unsigned int count, const void* data) override { record(NULL_CMD_SET_ROOT_CONSTANTS, NULL, NULL, 0, 0, count * 4, count); }
+	void setPrimitiveTopology(GPUTopology topology) override { record(NULL_CMD_SET_TOPOLOGY); }
+
+	void setVertexBuffers(unsigned int startSlot, unsigned int count, const GPUVertexBufferView* views) override {
+		record(NULL_CMD_SET_VERTEX_BUFFERS, NULL, NULL, 0, 0, 0, count);
+	}
+
+	void setIndexBuffer(const GPUIndexBufferView& view) override {
+		record(NULL_CMD_SET_INDEX_BUFFER, NULL, NULL, view.bufferLocation, 0, view.sizeInBytes);
+	}
+
+	void drawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) override {
+		record(NULL_CMD_DRAW, NULL, NULL, 0, 0, 0, vertexCount, instanceCount);
+	}
+
+	void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override {
+		record(NULL_CMD_DRAW_INDEXED, NULL, NULL, 0, 0, 0, indexCount, instanceCount);
+	}
+};
+
+class NullQueue : public GPUQueue {
+public:
+	NullDevice* device;
+
+	void executeCommandLists(unsigned int count, GPUCommandList* const* lists) override;
+	void signal(GPUFenceObject* fence, uint64_t value) override;
+	void wait(GPUFenceObject* fence, uint64_t value) override;
+};
+
+class NullSwapchain : public GPUSwapchain {
+public:
+	NullDevice* device;
+	std::vector<NullResource*> backbuffers;
+	unsigned int currentIndex = 0;
+
+	~NullSwapchain() {
+		for (NullResource* backbuffer : backbuffers) delete backbuffer;
+	}
+
+	unsigned int getCurrentBackBufferIndex() override { return currentIndex; }
+	GPUResource* getBackbuffer(unsigned int index) override { return backbuffers[index]; }
+	void present(unsigned int syncInterval) override;
+};
+
+class NullDevice : public GPUDevice {
+public:
+	NullDeviceStats stats = {};
+
+	// Number of later submissions before a signalled fence value completes (0 = the GPU is infinitely fast)
+	unsigned int gpuLatency = 0;
+	uint64_t submissions = 0;
+
+	// Fake virtual addresses handed out with placement alignment like D3D12
+	uint64_t nextGPUAddress = 0x10000;
+
+	void initialize() override { stats.reset(); }
+
+	GPUQueue* createQueue(GPUQueueType type) override {
+		NullQueue* queue = new NullQueue();
+		queue->device = this;
+		return queue;
+	}
+
+	GPUCommandList* createCommandList(GPUQueueType type) override { return new NullCommandList(); }
+
+	GPUFenceObject* createFence(uint64_t initialValue) override {
+		NullFenceObject* fence = new NullFenceObject();
+		fence->device = this;
+		fence->completedValue = initialValue;
+		return fence;
+	}
+
+	GPUSwapchain* createSwapchain(GPUQueue* presentQueue, void* windowHandle, unsigned int width, unsigned int height,
+								  unsigned int bufferCount, GPUFormat format) override {
+		NullSwapchain* swapchain = new NullSwapchain();
+		swapchain->device = this;
+		for (unsigned int i = 0; i < bufferCount; i++)
+			swapchain->backbuffers.push_back(createResource((uint64_t)width * height * formatSize(format), false));
+		return swapchain;
+	}
+
+	GPUResource* createBuffer(GPUHeapType heap, uint64_t sizeInBytes, GPUResourceState initialState) override {
+		NullResource* buffer = createResource(sizeInBytes, true);
+		buffer->state = initialState;
+		return buffer;
+	}
+
+	GPUResource* createTexture2D(const GPUTextureDesc& desc, GPUResourceState initialState) override {
+		NullResource* texture = createResource((uint64_t)desc.width * desc.height * formatSize(desc.format), false);
+		texture->state = initialState;
+		return texture;
+	}
+
+	GPUHeap* createHeap(GPUHeapType type, GPUHeapUsage usage, uint64_t sizeInBytes) override {
+		NullHeap* heap = new NullHeap();
+		heap->size = sizeInBytes;
+		heap->gpuAddress = nextGPUAddress;
+		nextGPUAddress += (sizeInBytes + 0xffff) & ~0xffffull;
+		stats.heapsCreated++;
+		stats.bytesAllocated += sizeInBytes;
+		return heap;
+	}
+
+	// Placed resources take their address from the heap, only buffers get host storage
+	GPUResource* createPlacedBuffer(GPUHeap* heap, uint64_t offset, uint64_t sizeInBytes, GPUResourceState initialState) override {
+		NullResource* buffer = new NullResource();
+		buffer->size = sizeInBytes;
+		buffer->gpuAddress = ((NullHeap*)heap)->gpuAddress + offset;
+		buffer->storage.resize((size_t)sizeInBytes);
+		buffer->state = initialState;
+		stats.resourcesCreated++;
+		return buffer;
+	}
+
+	GPUResource* createPlacedTexture2D(GPUHeap* heap, uint64_t offset, const GPUTextureDesc& desc, GPUResourceState initialState) override {
+		NullResource* texture = new NullResource();
+		texture->size = (uint64_t)desc.width * desc.height * formatSize(desc.format);
+		texture->gpuAddress = ((NullHeap*)heap)->gpuAddress + offset;
+		texture->state = initialState;
+		stats.resourcesCreated++;
+		return texture;
+	}
+
+	void getTextureAllocationInfo(const GPUTextureDesc& desc, uint64_t& sizeInBytes, uint64_t& alignment) override {
+		alignment = GPU_PLACEMENT_ALIGNMENT;
+		sizeInBytes = ((uint64_t)desc.width * desc.height * formatSize(desc.format) + alignment - 1) & ~(alignment - 1);
+	}
+
+	GPURootSignature* createRootSignature(const GPURootSignatureDesc& desc) override { return new NullRootSignature(); }
+
+	GPUPipelineState* createPipelineState(const GPUPipelineDesc& desc) override {
+		stats.pipelineStatesCreated++;
+		return new NullPipelineState();
+	}
+
+	bool reflectShader(const void* bytecode, size_t size, ShaderReflection& reflection) override {
+		return parseDXBCReflection(bytecode, size, reflection);
+	}
+
+	NullResource* createResource(uint64_t sizeInBytes, bool hostMemory) {
+		NullResource* resource = new NullResource();
+		resource->size = sizeInBytes;
+		resource->gpuAddress = nextGPUAddress;
+		if (hostMemory) resource->storage.resize((size_t)sizeInBytes);
+		nextGPUAddress += (sizeInBytes + 0xffff) & ~0xffffull;
+		stats.resourcesCreated++;
+		stats.bytesAllocated += sizeInBytes;
+		return resource;
+	}
+};
+
+inline uint64_t NullFenceObject::getCompletedValue() {
+	// Signals complete once enough later work has been submitted
+	unsigned int retired = 0;
+	while (retired < pending.size() && device->submissions >= pending[retired].submission + device->gpuLatency) {
+		completedValue = pending[retired].value;
+		retired++;
+	}
+	pending.erase(pending.begin(), pending.begin() + retired);
+	return completedValue;
+}
+
+inline void NullFenceObject::waitForValue(uint64_t value) {
+	if (getCompletedValue() >= value) return;
+	device->stats.cpuWaits++;
+	if (pending.empty() || pending.back().value < value) {
+		debugLog("NullFenceObject: waiting for a value that was never signalled\n");
+		return;
+	}
+	complete(value);
+}
+
+inline void NullQueue::executeCommandLists(unsigned int count, GPUCommandList* const* lists) {
+	NullDeviceStats& stats = device->stats;
+	for (unsigned int i = 0; i < count; i++) {
+		NullCommandList* list = (NullCommandList*)lists[i];
+		if (list->recording) debugLog("NullQueue: executing a command list that was not closed\n");
+		for (const NullCommand& command : list->commands) {
+			stats.commands[command.type]++;
+			switch (command.type) {
+			case NULL_CMD_BARRIER:
+				stats.barriers += command.count;
+				break;
+			case NULL_CMD_COPY_BUFFER:
+				if (!command.dst->storage.empty() && !command.src->storage.empty())
+					memcpy(&command.dst->storage[(size_t)command.dstOffset], &command.src->storage[(size_t)command.srcOffset], (size_t)command.size);
+				stats.bytesCopied += command.size;
+				break;
+			case NULL_CMD_COPY_TEXTURE:
+				stats.bytesCopied += command.size;
+				break;
+			case NULL_CMD_DRAW:
+				stats.drawCalls++;
+				stats.verticesDrawn += (uint64_t)command.count * command.instances;
+				break;
+			case NULL_CMD_DRAW_INDEXED:
+				stats.drawCalls++;
+				stats.indicesDrawn += (uint64_t)command.count * command.instances;
+				break;
+			default:
+				break;
+			}
+		}
+		stats.commandListsExecuted++;
+	}
+	device->submissions++;
+}
+
+inline void NullQueue::signal(GPUFenceObject* fence, uint64_t value) {
+	NullFenceObject::Pending signal = { value, device->submissions };
+	((NullFenceObject*)fence)->pending.push_back(signal);
+	device->stats.fenceSignals++;
+}
+
+inline void NullQueue::wait(GPUFenceObject* fence, uint64_t value) {
+	// Queues are executed in submission order, so a GPU-side wait only needs counting
+	device->stats.queueWaits++;
+}
+
+inline void NullSwapchain::present(unsigned int syncInterval) {
+	currentIndex = (currentIndex + 1) % backbuffers.size();
+	device->stats.presents++;
+	device->submissions++;
+}
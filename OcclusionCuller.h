@@ -0,0 +1,257 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MyMath.h"
+
+struct OcclusionStats {
+	uint64_t occluderTriangles;  // Submitted as occluders
+	uint64_t occluderSkipped;    // ...crossing the near plane, zero area or off screen, so not drawn
+	uint64_t boxesTested;
+	uint64_t boxesOccluded;      // Behind the occluders everywhere they cover
+	uint64_t boxesOffscreen;     // Covering no pixel of the buffer
+	double rasterMs;             // Drawing occluders
+	double testMs;               // Testing boxes
+};
+
+/*
+ *	Masked software occlusion culling. Occluders are rasterised at low resolution into 32x8 pixel
+ *	tiles that each hold a coverage mask (one 32-bit row per scanline) and two depths instead of
+ *	a depth per pixel: zMax0 bounds the whole tile, zMax1 bounds just the pixels in the mask.
+ *	A new triangle's coverage is OR-ed into the mask and pushes zMax1 back to its farthest depth
+ *	in the tile, and once the mask is full zMax1 becomes the new zMax0 and the mask starts again.
+ *	Both depths only ever overestimate what is really there, so occlusion is conservative.
+ *	Depth is clip z / w (0 at the near plane, 1 at the far plane).
+ *	Box tests project the corners, take the nearest depth and check it against each tile the
+ *	box's screen rectangle touches. Boxes through the near plane are always visible.
+ */
+class OcclusionCuller {
+public:
+	static const int TILE_WIDTH = 32;
+	static const int TILE_HEIGHT = 8;
+
+	struct OcclusionTile {
+		uint32_t mask[TILE_HEIGHT];  // Bit x of row y set where an occluder covers pixel (x, y)
+		float zMax0;                 // Farthest occluder depth over the whole tile
+		float zMax1;                 // Farthest occluder depth over the masked pixels
+	};
+
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<OcclusionTile> tiles;
+	Matrix viewProjection;
+	OcclusionStats stats = {};
+
+	// Rounded up to whole tiles, it only needs to be coarse
+	void initialize(int _width = 320, int _height = 192) {
+		tilesX = (_width + TILE_WIDTH - 1) / TILE_WIDTH;
+		tilesY = (_height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+		width = tilesX * TILE_WIDTH;
+		height = tilesY * TILE_HEIGHT;
+		tiles.resize((size_t)tilesX * tilesY);
+	}
+
+	void beginFrame(const Matrix& _viewProjection) {
+		viewProjection = _viewProjection;
+		for (OcclusionTile& tile : tiles) {
+			memset(tile.mask, 0, sizeof(tile.mask));
+			tile.zMax0 = 1.f;
+			tile.zMax1 = 0.f;
+		}
+		stats = {};
+	}
+
+	// Indexed triangle list in object space, placed by world
+	void renderOccluder(const Matrix& world, const Vec3* positions, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+		auto start = std::chrono::high_resolution_clock::now();
+		clipPositions.resize(vertexCount);
+		transformPoints(viewProjection.mul(world), positions, &clipPositions[0], vertexCount);
+		for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+			renderTriangle(clipPositions[indices[i]], clipPositions[indices[i + 1]], clipPositions[indices[i + 2]]);
+		stats.rasterMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// World space box, false only if it is hidden or entirely off screen
+	bool testBox(const Vec3& boundsMin, const Vec3& boundsMax) {
+		stats.boxesTested++;
+		// One transform for the min corner, the others add the matrix columns scaled by the box size
+		Vec4 base = viewProjection.mul(Vec4(boundsMin.x, boundsMin.y, boundsMin.z, 1.f));
+		Vec4 size = Vec4(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z, 0.f);
+		const Matrix& m = viewProjection;
+		Vec4 axis[3] = { Vec4(m.m[0], m.m[4], m.m[8], m.m[12]) * size.x, Vec4(m.m[1], m.m[5], m.m[9], m.m[13]) * size.y,
+						 Vec4(m.m[2], m.m[6], m.m[10], m.m[14]) * size.z };
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, zMin = 1e30f;
+		for (int corner = 0; corner < 8; corner++) {
+			Vec4 clip = base;
+			if (corner & 1) clip += axis[0];
+			if (corner & 2) clip += axis[1];
+			if (corner & 4) clip += axis[2];
+			if (clip.w <= 0.f || clip.z < 0.f) return true;
+			float invW = 1.f / clip.w;
+			float x = (clip.x * invW + 1.f) * 0.5f * width, y = (1.f - clip.y * invW) * 0.5f * height;
+			minX = std::min<float>(minX, x);
+			maxX = std::max<float>(maxX, x);
+			minY = std::min<float>(minY, y);
+			maxY = std::max<float>(maxY, y);
+			zMin = std::min<float>(zMin, clip.z * invW);
+		}
+
+		// Every pixel the rectangle touches, not just the ones whose centres it contains
+		int x0 = std::max<int>((int)floorf(minX), 0), x1 = std::min<int>((int)ceilf(maxX), width);
+		int y0 = std::max<int>((int)floorf(minY), 0), y1 = std::min<int>((int)ceilf(maxY), height);
+		if (x0 >= x1 || y0 >= y1) {
+			stats.boxesOffscreen++;
+			return false;
+		}
+
+		for (int ty = y0 / TILE_HEIGHT; ty <= (y1 - 1) / TILE_HEIGHT; ty++) {
+			for (int tx = x0 / TILE_WIDTH; tx <= (x1 - 1) / TILE_WIDTH; tx++) {
+				const OcclusionTile& tile = tiles[ty * tilesX + tx];
+				if (zMin >= tile.zMax0) continue;
+				// In front of the tile's far bound, so hidden only where the mask is and only behind zMax1
+				if (zMin < tile.zMax1) return true;
+				uint32_t columns = spanMask(x0 - tx * TILE_WIDTH, x1 - 1 - tx * TILE_WIDTH);
+				int rowStart = std::max<int>(y0 - ty * TILE_HEIGHT, 0), rowEnd = std::min<int>(y1 - ty * TILE_HEIGHT, (int)TILE_HEIGHT);
+				for (int row = rowStart; row < rowEnd; row++)
+					if (columns & ~tile.mask[row]) return true;
+			}
+		}
+		stats.boxesOccluded++;
+		return false;
+	}
+
+	// Test count boxes and write the indices of the visible ones to visible
+	void cullBoxes(const Vec3* boundsMin, const Vec3* boundsMax, unsigned int count, std::vector<unsigned int>& visible) {
+		auto start = std::chrono::high_resolution_clock::now();
+		visible.clear();
+		for (unsigned int i = 0; i < count; i++)
+			if (testBox(boundsMin[i], boundsMax[i])) visible.push_back(i);
+		stats.testMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+private:
+	std::vector<Vec4> clipPositions;  // Scratch for transformed occluder vertices
+
+	// Buffer pixel x, y and depth
+	Vec4 toScreen(Vec4 clip) const {
+		Vec4 ndc = clip.divideByW();
+		return Vec4((ndc.x + 1.f) * 0.5f * width, (1.f - ndc.y) * 0.5f * height, ndc.z, ndc.w);
+	}
+
+	// Bits first..last of a tile row, clamped to the tile
+	static uint32_t spanMask(int first, int last) {
+		first = std::max<int>(first, 0);
+		last = std::min<int>(last, TILE_WIDTH - 1);
+		if (first > last) return 0;
+		return (0xffffffffu >> (TILE_WIDTH - 1 - last)) & (0xffffffffu << first);
+	}
+
+	void renderTriangle(const Vec4& p0, const Vec4& p1, const Vec4& p2) {
+		stats.occluderTriangles++;
+		// Not worth clipping, skipping an occluder only ever makes culling less aggressive
+		if (p0.w <= 0.f || p1.w <= 0.f || p2.w <= 0.f || p0.z < 0.f || p1.z < 0.f || p2.z < 0.f) {
+			stats.occluderSkipped++;
+			return;
+		}
+		Vec4 v[3] = { toScreen(p0), toScreen(p1), toScreen(p2) };
+		float area = edgeFunction(v[0], v[1], v[2]);
+		if (area == 0.f) {
+			stats.occluderSkipped++;
+			return;
+		}
+		if (area < 0.f) {
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+		Vec4 tr, bl;
+		findBounds(width, height, v[0], v[1], v[2], tr, bl);
+		if (tr.x < bl.x || tr.y < bl.y) {
+			stats.occluderSkipped++;
+			return;
+		}
+
+		// Each edge (from, to) bounds a scanline on one side: inside is edgeFunction >= 0, which
+		// for a pixel centre x on row y means x >= or <= from.x + slope * (y - from.y)
+		const Vec4* from[3] = { &v[1], &v[2], &v[0] };
+		const Vec4* to[3] = { &v[2], &v[0], &v[1] };
+		float slope[3];
+		for (int k = 0; k < 3; k++) {
+			float dy = to[k]->y - from[k]->y;
+			slope[k] = (dy != 0.f) ? (to[k]->x - from[k]->x) / dy : 0.f;
+		}
+
+		// Depth plane, bounded over each tile below
+		float invArea = 1.f / area;
+		float dzdx = 0.f, dzdy = 0.f;
+		for (int k = 0; k < 3; k++) {
+			const Vec4& opposite = v[k];
+			dzdx += (to[k]->y - from[k]->y) * opposite.z * invArea;
+			dzdy += -(to[k]->x - from[k]->x) * opposite.z * invArea;
+		}
+		float triangleZMax = std::max<float>(v[0].z, std::max<float>(v[1].z, v[2].z));
+
+		int rowStart = (int)bl.y, rowEnd = std::min<int>((int)ceilf(tr.y) + 1, height);
+		int colStart = (int)bl.x, colEnd = std::min<int>((int)ceilf(tr.x) + 1, width);
+		for (int ty = rowStart / TILE_HEIGHT; ty <= (rowEnd - 1) / TILE_HEIGHT; ty++) {
+			uint32_t rowSpans[TILE_HEIGHT][2];  // First and last covered pixel of each scanline
+			for (int row = 0; row < TILE_HEIGHT; row++) {
+				float py = (float)(ty * TILE_HEIGHT + row) + 0.5f;
+				float left = -1e30f, right = 1e30f;
+				for (int k = 0; k < 3; k++) {
+					float dy = to[k]->y - from[k]->y;
+					float x = from[k]->x + slope[k] * (py - from[k]->y);
+					if (dy > 0.f) left = std::max<float>(left, x);
+					else if (dy < 0.f) right = std::min<float>(right, x);
+					else if (-(to[k]->x - from[k]->x) * (py - from[k]->y) < 0.f) right = -1e30f;  // Outside a horizontal edge
+				}
+				// Pixel centres i + 0.5 inside [left, right]
+				left = std::max<float>(left, -1.f);
+				right = std::min<float>(right, (float)width + 1.f);
+				rowSpans[row][0] = (uint32_t)std::max<int>((int)ceilf(left - 0.5f), 0);
+				rowSpans[row][1] = (right >= left) ? (uint32_t)std::max<int>((int)floorf(right - 0.5f) + 1, 0) : 0;
+			}
+			for (int tx = colStart / TILE_WIDTH; tx <= (colEnd - 1) / TILE_WIDTH; tx++) {
+				int tileX = tx * TILE_WIDTH;
+				uint32_t mask[TILE_HEIGHT];
+				uint32_t any = 0;
+				for (int row = 0; row < TILE_HEIGHT; row++) {
+					mask[row] = spanMask((int)rowSpans[row][0] - tileX, (int)rowSpans[row][1] - 1 - tileX);
+					any |= mask[row];
+				}
+				if (!any) continue;
+
+				// Farthest the triangle gets within the tile
+				Vec4 corner((float)tileX + 0.5f, (float)(ty * TILE_HEIGHT) + 0.5f);
+				float zCorner = (edgeFunction(v[1], v[2], corner) * v[0].z + edgeFunction(v[2], v[0], corner) * v[1].z + edgeFunction(v[0], v[1], corner) * v[2].z) * invArea;
+				float zMax = zCorner + std::max<float>(dzdx * (TILE_WIDTH - 1), 0.f) + std::max<float>(dzdy * (TILE_HEIGHT - 1), 0.f);
+				updateTile(tiles[ty * tilesX + tx], mask, std::min<float>(zMax, triangleZMax));
+			}
+		}
+	}
+
+	void updateTile(OcclusionTile& tile, const uint32_t mask[TILE_HEIGHT], float zMax) {
+		// A triangle much farther back than the working layer would drag it back for little gain,
+		// restart the working layer with just this triangle instead
+		float distance1t = zMax - tile.zMax1, distance01 = tile.zMax0 - tile.zMax1;
+		if (distance1t > distance01) {
+			tile.zMax1 = 0.f;
+			memset(tile.mask, 0, sizeof(tile.mask));
+		}
+		tile.zMax1 = std::max<float>(tile.zMax1, zMax);
+		uint32_t full = 0xffffffffu;
+		for (int row = 0; row < TILE_HEIGHT; row++) {
+			tile.mask[row] |= mask[row];
+			full &= tile.mask[row];
+		}
+		if (full == 0xffffffffu) {
+			tile.zMax0 = std::min<float>(tile.zMax0, tile.zMax1);
+			tile.zMax1 = 0.f;
+			memset(tile.mask, 0, sizeof(tile.mask));
+		}
+	}
+};
@@ -5,71 +5,47 @@
 #include <string>
 #include <unordered_map>
 
+// Names for pipelines, the states themselves come from core->pipelines keyed by their description
 class PSOManager {
 public:
-	std::unordered_map<std::string, ID3D12PipelineState*> psos;
-	void createPSO(Core* core, std::string name, ID3DBlob* vs, ID3DBlob* ps, D3D12_INPUT_LAYOUT_DESC layout) {
-		// Avoid creating extra state
-		if (psos.find(name) != psos.end()) return;
-		
+	std::unordered_map<std::string, GPUPipelineState*> psos;
+	// rootSignature NULL uses the core's default one
+	GPUPipelineState* createPSO(Core* core, std::string name, Shader* vs, Shader* ps, GPUInputLayout layout, GPURootSignature* rootSignature = NULL) {
 		// Configure GPU pipeline with shaders, layout and Root Signature
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
-		desc.InputLayout = layout;
-		desc.pRootSignature = core->rootSignature;
-		desc.VS = { vs->GetBufferPointer(), vs->GetBufferSize() };
-		desc.PS = { ps->GetBufferPointer(), ps->GetBufferSize() };
+		GPUPipelineDesc desc = {};
+		desc.inputLayout = layout;
+		desc.rootSignature = rootSignature ? rootSignature : core->rootSignature;
+		desc.vs = { vs->bytecode.data(), vs->bytecode.size(), vs->hash };
+		desc.ps = { ps->bytecode.data(), ps->bytecode.size(), ps->hash };
 
 		// Rasterizer State - Responsible for configuring the rasterizer
-		D3D12_RASTERIZER_DESC rasterDesc = {};
-		rasterDesc.FillMode = D3D12_FILL_MODE_SOLID;
-		rasterDesc.CullMode = D3D12_CULL_MODE_NONE;
-		rasterDesc.FrontCounterClockwise = FALSE;
-		rasterDesc.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
-		rasterDesc.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
-		rasterDesc.SlopeScaledDepthBias = D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS;
-		rasterDesc.DepthClipEnable = TRUE;
-		rasterDesc.MultisampleEnable = FALSE;
-		rasterDesc.AntialiasedLineEnable = FALSE;
-		rasterDesc.ForcedSampleCount = 0;
-		rasterDesc.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF;
-		desc.RasterizerState = rasterDesc;
+		desc.fillMode = GPU_FILL_SOLID;
+		desc.cullMode = GPU_CULL_NONE;
+		desc.frontCounterClockwise = false;
+		desc.depthClipEnable = true;
 
 		// Depth Stencil State  Responsible for configuring the depth buffer
-		D3D12_DEPTH_STENCIL_DESC depthStencilDesc = {};
-		depthStencilDesc.DepthEnable = TRUE;
-		depthStencilDesc.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
-		depthStencilDesc.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
-		depthStencilDesc.StencilEnable = FALSE;
-		desc.DepthStencilState = depthStencilDesc;
+		desc.depthEnable = true;
+		desc.depthWrite = true;
+		desc.depthFunc = GPU_COMPARISON_LESS;
 
 		// Blend State
-		D3D12_BLEND_DESC blendDesc = {};
-		blendDesc.AlphaToCoverageEnable = FALSE;
-		blendDesc.IndependentBlendEnable = FALSE;
-		const D3D12_RENDER_TARGET_BLEND_DESC defaultRenderTargetBlend = 
-			{ FALSE, FALSE, D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_BLEND_ONE,
-			  D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL 
-			};
-
-		for (int i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
-			blendDesc.RenderTarget[i] = defaultRenderTargetBlend;
-		desc.BlendState = blendDesc;
+		desc.blendEnable = false;
 
 		// Render Target State and Topology
-		desc.SampleMask = UINT_MAX;
-		desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		desc.NumRenderTargets = 1;
-		desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-		desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-		desc.SampleDesc.Count = 1;
-		
-		// Create Pipeline State Object and insert into the map
-		ID3D12PipelineState* pso;
-		HRESULT hr = core->device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso));
-		psos.insert({ name, pso });
+		desc.topologyType = GPU_TOPOLOGY_TYPE_TRIANGLE;
+		desc.rtvFormat = GPU_FORMAT_R8G8B8A8_UNORM;
+		desc.dsvFormat = GPU_FORMAT_D32_FLOAT;
+
+		// Identical descriptions share one Pipeline State Object, only the name is per manager
+		GPUPipelineState* pso = core->pipelines.get(core->device, desc);
+		auto it = psos.find(name);
+		if (it != psos.end() && it->second != pso) debugLog("PSOManager: " + name + " now names a different pipeline\n");
+		psos[name] = pso;
+		return pso;
 	}
 
-	void bind(Core* core, std::string name) {
-		core->getCommandList()->SetPipelineState(psos[name]);
+	void bind(Core* core, const std::string& name) {
+		core->getCommandList()->setPipelineState(psos[name]);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GPUDevice.h"
+#include "Platform.h"
+
+struct PipelineCacheStats {
+	uint64_t requests;
+	uint64_t hits;
+	unsigned int unique;      // Pipeline states actually created
+	unsigned int collisions;  // Different descriptions under one hash
+	double createMs;          // Spent in createPipelineState
+};
+
+/*
+ *	Everything a pipeline state object is built from, as plain values: the shader bytecode hashes,
+ *	every input element, the rasterizer, depth and blend state, the target formats and the root
+ *	signature's layout hash. Never pointers, so the key is the same from run to run for the same
+ *	pipeline. Input elements are read from the description as needed instead of being copied.
+ */
+struct PipelineValues {
+	uint64_t shaders[2];
+	uint64_t rootSignature;
+	uint32_t state[12];
+
+	explicit PipelineValues(const GPUPipelineDesc& desc) {
+		shaders[0] = desc.vs.hash ? desc.vs.hash : hashBytes(desc.vs.code, desc.vs.size);
+		shaders[1] = desc.ps.hash ? desc.ps.hash : hashBytes(desc.ps.code, desc.ps.size);
+
+		rootSignature = desc.rootSignature ? desc.rootSignature->layoutHash : 0;
+		if (desc.rootSignature && rootSignature == 0) rootSignature = (uint64_t)(uintptr_t)desc.rootSignature;  // Made outside RootSignatureCache
+
+		uint32_t values[12] = {
+			desc.inputLayout.numElements,
+			(uint32_t)desc.fillMode, (uint32_t)desc.cullMode, desc.frontCounterClockwise ? 1u : 0u, desc.depthClipEnable ? 1u : 0u,
+			desc.depthEnable ? 1u : 0u, desc.depthWrite ? 1u : 0u, (uint32_t)desc.depthFunc,
+			desc.blendEnable ? 1u : 0u,
+			(uint32_t)desc.topologyType, (uint32_t)desc.rtvFormat, (uint32_t)desc.dsvFormat
+		};
+		memcpy(state, values, sizeof(values));
+	}
+
+	static void readElement(const GPUInputElement& element, uint32_t fields[4]) {
+		fields[0] = element.semanticIndex;
+		fields[1] = (uint32_t)element.format;
+		fields[2] = element.inputSlot;
+		fields[3] = element.alignedByteOffset;
+	}
+
+	// The 64-bit cache key, desc is the description these values were read from
+	uint64_t hash(const GPUPipelineDesc& desc) const {
+		uint64_t hash = hashBytes(shaders, sizeof(shaders));
+		hash = hashBytes(&rootSignature, sizeof(rootSignature), hash);
+		for (unsigned int i = 0; i < desc.inputLayout.numElements; i++) {
+			const GPUInputElement& element = desc.inputLayout.elements[i];
+			uint32_t fields[4];
+			readElement(element, fields);
+			hash = hashBytes(element.semanticName, strlen(element.semanticName) + 1, hash);
+			hash = hashBytes(fields, sizeof(fields), hash);
+		}
+		return hashBytes(state, sizeof(state), hash);
+	}
+};
+
+inline uint64_t hashPipelineDesc(const GPUPipelineDesc& desc) { return PipelineValues(desc).hash(desc); }
+
+// A compact copy of what went into a cached pipeline's hash, so a hit can be checked field by field
+struct PipelineKey {
+	struct Element {
+		std::string semanticName;
+		uint32_t fields[4];
+	};
+
+	PipelineValues values;
+	std::vector<Element> elements;
+
+	PipelineKey(const PipelineValues& _values, const GPUPipelineDesc& desc) : values(_values) {
+		for (unsigned int i = 0; i < desc.inputLayout.numElements; i++) {
+			Element element = { desc.inputLayout.elements[i].semanticName, {} };
+			PipelineValues::readElement(desc.inputLayout.elements[i], element.fields);
+			elements.push_back(element);
+		}
+	}
+	explicit PipelineKey(const GPUPipelineDesc& desc) : PipelineKey(PipelineValues(desc), desc) {}
+
+	// Allocates nothing. numElements is part of state, so once that matches the element counts agree.
+	bool matches(const PipelineValues& other, const GPUPipelineDesc& desc) const {
+		if (memcmp(&values, &other, sizeof(PipelineValues)) != 0) return false;
+		for (unsigned int i = 0; i < elements.size(); i++) {
+			uint32_t fields[4];
+			PipelineValues::readElement(desc.inputLayout.elements[i], fields);
+			if (elements[i].semanticName != desc.inputLayout.elements[i].semanticName || memcmp(elements[i].fields, fields, sizeof(fields)) != 0) return false;
+		}
+		return true;
+	}
+	bool matches(const GPUPipelineDesc& desc) const { return matches(PipelineValues(desc), desc); }
+};
+
+/*
+ *	Pipeline states shared by everything that asks for the same description, whatever it calls
+ *	them. A repeat request costs the key hash (fixed size when the shaders carry their hash), one
+ *	table probe and a compare against the stored key, and allocates nothing. Two descriptions
+ *	that hash the same but differ get a PSO each.
+ */
+class PipelineCache {
+public:
+	PipelineCacheStats stats = {};
+
+	PipelineCache() { pipelines.reserve(256); }
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+	~PipelineCache() {
+		for (auto& entry : pipelines) delete entry.second.pipeline;
+	}
+
+	GPUPipelineState* get(GPUDevice* device, const GPUPipelineDesc& desc) {
+		stats.requests++;
+		PipelineValues values(desc);
+		uint64_t hash = values.hash(desc);
+		auto range = pipelines.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (!it->second.key.matches(values, desc)) continue;
+			stats.hits++;
+			return it->second.pipeline;
+		}
+		if (range.first != range.second) {
+			stats.collisions++;
+			char line[128];
+			snprintf(line, sizeof(line), "PipelineCache: different descriptions share hash %016llx, creating another PSO\n", (unsigned long long)hash);
+			debugLog(line);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		GPUPipelineState* pipeline = device->createPipelineState(desc);
+		stats.createMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (!pipeline) return NULL;
+		pipelines.insert({ hash, { PipelineKey(values, desc), pipeline } });
+		stats.unique++;
+		return pipeline;
+	}
+
+	// Already created pipeline with this key, NULL if there is none (the first one if the key collided)
+	GPUPipelineState* find(uint64_t hash) const {
+		auto it = pipelines.find(hash);
+		return (it != pipelines.end()) ? it->second.pipeline : NULL;
+	}
+
+	void logStats() const {
+		char line[160];
+		snprintf(line, sizeof(line), "pipeline cache: %u unique for %llu requests (%llu hits, %u collisions), create %.2f ms\n",
+				 stats.unique, (unsigned long long)stats.requests, (unsigned long long)stats.hits, stats.collisions, stats.createMs);
+		debugLog(line);
+	}
+
+private:
+	struct Entry {
+		PipelineKey key;
+		GPUPipelineState* pipeline;
+	};
+
+	std::unordered_multimap<uint64_t, Entry> pipelines;
+};
@@ -12,11 +12,21 @@ float dist(float2 screenspace_pos, float2 light) {
 	return (length(screenspace_pos - light) / (50.0 * abs(cos(time)) + 0.001f));
 }
 
+// Permutation features, see ShaderManifest.txt
+#ifdef SINGLE_LIGHT
+#define LIGHT_COUNT 1
+#else
+#define LIGHT_COUNT 4
+#endif
+
 float4 PS(PS_INPUT input) : SV_Target0 {
 	float3 accumulated = float3(0, 0, 0);
-	for (unsigned int i = 0; i < 4; i++) {
+	for (unsigned int i = 0; i < LIGHT_COUNT; i++) {
 		accumulated += 1.0 / dist(input.Pos.xy, lights[i]);
 	}
 	accumulated *= input.Colour;
+#ifdef MONOCHROME
+	accumulated = dot(accumulated, float3(0.299, 0.587, 0.114)).xxx;
+#endif
 	return float4(accumulated, 1.0);
 }
\ No newline at end of file
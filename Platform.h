@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Write a message to the debugger output (Visual Studio) or to stderr when running headless
+inline void debugLog(const char* message) {
+#ifdef _WIN32
+	OutputDebugStringA(message);
+#else
+	fputs(message, stderr);
+#endif
+}
+
+inline void debugLog(const std::string& message) { debugLog(message.c_str()); }
+
+// alignment must be a power of two, memory from alignedAlloc must go back through alignedFree
+inline void* alignedAlloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* memory = NULL;
+	return (posix_memalign(&memory, alignment, size) == 0) ? memory : NULL;
+#endif
+}
+
+inline void alignedFree(void* memory) {
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+// Paths are wide strings on Windows, everything else only needs the ASCII subset we use for asset names
+inline std::string narrowPath(const std::wstring& path) {
+	std::string narrow;
+	for (wchar_t c : path) narrow.push_back((char)c);
+	return narrow;
+}
+
+inline bool readBinaryFile(const std::wstring& filename, std::vector<unsigned char>& data) {
+#ifdef _WIN32
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+#else
+	std::ifstream file(narrowPath(filename), std::ios::binary | std::ios::ate);
+#endif
+	if (!file) return false;
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	data.resize((size_t)size);
+	return size == 0 || (bool)file.read((char*)data.data(), size);
+}
+
+inline bool writeBinaryFile(const std::wstring& filename, const void* data, size_t size) {
+#ifdef _WIN32
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+#else
+	std::ofstream file(narrowPath(filename), std::ios::binary | std::ios::trunc);
+#endif
+	if (!file) return false;
+	return size == 0 || (bool)file.write((const char*)data, (std::streamsize)size);
+}
+
+// Creates one directory level, true if it exists afterwards
+inline bool createDirectory(const std::wstring& path) {
+#ifdef _WIN32
+	return CreateDirectoryW(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	struct stat info;
+	return mkdir(narrowPath(path).c_str(), 0755) == 0 || (stat(narrowPath(path).c_str(), &info) == 0 && S_ISDIR(info.st_mode));
+#endif
+}
+
+// 64-bit FNV-1a, stable across runs and platforms so it can name files on disk. Chain calls by
+// passing the previous result as seed.
+const uint64_t HASH_SEED = 14695981039346656037ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) seed = (seed ^ bytes[i]) * 1099511628211ull;
+	return seed;
+}
+
+// Length first, so "ab" + "c" and "a" + "bc" hash differently
+inline uint64_t hashString(const std::string& text, uint64_t seed = HASH_SEED) {
+	uint64_t length = text.size();
+	return hashBytes(text.data(), text.size(), hashBytes(&length, sizeof(length), seed));
+}
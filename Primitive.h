@@ -1,126 +1,131 @@
 #pragma once
 
+#include "BindingLayout.h"
 #include "Core.h"
 #include "ConstantBuffer.h"
 #include "ScreenSpaceTriangle.h"
 #include "PSOManager.h"
 #include "MyMath.h"
-
-#include <d3d12.h>
-#include <dxgi1_6.h>
-#include <d3d12shader.h>
-#include <d3dcompiler.h>
-
-#pragma comment(lib, "d3d12")
-#pragma comment(lib, "dxgi")
-#pragma comment(lib, "d3dcompiler.lib")
-#pragma comment(lib, "dxguid.lib")
+#include "ShaderReflection.h"
 
 // Simplest primitive is a triangle
 class Primitive {
 public:
 	// Vertex and Pixel Shaders
-	ID3DBlob* vertexShader;
-	ID3DBlob* pixelShader;
+	Shader* vertexShader;
+	Shader* pixelShader;
 
 	// Instance of ScreenSpaceTriangle
 	ScreenSpaceTriangle triangle;
 
 	// Instance of Pipeline Stage Object Manager
 	PSOManager psos;
+	GPUPipelineState* pso;
+
+	// Root signature built from what both shaders declare
+	BindingLayout layout;
+	GPURootSignature* rootSignature;
 
 	// Constant Buffer
 	ConstantBuffer constantBuffer;
 	std::vector<ConstantBuffer*> vsConstantBuffers; // Vertex Shader Buffers
 	std::vector<ConstantBuffer*> psConstantBuffers; // Pixel Shader Buffers
+	std::vector<ConstantBuffer*> boundBuffers;      // One per root parameter of layout
+
+	// Pixel shader variables resolved once from reflection
+	ConstantBufferHandle timeHandle;
+	ConstantBufferHandle lightsHandle;
 
 	void initialize(Core* core) {
 		triangle.initialize(core);
 
 		// Load Shaders via Manager (Note: Use L"String" for wstring filenames)
 		core->shaderManager.load("TriangleVS", L"VertexShader.hlsl", "VS", "vs_5_0", VERTEX_SHADER);
-		core->shaderManager.load("TrianglePS", L"PixelShader.hlsl", "PS", "ps_5_0", PIXEL_SHADER);
+		core->shaderManager.declarePermutations("TrianglePS", L"PixelShader.hlsl", "PS", "ps_5_0", PIXEL_SHADER, { "MONOCHROME", "SINGLE_LIGHT" });
+		core->shaderManager.compileManifest(L"ShaderManifest.txt");
+
+		vertexShader = core->shaderManager.getShader("TriangleVS");
+		pixelShader = core->shaderManager.getShader("TrianglePS", 0);
 
-		ID3DBlob* vsBlob = core->shaderManager.getShader("TriangleVS");
-		ID3DBlob* psBlob = core->shaderManager.getShader("TrianglePS");
+		ShaderReflection vsReflection, psReflection;
+		reflect(core, vertexShader, vsReflection);
+		reflect(core, pixelShader, psReflection);
 
-		// Reflect shader and get details (description)
-		ID3D12ShaderReflection* reflection;
-		D3DReflect(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), IID_PPV_ARGS(&reflection));
-		D3D12_SHADER_DESC desc;
-		reflection->GetDesc(&desc);
+		// Merge both stages into one root signature, shared with any pipeline that binds the same way
+		layout.build(vsReflection, psReflection);
+		rootSignature = core->rootSignatures.get(core->device, layout);
 
 		bool constantBufferFound = false;
 
-		// Iterate over constant buffers
-		for (int i = 0; i < desc.ConstantBuffers; i++) {
+		// One buffer per root parameter
+		for (unsigned int i = 0; i < layout.slots.size(); i++) {
 			// Get details about ith constant buffer
-			ID3D12ShaderReflectionConstantBuffer* constantBuffer = reflection->GetConstantBufferByIndex(i);
-			D3D12_SHADER_BUFFER_DESC cbDesc;
-			constantBuffer->GetDesc(&cbDesc);
+			const BindingSlot& slot = layout.slots[i];
+			const ConstantBufferReflection& cbDesc = slot.buffer;
 
-			ConstantBuffer* buffer = (i == 0) ? &this->constantBuffer : new ConstantBuffer();
+			// The first one the pixel shader reads is the primitive's own
+			bool first = !constantBufferFound && slot.visibility != GPU_VISIBILITY_VERTEX;
+			ConstantBuffer* buffer = first ? &this->constantBuffer : new ConstantBuffer();
 			unsigned int totalSize = 0;
 
 			// Iterate over variables in constant buffer
-			for (int j = 0; j < cbDesc.Variables; j++) {
+			for (unsigned int j = 0; j < cbDesc.variables.size(); j++) {
 				// Fill in details for each variable
 				// Keep a running total of size
-				ID3D12ShaderReflectionVariable* var = constantBuffer->GetVariableByIndex(j);
-				D3D12_SHADER_VARIABLE_DESC vDesc;
-				var->GetDesc(&vDesc);
-				ConstantBufferVariable bufferVariable;
-				bufferVariable.name = vDesc.Name;
-				bufferVariable.offset = vDesc.StartOffset;
-				bufferVariable.size = vDesc.Size;
+				const ConstantBufferVariable& bufferVariable = cbDesc.variables[j];
 
 				buffer->constantBufferData.insert({ bufferVariable.name, bufferVariable });
-				if (vDesc.StartOffset + vDesc.Size > totalSize) totalSize = vDesc.StartOffset + vDesc.Size;
+				if (bufferVariable.offset + bufferVariable.size > totalSize) totalSize = bufferVariable.offset + bufferVariable.size;
 			}
 
 			// Initialize the buffer with the calculated size
-			buffer->name = cbDesc.Name;
+			buffer->name = cbDesc.name;
 			buffer->initialize(core, totalSize);
+			buffer->rootIndex = slot.rootIndex;
+			buffer->rootConstants = (layout.parameters[i].type == GPU_ROOT_CONSTANTS) ? layout.parameters[i].num32BitValues : 0;
 
 			// Add to list for binding
-			psConstantBuffers.push_back(buffer);
+			boundBuffers.push_back(buffer);
+			if (slot.visibility != GPU_VISIBILITY_PIXEL) vsConstantBuffers.push_back(buffer);
+			if (slot.visibility != GPU_VISIBILITY_VERTEX) psConstantBuffers.push_back(buffer);
 
-			if (i == 0) constantBufferFound = true;
+			if (first) constantBufferFound = true;
 		}
 
-		reflection->Release();
-
 		if (!constantBufferFound) {
-			OutputDebugStringA("WARNING: No Constant Buffers found in shader! Using default.\n");
-			// Initialize with dummy size so pointers are valid
+			debugLog("WARNING: No Constant Buffers found in shader! Using default.\n");
+			// Initialize with dummy size so updates stay valid, the root signature has nothing to bind it to
 			this->constantBuffer.initialize(core, 256);
-			psConstantBuffers.push_back(&this->constantBuffer);
 		}
 
+		// Resolve variable names to offsets now so per-frame updates are a plain memcpy
+		timeHandle = constantBuffer.getHandle("time");
+		lightsHandle = constantBuffer.getHandle("lights");
+
 		// Create PSO using the loaded shaders
-		psos.createPSO(core, "Triangle", vsBlob, psBlob, triangle.mesh.inputLayoutDesc);
+		pso = psos.createPSO(core, "Triangle", vertexShader, pixelShader, triangle.mesh.inputLayoutDesc, rootSignature);
+	}
+
+	// Reflection comes from the shader cache, only ask the device if the cache couldn't parse the bytecode
+	static void reflect(Core* core, Shader* shader, ShaderReflection& reflection) {
+		if (shader->reflection) reflection = *shader->reflection;
+		else core->device->reflectShader(shader->bytecode.data(), shader->bytecode.size(), reflection);
 	}
 
 	void draw(Core* core) {
-		core->beginRenderPass();
+		core->beginRenderPass(rootSignature);
 
-		// Use apply() to Bind and Advance all buffers automatically
+		// Use apply() to upload and Bind all buffers automatically
 		apply(core);
 
-		psos.bind(core, "Triangle");
+		core->getCommandList()->setPipelineState(pso);
 		triangle.draw(core);
 	}
 
+	// Only the parameters the shaders use, each at the root index the layout gave it
 	void apply(Core* core) {
-		// Bind VS buffers
-		for (int i = 0; i < vsConstantBuffers.size(); i++) {
-			core->getCommandList()->SetGraphicsRootConstantBufferView(i, vsConstantBuffers[i]->getGPUAddress());
-			vsConstantBuffers[i]->next();
-		}
-		// Bind PS buffers (Offset by 1)
-		for (int i = 0; i < psConstantBuffers.size(); i++) {
-			core->getCommandList()->SetGraphicsRootConstantBufferView(1 + i, psConstantBuffers[i]->getGPUAddress());
-			psConstantBuffers[i]->next();
+		for (unsigned int i = 0; i < boundBuffers.size(); i++) {
+			boundBuffers[i]->bind(core->getCommandList());
 		}
 	}
 };
\ No newline at end of file
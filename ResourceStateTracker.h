@@ -0,0 +1,218 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "GPUDevice.h"
+
+struct BarrierStats {
+	uint64_t transitions;   // transition() calls
+	uint64_t redundant;     // Transitions dropped because the resource was already in that state
+	uint64_t barriers;      // Barriers actually recorded
+	uint64_t flushes;       // resourceBarriers calls made
+	uint64_t largestFlush;  // Most barriers sent in one call
+};
+
+/*
+ *	Tracks the state of every resource (and subresource) touched by one command list.
+ *	The first touch starts from the state the resource was left in by the last closed list,
+ *	so callers only say what state they need next. Transitions are queued and merged, then
+ *	sent to the command list as one resourceBarriers call by flush().
+ *	Lists are assumed to execute in the order they are closed, which is how Core submits them,
+ *	and no other list may change a tracked resource while this one is open: its first touches
+ *	already assumed the earlier state. Core rejects synchronous uploads mid-frame for that reason.
+ */
+class ResourceStateTracker {
+public:
+	struct TrackedResource {
+		GPUResourceState state;
+		std::vector<GPUResourceState> subresources;  // Empty while every subresource is in state
+		unsigned int pendingIndex;                   // Whole-resource barrier queued since the last flush
+		uint64_t pendingGeneration;                  // ...only valid while generation still equals this
+	};
+
+	std::unordered_map<GPUResource*, TrackedResource> resources;
+	std::vector<GPUBarrier> pending;
+	uint64_t generation = 0;  // Bumped every time pending is emptied
+	BarrierStats stats = {};
+
+	void reset() {
+		resources.clear();
+		pending.clear();
+		stats = {};
+	}
+
+	void transition(GPUResource* resource, GPUResourceState after, unsigned int subresource = GPU_ALL_SUBRESOURCES) {
+		stats.transitions++;
+		TrackedResource& tracked = touch(resource);
+		if (resource->subresourceCount == 1) subresource = GPU_ALL_SUBRESOURCES;
+
+		if (subresource == GPU_ALL_SUBRESOURCES) {
+			if (tracked.subresources.empty()) {
+				if (tracked.state == after) {
+					stats.redundant++;
+					return;
+				}
+				add(tracked, resource, GPU_ALL_SUBRESOURCES, tracked.state, after);
+			} else {
+				// Bring the stragglers over one by one, then collapse back to a single state
+				for (unsigned int i = 0; i < tracked.subresources.size(); i++) {
+					if (tracked.subresources[i] != after) add(tracked, resource, i, tracked.subresources[i], after);
+				}
+				tracked.subresources.clear();
+			}
+			tracked.state = after;
+			return;
+		}
+
+		if (tracked.subresources.empty()) {
+			if (tracked.state == after) {
+				stats.redundant++;
+				return;
+			}
+			tracked.subresources.assign(resource->subresourceCount, tracked.state);
+		}
+		if (tracked.subresources[subresource] == after) {
+			stats.redundant++;
+			return;
+		}
+		add(tracked, resource, subresource, tracked.subresources[subresource], after);
+		tracked.subresources[subresource] = after;
+	}
+
+	// Record every queued transition with one call
+	void flush(GPUCommandList* commandList) {
+		// Drop transitions that were merged back to where they started
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < pending.size(); i++)
+			if (pending[i].before != pending[i].after) pending[count++] = pending[i];
+
+		if (count > 0) {
+			commandList->resourceBarriers(count, &pending[0]);
+			stats.barriers += count;
+			stats.flushes++;
+			if (count > stats.largestFlush) stats.largestFlush = count;
+		}
+		pending.clear();
+		generation++;
+	}
+
+	// The list is closed, later lists start from the states it leaves resources in
+	void commit() {
+		for (auto& entry : resources) {
+			entry.first->state = entry.second.state;
+			entry.first->subresourceStates = entry.second.subresources;
+		}
+	}
+
+private:
+	TrackedResource& touch(GPUResource* resource) {
+		auto found = resources.find(resource);
+		if (found != resources.end()) return found->second;
+		TrackedResource& tracked = resources[resource];
+		tracked.state = resource->state;
+		tracked.subresources = resource->subresourceStates;
+		tracked.pendingIndex = 0;
+		tracked.pendingGeneration = ~0ull;
+		return tracked;
+	}
+
+	void add(TrackedResource& tracked, GPUResource* resource, unsigned int subresource, GPUResourceState before, GPUResourceState after) {
+		// A whole-resource transition still waiting to be flushed can just be retargeted (A->B then B->C is A->C)
+		if (subresource == GPU_ALL_SUBRESOURCES) {
+			if (tracked.pendingGeneration == generation && pending[tracked.pendingIndex].after == before) {
+				pending[tracked.pendingIndex].after = after;
+				if (pending[tracked.pendingIndex].before == after) stats.redundant++;
+				return;
+			}
+			tracked.pendingIndex = (unsigned int)pending.size();
+			tracked.pendingGeneration = generation;
+		} else {
+			// Anything queued for a subresource after the whole-resource barrier depends on it, so stop retargeting it
+			tracked.pendingGeneration = ~0ull;
+		}
+		GPUBarrier barrier = { resource, subresource, before, after };
+		pending.push_back(barrier);
+	}
+};
+
+/*
+ *	Command list that keeps a ResourceStateTracker and flushes its pending transitions
+ *	right before anything that depends on them (draws, copies, clears, explicit barriers).
+ *	Execute the wrapped commandList, not this object.
+ */
+class TrackedCommandList : public GPUCommandList {
+public:
+	GPUCommandList* commandList = NULL;
+	ResourceStateTracker states;
+
+	void initialize(GPUCommandList* _commandList) {
+		commandList = _commandList;
+	}
+
+	~TrackedCommandList() {
+		delete commandList;
+	}
+
+	void transition(GPUResource* resource, GPUResourceState after, unsigned int subresource = GPU_ALL_SUBRESOURCES) {
+		states.transition(resource, after, subresource);
+	}
+
+	void reset() override {
+		states.reset();
+		commandList->reset();
+	}
+
+	void close() override {
+		states.flush(commandList);
+		states.commit();
+		commandList->close();
+	}
+
+	void resourceBarriers(unsigned int count, const GPUBarrier* barriers) override {
+		states.flush(commandList);
+		commandList->resourceBarriers(count, barriers);
+	}
+
+	void copyBufferRegion(GPUResource* dst, uint64_t dstOffset, GPUResource* src, uint64_t srcOffset, uint64_t size) override {
+		states.flush(commandList);
+		commandList->copyBufferRegion(dst, dstOffset, src, srcOffset, size);
+	}
+
+	void copyTextureRegion(GPUResource* dst, unsigned int dstSubresource, GPUResource* src, const GPUTextureFootprint& srcFootprint) override {
+		states.flush(commandList);
+		commandList->copyTextureRegion(dst, dstSubresource, src, srcFootprint);
+	}
+
+	void setRenderTargets(GPUResource* renderTarget, GPUResource* depthBuffer) override { commandList->setRenderTargets(renderTarget, depthBuffer); }
+
+	void clearRenderTarget(GPUResource* renderTarget, const float colour[4]) override {
+		states.flush(commandList);
+		commandList->clearRenderTarget(renderTarget, colour);
+	}
+
+	void clearDepth(GPUResource* depthBuffer, float depth) override {
+		states.flush(commandList);
+		commandList->clearDepth(depthBuffer, depth);
+	}
+
+	void setViewport(const GPUViewport& viewport) override { commandList->setViewport(viewport); }
+	void setScissorRect(const GPURect& rect) override { commandList->setScissorRect(rect); }
+	void setRootSignature(GPURootSignature* rootSignature) override { commandList->setRootSignature(rootSignature); }
+	void setPipelineState(GPUPipelineState* pso) override { commandList->setPipelineState(pso); }
+	void setRootConstantBufferView(unsigned int index, uint64_t address) override { commandList->setRootConstantBufferView(index, address); }
+	void setRootConstants(unsigned int index, unsigned int count, const void* data) override { commandList->setRootConstants(index, count, data); }
+	void setPrimitiveTopology(GPUTopology topology) override { commandList->setPrimitiveTopology(topology); }
+	void setVertexBuffers(unsigned int startSlot, unsigned int count, const GPUVertexBufferView* views) override { commandList->setVertexBuffers(startSlot, count, views); }
+	void setIndexBuffer(const GPUIndexBufferView& view) override { commandList->setIndexBuffer(view); }
+
+	void drawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) override {
+		states.flush(commandList);
+		commandList->drawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+	}
+
+	void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override {
+		states.flush(commandList);
+		commandList->drawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	}
+};
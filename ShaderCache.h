@@ -0,0 +1,239 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Platform.h"
+#include "ShaderReflection.h"
+
+// Everything that decides what the compiler produces for one shader
+struct ShaderCompileKey {
+	std::wstring filename;
+	std::string entryPoint;
+	std::string profile;
+	std::vector<std::pair<std::string, std::string>> defines;  // Name, value
+	unsigned int flags = 0;
+};
+
+struct ShaderCacheStats {
+	unsigned int hits;
+	unsigned int misses;
+	double compileMs;  // Spent compiling the misses
+	double hashMs;     // Spent reading and hashing sources
+	unsigned int reflectionsParsed;  // Blobs reflected from their bytecode, once each
+};
+
+/*
+ *	Compiled shaders on disk, named by a hash of everything that went into them: the source, every
+ *	file it includes (followed recursively), the defines, entry point, profile and compiler flags.
+ *	Editing any of those changes the hash, so a stale blob can never be picked up again, and only
+ *	the shaders that really changed miss. Blobs live in <directory>/v<CACHE_VERSION>/<hash>.cso,
+ *	next to index.txt which lists what each hash was built from. Bump CACHE_VERSION whenever the
+ *	compiler or the blob format changes and the whole cache is ignored.
+ *	Reflections are parsed from the bytecode already in memory and kept per hash for the run.
+ *	Parsing DXBC is cheaper than reading a file back, so nothing about them is written to disk.
+ *	computeHash, find and store can be called from several threads at once.
+ */
+class ShaderCache {
+public:
+	static const unsigned int CACHE_VERSION = 2;  // 2: stub compiler output is no longer stored
+
+	struct Entry {
+		std::string name;
+		std::string entryPoint;
+		std::string profile;
+		size_t bytes = 0;
+	};
+
+	std::wstring directory;
+	std::unordered_map<uint64_t, Entry> index;
+	ShaderCacheStats stats = {};
+
+	ShaderCache() {}
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+	~ShaderCache() {
+		for (auto& reflection : reflections) delete reflection.second;
+	}
+
+	void initialize(const std::wstring& root = L"ShaderCache") {
+		createDirectory(root);
+		directory = root + L"/v" + std::to_wstring(CACHE_VERSION);
+		if (!createDirectory(directory)) debugLog("ShaderCache: could not create " + narrowPath(directory) + ", nothing will be cached\n");
+		loadIndex();
+	}
+
+	// 0 if the source can't be read
+	uint64_t computeHash(const ShaderCompileKey& key) {
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<unsigned char> source;
+		uint64_t hash = 0;
+		if (readBinaryFile(key.filename, source)) {
+			hash = hashString("shader cache v" + std::to_string(CACHE_VERSION));
+			hash = hashBytes(source.data(), source.size(), hash);
+			std::set<std::string> visited;
+			visited.insert(narrowPath(key.filename));
+			hash = hashIncludes(source, narrowPath(key.filename), visited, hash);
+			for (const auto& define : key.defines) hash = hashString(define.second, hashString(define.first, hash));
+			hash = hashString(key.profile, hashString(key.entryPoint, hash));
+			hash = hashBytes(&key.flags, sizeof(key.flags), hash);
+			if (hash == 0) hash = 1;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.hashMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return hash;
+	}
+
+	bool find(uint64_t hash, std::vector<unsigned char>& bytecode) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (index.find(hash) == index.end()) return false;
+		}
+		if (!readBinaryFile(blobPath(hash), bytecode) || bytecode.empty()) return false;
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.hits++;
+		return true;
+	}
+
+	// Record a freshly compiled blob
+	void store(uint64_t hash, const std::string& name, const ShaderCompileKey& key, const std::vector<unsigned char>& bytecode, double compileMs) {
+		bool written = !bytecode.empty() && writeBinaryFile(blobPath(hash), bytecode.data(), bytecode.size());
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.misses++;
+		stats.compileMs += compileMs;
+		if (!written) return;
+		Entry entry;
+		entry.name = name;
+		entry.entryPoint = key.entryPoint;
+		entry.profile = key.profile;
+		entry.bytes = bytecode.size();
+		index[hash] = entry;
+
+		// Appended, a later line for the same hash wins when the index is read back
+#ifdef _WIN32
+		std::ofstream file(indexPath(), std::ios::app);
+#else
+		std::ofstream file(narrowPath(indexPath()), std::ios::app);
+#endif
+		file << hashName(hash) << " " << entry.name << " " << entry.entryPoint << " " << entry.profile << " " << entry.bytes << "\n";
+	}
+
+	// A compile whose output isn't stored still counts as a miss
+	void countUncached(double compileMs) {
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.misses++;
+		stats.compileMs += compileMs;
+	}
+
+	/*
+	 *	Reflection of a blob, valid as long as the cache. hash is the one the blob was stored
+	 *	under, or 0 for bytecode that isn't in the cache, which is then keyed by its own hash.
+	 *	NULL if the bytecode can't be reflected (not DXBC).
+	 */
+	const ShaderReflection* reflection(uint64_t hash, const std::vector<unsigned char>& bytecode) {
+		if (hash == 0) hash = hashBytes(bytecode.data(), bytecode.size());
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = reflections.find(hash);
+			if (it != reflections.end()) return it->second;
+		}
+
+		ShaderReflection* reflection = new ShaderReflection();
+		if (!parseDXBCReflection(bytecode.data(), bytecode.size(), *reflection)) {
+			delete reflection;
+			return NULL;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.reflectionsParsed++;
+		auto inserted = reflections.insert({ hash, reflection });
+		if (!inserted.second) delete reflection;  // Another thread got there first
+		return inserted.first->second;
+	}
+
+	// Delete every blob in the index and start empty. Reflections already handed out stay valid.
+	void clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& entry : index) std::remove(narrowPath(blobPath(entry.first)).c_str());
+		std::remove(narrowPath(indexPath()).c_str());
+		index.clear();
+		stats = {};
+	}
+
+	void logStats() const {
+		unsigned int total = stats.hits + stats.misses;
+		char line[256];
+		snprintf(line, sizeof(line), "shader cache: %u hits %u misses (%.0f%% hit rate), compile %.2f ms, hashing %.2f ms, %u entries, %u reflections parsed\n",
+				 stats.hits, stats.misses, total ? 100.0 * stats.hits / total : 0.0, stats.compileMs, stats.hashMs, (unsigned int)index.size(),
+				 stats.reflectionsParsed);
+		debugLog(line);
+	}
+
+	static std::string hashName(uint64_t hash) {
+		char name[17];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+		return name;
+	}
+
+	std::wstring blobPath(uint64_t hash) const {
+		std::string name = hashName(hash);
+		return directory + L"/" + std::wstring(name.begin(), name.end()) + L".cso";
+	}
+
+private:
+	std::mutex mutex;  // Guards index, reflections, stats and the index file
+	std::unordered_map<uint64_t, ShaderReflection*> reflections;
+
+	std::wstring indexPath() const { return directory + L"/index.txt"; }
+
+	void loadIndex() {
+#ifdef _WIN32
+		std::ifstream file(indexPath());
+#else
+		std::ifstream file(narrowPath(indexPath()));
+#endif
+		std::string line;
+		while (std::getline(file, line)) {
+			std::istringstream fields(line);
+			std::string hash;
+			Entry entry;
+			if (fields >> hash >> entry.name >> entry.entryPoint >> entry.profile >> entry.bytes)
+				index[strtoull(hash.c_str(), NULL, 16)] = entry;
+		}
+	}
+
+	// Folds in every #include "file" / <file>, relative to the including file, each file once
+	uint64_t hashIncludes(const std::vector<unsigned char>& source, const std::string& path, std::set<std::string>& visited, uint64_t hash) {
+		std::string folder = path.substr(0, path.find_last_of("/\\") + 1);
+		std::istringstream lines(std::string(source.begin(), source.end()));
+		std::string line;
+		while (std::getline(lines, line)) {
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 1, "#") != 0) continue;
+			size_t directive = line.find_first_not_of(" \t", start + 1);
+			if (directive == std::string::npos || line.compare(directive, 7, "include") != 0) continue;
+			size_t open = line.find_first_of("\"<", directive + 7);
+			size_t close = (open == std::string::npos) ? open : line.find_first_of("\">", open + 1);
+			if (close == std::string::npos) continue;
+
+			std::string include = folder + line.substr(open + 1, close - open - 1);
+			hash = hashString(include, hash);
+			if (!visited.insert(include).second) continue;
+			std::vector<unsigned char> contents;
+			// A missing include only hashes its name, the compiler reports the error
+			if (!readBinaryFile(std::wstring(include.begin(), include.end()), contents)) continue;
+			hash = hashBytes(contents.data(), contents.size(), hash);
+			hash = hashIncludes(contents, include, visited, hash);
+		}
+		return hash;
+	}
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Platform.h"
+#include "ShaderCache.h"
+
+#ifdef _WIN32
+#include <d3dcompiler.h>
+
+#pragma comment(lib, "d3dcompiler.lib")
+#endif
+
+/*
+ *	Turns one HLSL entry point into bytecode. ShaderManager calls compile() from several pool
+ *	threads at once when building permutations, so backends must not keep per-call state.
+ */
+class ShaderCompiler {
+public:
+	virtual ~ShaderCompiler() {}
+	virtual bool compile(const ShaderCompileKey& key, std::vector<unsigned char>& bytecode) = 0;
+
+	// False when the bytecode doesn't really come from the key, so it must not be stored under its hash
+	virtual bool cacheable() const { return true; }
+};
+
+#ifdef _WIN32
+class D3DShaderCompiler : public ShaderCompiler {
+public:
+	bool compile(const ShaderCompileKey& key, std::vector<unsigned char>& bytecode) override {
+		// NULL terminated macro list
+		std::vector<D3D_SHADER_MACRO> macros;
+		for (const auto& define : key.defines) macros.push_back({ define.first.c_str(), define.second.c_str() });
+		macros.push_back({ NULL, NULL });
+
+		ID3DBlob* blob = nullptr;
+		ID3DBlob* error = nullptr;
+		HRESULT hr = D3DCompileFromFile(
+			key.filename.c_str(),               // File path (L"VertexShader.hlsl")
+			&macros[0],                         // Permutation defines
+			D3D_COMPILE_STANDARD_FILE_INCLUDE,  // #include relative to the file
+			key.entryPoint.c_str(),             // Function name (e.g., "VS" or "main")
+			key.profile.c_str(),                // Target (e.g., "vs_5_0")
+			key.flags, 0,                       // Flags
+			&blob, &error                       // Outputs
+		);
+
+		if (FAILED(hr)) {
+			if (error) {
+				debugLog((char*)error->GetBufferPointer());
+				error->Release();
+			}
+			return false;
+		}
+		const unsigned char* code = (const unsigned char*)blob->GetBufferPointer();
+		bytecode.assign(code, code + blob->GetBufferSize());
+		blob->Release();
+		return true;
+	}
+};
+#endif
+
+/*
+ *	Stand-in for platforms without an HLSL compiler (headless Linux): every compile returns the
+ *	checked-in <file>.cso whatever the defines, optionally after sleeping simulatedMs to stand
+ *	in for real compile cost. Lets the cache, permutation and manifest paths run anywhere.
+ *	Its output is the same for every permutation, so it is not cached unless a scratch cache
+ *	that only checks the cache itself asks for it with cacheOutput.
+ */
+class StubShaderCompiler : public ShaderCompiler {
+public:
+	unsigned int simulatedMs = 0;
+	bool cacheOutput = false;
+
+	bool cacheable() const override { return cacheOutput; }
+
+	bool compile(const ShaderCompileKey& key, std::vector<unsigned char>& bytecode) override {
+		if (!warned.exchange(true)) debugLog("ShaderCompiler: no HLSL compiler, compiles return the pre-compiled .cso files\n");
+		if (simulatedMs) std::this_thread::sleep_for(std::chrono::milliseconds(simulatedMs));
+		if (readBinaryFile(key.filename + L".cso", bytecode)) return true;
+		debugLog("ShaderCompiler: missing " + narrowPath(key.filename) + ".cso\n");
+		return false;
+	}
+
+private:
+	std::atomic<bool> warned{ false };
+};
+
+// The real compiler where there is one
+inline ShaderCompiler* createShaderCompiler() {
+#ifdef _WIN32
+	return new D3DShaderCompiler();
+#else
+	return new StubShaderCompiler();
+#endif
+}
@@ -1,72 +1,257 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <map>
+#include <sstream>
 #include <string>
-#include <d3dcompiler.h>
+#include <utility>
+#include <vector>
 
-#pragma comment(lib, "d3dcompiler.lib")
+#include "Platform.h"
+#include "ShaderCache.h"
+#include "ShaderCompiler.h"
+#include "ThreadPool.h"
 
 enum ShaderType { VERTEX_SHADER, PIXEL_SHADER };
 
 struct Shader {
-	ID3DBlob* blob;
+	std::vector<unsigned char> bytecode;
 	ShaderType type;
+	const ShaderReflection* reflection = NULL;  // Owned by the shader cache, NULL if the bytecode couldn't be reflected
+	uint64_t hash = 0;  // Of the bytecode, identifies the shader in pipeline keys
+};
+
+// One HLSL entry point and the features it can be built with, feature i is bit i of a mask
+struct ShaderPermutations {
+    std::wstring filename;
+    std::string entryPoint;
+    std::string profile;
+    ShaderType type;
+    std::vector<std::string> features;  // Defined as 1 when their bit is set
+    std::map<uint32_t, Shader> variants;  // Compiled so far, by mask
+
+    uint32_t featureBit(const std::string& feature) const {
+        for (size_t i = 0; i < features.size(); i++) if (features[i] == feature) return 1u << i;
+        return 0;
+    }
 };
 
 class ShaderManager {
 public:
 	std::map<std::string, Shader> shaders;
+    std::map<std::string, ShaderPermutations> permutations;
 
-    ~ShaderManager() {
-        for (auto& pair : shaders) {
-            // pair.first = name (string) && pair.second = Shader (Shader)
-            if (pair.second.blob) {
-                pair.second.blob->Release();
-            }
-        }
-    }
+    // Compiled blobs keyed by a hash of their inputs, set up on the first load
+    ShaderCache cache;
+
+    // Permutations compile in parallel here when set, otherwise on the calling thread
+    ThreadPool* compilePool = NULL;
+    unsigned int permutationsBuilt = 0;
+    double permutationMs = 0.0;  // Wall time spent in compilePermutations
 
-    ID3DBlob* getShader(std::string name) {
-        if (shaders.find(name) != shaders.end()) return shaders[name].blob;
+    ~ShaderManager() { delete compiler; }
+
+    Shader* getShader(std::string name) {
+        if (shaders.find(name) != shaders.end()) return &shaders[name];
         return nullptr;
     }
 
-    void load(std::string name, std::wstring filename, std::string entryPoint, std::string profile, ShaderType type) {
-        ID3DBlob* blob = nullptr;
-        ID3DBlob* error = nullptr;
-        HRESULT hr;
+    // The variant of a declared shader with exactly the features in mask, compiled now if it wasn't precompiled
+    Shader* getShader(const std::string& name, uint32_t mask) {
+        auto it = permutations.find(name);
+        if (it == permutations.end()) return nullptr;
+        if (it->second.features.size() < 32) mask &= (1u << it->second.features.size()) - 1;
+        auto variant = it->second.variants.find(mask);
+        if (variant != it->second.variants.end()) return &variant->second;
 
-        // Try to load pre-compiled CSO file first
-        std::wstring csoName = filename + L".cso";
-        hr = D3DReadFileToBlob(csoName.c_str(), &blob);
+        compilePermutations({ { name, mask } });
+        variant = it->second.variants.find(mask);
+        return (variant != it->second.variants.end()) ? &variant->second : nullptr;
+    }
 
-        if (SUCCEEDED(hr)) {
-            shaders[name] = { blob, type };
-            return;
+    // Replaces the backend, ShaderManager owns it from here on
+    void setCompiler(ShaderCompiler* _compiler) {
+        delete compiler;
+        compiler = _compiler;
+    }
+
+    void load(std::string name, std::wstring filename, std::string entryPoint, std::string profile, ShaderType type,
+              const std::vector<std::pair<std::string, std::string>>& defines = {}) {
+        ShaderCompileKey key;
+        key.filename = filename;
+        key.entryPoint = entryPoint;
+        key.profile = profile;
+        key.defines = defines;
+        key.flags = compileFlags();
+
+        Shader shader;
+        shader.type = type;
+        if (build(name, key, shader)) shaders[name] = shader;
+    }
+
+    // Nothing is compiled until a variant is asked for, by getShader or a manifest
+    void declarePermutations(std::string name, std::wstring filename, std::string entryPoint, std::string profile, ShaderType type,
+                             const std::vector<std::string>& features) {
+        if (features.size() > 32) debugLog("ShaderManager: " + name + " has more than 32 features\n");
+        ShaderPermutations& declared = permutations[name];
+        declared.filename = filename;
+        declared.entryPoint = entryPoint;
+        declared.profile = profile;
+        declared.type = type;
+        declared.features = features;
+        declared.variants.clear();
+    }
+
+    // Builds every (name, mask) not built yet, spread over compilePool
+    void compilePermutations(const std::vector<std::pair<std::string, uint32_t>>& requests) {
+        struct Job {
+            std::string name;
+            ShaderPermutations* declared;
+            uint32_t mask;
+            Shader shader;
+            bool built;
+        };
+        std::vector<Job> jobs;
+        for (const auto& request : requests) {
+            auto it = permutations.find(request.first);
+            if (it == permutations.end()) {
+                debugLog("ShaderManager: no permutations declared for " + request.first + "\n");
+                continue;
+            }
+            bool queued = false;
+            for (const Job& job : jobs) queued |= (job.declared == &it->second && job.mask == request.second);
+            if (queued || it->second.variants.count(request.second)) continue;
+            Job job;
+            job.name = request.first;
+            job.declared = &it->second;
+            job.mask = request.second;
+            job.shader.type = it->second.type;
+            job.built = false;
+            jobs.push_back(job);
         }
+        if (jobs.empty()) return;
+        ensureInitialized();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        ThreadPool::Job work = [&](unsigned int index, unsigned int) {
+            Job& job = jobs[index];
+            job.built = build(job.name + "#" + std::to_string(job.mask), permutationKey(*job.declared, job.mask), job.shader);
+        };
+        if (compilePool) compilePool->run((unsigned int)jobs.size(), work);
+        else for (unsigned int i = 0; i < jobs.size(); i++) work(i, 0);
 
-        // If CSO file is missing, compile from HLSL file
-        hr = D3DCompileFromFile(
-            filename.c_str(),    // File path (L"VertexShader.hlsl")
-            nullptr, nullptr,    // Macros and Includes
-            entryPoint.c_str(),  // Function name (e.g., "VS" or "main")
-            profile.c_str(),     // Target (e.g., "vs_5_0")
-            0, 0,                // Flags
-            &blob, &error        // Outputs
-        );
-
-        if (FAILED(hr)) {
-            if (error) {
-                OutputDebugStringA((char*)error->GetBufferPointer());
-                error->Release();
+        unsigned int built = 0;
+        for (Job& job : jobs) {
+            if (!job.built) continue;
+            job.declared->variants[job.mask] = job.shader;
+            built++;
+        }
+        permutationMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        permutationsBuilt += built;
+    }
+
+    /*
+     *	Precompile the variants listed in a manifest, one per line: the shader name, then the
+     *	features to enable (none for the base variant). # starts a comment.
+     *	    TrianglePS
+     *	    TrianglePS MONOCHROME SINGLE_LIGHT
+     *	Returns false if the file can't be read.
+     */
+    bool compileManifest(const std::wstring& filename) {
+#ifdef _WIN32
+        std::ifstream file(filename);
+#else
+        std::ifstream file(narrowPath(filename));
+#endif
+        if (!file) return false;
+        std::vector<std::pair<std::string, uint32_t>> requests;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line.substr(0, line.find('#')));
+            std::string name, feature;
+            if (!(fields >> name)) continue;
+            auto it = permutations.find(name);
+            if (it == permutations.end()) {
+                debugLog("ShaderManager: manifest lists undeclared shader " + name + "\n");
+                continue;
             }
-            return;
+            uint32_t mask = 0;
+            while (fields >> feature) {
+                uint32_t bit = it->second.featureBit(feature);
+                if (!bit) debugLog("ShaderManager: " + name + " has no feature " + feature + "\n");
+                mask |= bit;
+            }
+            requests.push_back({ name, mask });
         }
+        compilePermutations(requests);
+        return true;
+    }
+
+    void logPermutationStats() const {
+        char line[160];
+        snprintf(line, sizeof(line), "shader permutations: %u built in %.2f ms on %u threads\n",
+                 permutationsBuilt, permutationMs, compilePool ? compilePool->threadCount() : 1);
+        debugLog(line);
+    }
+
+    static unsigned int compileFlags() {
+#if defined(_WIN32) && defined(_DEBUG)
+        return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#elif defined(_WIN32)
+        return D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#else
+        return 0;
+#endif
+    }
 
-        // Save to CSO so next run is faster
-        D3DWriteBlobToFile(blob, csoName.c_str(), FALSE);
+private:
+    ShaderCompiler* compiler = NULL;
 
-        // Store in map
-        shaders[name] = { blob, type };
+    static ShaderCompileKey permutationKey(const ShaderPermutations& declared, uint32_t mask) {
+        ShaderCompileKey key;
+        key.filename = declared.filename;
+        key.entryPoint = declared.entryPoint;
+        key.profile = declared.profile;
+        key.flags = compileFlags();
+        for (size_t i = 0; i < declared.features.size(); i++)
+            if (mask & (1u << i)) key.defines.push_back({ declared.features[i], "1" });
+        return key;
     }
-};
\ No newline at end of file
+
+    // Cache lookup, then compile and store on a miss, then the reflection. Safe to call from several threads.
+    bool build(const std::string& name, const ShaderCompileKey& key, Shader& shader) {
+        ensureInitialized();
+        uint64_t hash = cache.computeHash(key);
+
+        // No source to hash (shipped without HLSL), the pre-compiled CSO is all there is
+        if (hash == 0) {
+            if (!readBinaryFile(key.filename + L".cso", shader.bytecode)) {
+                debugLog("ShaderManager: missing " + narrowPath(key.filename) + " and " + narrowPath(key.filename) + ".cso\n");
+                return false;
+            }
+        } else if (!cache.find(hash, shader.bytecode)) {
+            auto start = std::chrono::high_resolution_clock::now();
+            if (!compiler->compile(key, shader.bytecode)) return false;
+            double compileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if (compiler->cacheable()) {
+                cache.store(hash, name, key, shader.bytecode, compileMs);
+            } else {
+                // Not what the key describes, file its reflection under the bytecode's own hash
+                cache.countUncached(compileMs);
+                hash = 0;
+            }
+        }
+        shader.reflection = cache.reflection(hash, shader.bytecode);
+        shader.hash = hashBytes(shader.bytecode.data(), shader.bytecode.size());
+        return true;
+    }
+
+    // First use is always on the main thread, before any pool jobs
+    void ensureInitialized() {
+        if (cache.directory.empty()) cache.initialize();
+        if (!compiler) compiler = createShaderCompiler();
+    }
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct ConstantBufferVariable {
+	std::string name;
+	unsigned int offset;  // Byte offset in the struct (e.g., time is 0)
+	unsigned int size;    // Size in bytes
+};
+
+struct ConstantBufferReflection {
+	std::string name;
+	unsigned int size;       // Size in bytes as declared in the shader
+	unsigned int bindPoint;  // Register(bN)
+	std::vector<ConstantBufferVariable> variables;
+};
+
+// One element of the input signature (vertex attributes for a vertex shader)
+struct ShaderInputParameter {
+	std::string semanticName;
+	unsigned int semanticIndex;
+	unsigned int registerIndex;
+	unsigned int componentType;  // D3D_REGISTER_COMPONENT_TYPE - 1 uint, 2 int, 3 float
+	unsigned int mask;           // Components present, bit 0 is x
+};
+
+// Backend independent result of reflecting a compiled shader
+struct ShaderReflection {
+	std::vector<ConstantBufferReflection> constantBuffers;
+	std::vector<ShaderInputParameter> inputs;
+};
+
+/*
+ *	Minimal DXBC container reader (RDEF and ISGN chunks) so constant buffer layouts and the input signature can be
+ *	recovered without D3DReflect.
+ *	Layout: "DXBC", 16 byte checksum, version, total size, chunk count, chunk offsets - each chunk is FourCC, size, data.
+ *	All offsets inside a chunk are relative to the start of its data.
+ */
+inline bool parseDXBCReflection(const void* bytecode, size_t size, ShaderReflection& reflection) {
+	const unsigned char* bytes = (const unsigned char*)bytecode;
+	auto read32 = [&](size_t offset) -> unsigned int {
+		unsigned int value = 0;
+		if (offset + 4 <= size) memcpy(&value, bytes + offset, 4);
+		return value;
+	};
+
+	if (size < 32 || memcmp(bytes, "DXBC", 4) != 0) return false;
+
+	bool found = false;
+	unsigned int chunkCount = read32(28);
+	for (unsigned int i = 0; i < chunkCount; i++) {
+		size_t chunkOffset = read32(32 + i * 4);
+		if (chunkOffset + 8 > size) continue;
+
+		// Element count, 8, then 24 bytes per element: name, semantic index, system value, component type, register, mask
+		if (memcmp(bytes + chunkOffset, "ISGN", 4) == 0) {
+			size_t isgn = chunkOffset + 8;
+			size_t isgnSize = read32(chunkOffset + 4);
+			if (isgn + isgnSize > size) return false;
+			unsigned int elementCount = read32(isgn);
+			for (unsigned int e = 0; e < elementCount && 8 + (e + 1) * 24 <= isgnSize; e++) {
+				size_t element = isgn + 8 + e * 24;
+				unsigned int nameOffset = read32(element + 0);
+				ShaderInputParameter input;
+				if (nameOffset < isgnSize) input.semanticName = std::string((const char*)(bytes + isgn + nameOffset), strnlen((const char*)(bytes + isgn + nameOffset), isgnSize - nameOffset));
+				input.semanticIndex = read32(element + 4);
+				input.componentType = read32(element + 12);
+				input.registerIndex = read32(element + 16);
+				input.mask = bytes[element + 20];
+				reflection.inputs.push_back(input);
+			}
+			continue;
+		}
+		if (memcmp(bytes + chunkOffset, "RDEF", 4) != 0) continue;
+
+		size_t rdef = chunkOffset + 8;
+		size_t rdefSize = read32(chunkOffset + 4);
+		if (rdef + rdefSize > size) return false;
+		auto readString = [&](unsigned int offset) -> std::string {
+			if (offset >= rdefSize) return std::string();
+			const char* str = (const char*)(bytes + rdef + offset);
+			return std::string(str, strnlen(str, rdefSize - offset));
+		};
+
+		unsigned int cbCount = read32(rdef + 0);
+		unsigned int cbOffset = read32(rdef + 4);
+		unsigned int bindCount = read32(rdef + 8);
+		unsigned int bindOffset = read32(rdef + 12);
+		unsigned int version = read32(rdef + 16);
+		unsigned int major = (version >> 8) & 0xff;
+		unsigned int minor = version & 0xff;
+
+		// Shader Model 5 adds four texture/sampler fields to each variable, 5.1 adds space and id to each binding
+		unsigned int variableStride = (major >= 5) ? 40 : 24;
+		unsigned int bindStride = (major > 5 || (major == 5 && minor >= 1)) ? 40 : 32;
+
+		for (unsigned int c = 0; c < cbCount; c++) {
+			size_t cb = rdef + cbOffset + c * 24;
+			ConstantBufferReflection buffer;
+			buffer.name = readString(read32(cb + 0));
+			unsigned int variableCount = read32(cb + 4);
+			unsigned int variableOffset = read32(cb + 8);
+			buffer.size = read32(cb + 12);
+			buffer.bindPoint = 0;
+
+			for (unsigned int v = 0; v < variableCount; v++) {
+				size_t var = rdef + variableOffset + v * variableStride;
+				ConstantBufferVariable variable;
+				variable.name = readString(read32(var + 0));
+				variable.offset = read32(var + 4);
+				variable.size = read32(var + 8);
+				buffer.variables.push_back(variable);
+			}
+
+			// Find the register the buffer is bound to (type 0 is D3D_SIT_CBUFFER)
+			for (unsigned int b = 0; b < bindCount; b++) {
+				size_t bind = rdef + bindOffset + b * bindStride;
+				if (read32(bind + 4) == 0 && readString(read32(bind + 0)) == buffer.name) {
+					buffer.bindPoint = read32(bind + 20);
+					break;
+				}
+			}
+			reflection.constantBuffers.push_back(buffer);
+		}
+		found = true;
+	}
+	return found;
+}
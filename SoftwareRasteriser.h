@@ -0,0 +1,750 @@
+#pragma once
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "MyMath.h"
+#include "ThreadPool.h"
+#include "VectorStream.h"
+
+enum RasterMode {
+	RASTER_SCALAR,      // Float edges, one pixel at a time over the bounding box
+	RASTER_SIMD,        // Float edges, 8x8 blocks with trivial reject/accept, LANE_WIDTH pixels per edge test
+	RASTER_FIXED,       // Integer edges with the top-left fill rule, one pixel at a time
+	RASTER_FIXED_SIMD   // Integer edges with the top-left fill rule, 8x8 blocks. Exact, but no faster than RASTER_SIMD
+};
+
+// Integer edge values for several pixels, only 32-bit adds and the sign bits are needed
+#if defined(MYMATH_SSE) && defined(__AVX2__)
+typedef __m256i EdgeLane;
+const size_t EDGE_LANE_WIDTH = 8;
+inline EdgeLane edgeSet(int32_t value) { return _mm256_set1_epi32(value); }
+inline EdgeLane edgeRamp(int32_t start, int32_t step) { return _mm256_add_epi32(_mm256_set1_epi32(start), _mm256_mullo_epi32(_mm256_set1_epi32(step), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))); }
+inline EdgeLane edgeAdd(EdgeLane a, EdgeLane b) { return _mm256_add_epi32(a, b); }
+// One bit per lane where all three edge values are >= 0
+inline unsigned int edgeInside(EdgeLane e0, EdgeLane e1, EdgeLane e2) {
+	return (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_or_si256(e0, e1), e2))) ^ 0xffu;
+}
+#elif defined(MYMATH_SSE)
+typedef __m128i EdgeLane;
+const size_t EDGE_LANE_WIDTH = 4;
+inline EdgeLane edgeSet(int32_t value) { return _mm_set1_epi32(value); }
+inline EdgeLane edgeRamp(int32_t start, int32_t step) { return _mm_setr_epi32(start, start + step, start + 2 * step, start + 3 * step); }
+inline EdgeLane edgeAdd(EdgeLane a, EdgeLane b) { return _mm_add_epi32(a, b); }
+inline unsigned int edgeInside(EdgeLane e0, EdgeLane e1, EdgeLane e2) {
+	return (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(_mm_or_si128(e0, e1), e2))) ^ 0xfu;
+}
+#else
+typedef int32_t EdgeLane;
+const size_t EDGE_LANE_WIDTH = 1;
+inline EdgeLane edgeSet(int32_t value) { return value; }
+inline EdgeLane edgeRamp(int32_t start, int32_t) { return start; }
+inline EdgeLane edgeAdd(EdgeLane a, EdgeLane b) { return a + b; }
+inline unsigned int edgeInside(EdgeLane e0, EdgeLane e1, EdgeLane e2) { return ((e0 | e1 | e2) >= 0) ? 1u : 0u; }
+#endif
+
+// Vertices snap to 1/16 pixel (28.4 fixed point), edge values then carry 8 fractional bits
+const int SUBPIXEL_BITS = 4;
+const int SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS;
+// Snapped coordinates stay within this many pixels of the origin so block edge values fit in 32 bits
+const float SUBPIXEL_LIMIT = 131072.f;
+// Slack on a triangle's depth bounds over a block before Hi-Z trusts them
+const float HIZ_EPSILON = 1e-5f;
+// How far past each side of the screen triangles can reach without being clipped, inside SUBPIXEL_LIMIT
+const float GUARD_BAND_PIXELS = 32768.f;
+
+// Which side of each clip space plane a vertex is on (D3D depth, visible is -w <= x, y <= w and 0 <= z <= w)
+enum ClipCode {
+	CLIP_LEFT = 1 << 0,      // x < -w
+	CLIP_RIGHT = 1 << 1,     // x > w
+	CLIP_BOTTOM = 1 << 2,    // y < -w
+	CLIP_TOP = 1 << 3,       // y > w
+	CLIP_NEAR = 1 << 4,      // z < 0
+	CLIP_FAR = 1 << 5,       // z > w
+	GUARD_LEFT = 1 << 6,     // x < -guard.x * w, and so on for the guard band
+	GUARD_RIGHT = 1 << 7,
+	GUARD_BOTTOM = 1 << 8,
+	GUARD_TOP = 1 << 9
+};
+// All vertices outside one of these and the triangle is invisible
+const unsigned int CLIP_FRUSTUM = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR;
+// Any vertex outside one of these and the triangle has to be clipped, the rest are left to the pixel bounds and depth test
+const unsigned int CLIP_NEEDED = CLIP_NEAR | GUARD_LEFT | GUARD_RIGHT | GUARD_BOTTOM | GUARD_TOP;
+
+struct RasterStats {
+	uint64_t trianglesIn;        // Submitted
+	uint64_t trianglesRejected;  // Every vertex outside the same frustum plane
+	uint64_t trianglesClipped;   // Crossed the near plane or the guard band, went through the clipper
+	uint64_t trianglesPassed;    // Went straight to setup, the guard band covers whatever is off screen
+	uint64_t trianglesCulled;    // Zero area or covering no pixel centres after setup
+	uint64_t tileBins;         // Triangle/tile pairs after binning
+	uint64_t pixelsCovered;    // Inside a triangle, outside any Hi-Z occluded block (so reaching the depth test)
+	uint64_t pixelsShaded;     // ...and passed the depth test
+	uint64_t blocksRejected;   // 8x8 blocks of a triangle's bounds entirely outside one of its edges
+	uint64_t blocksAccepted;   // ...entirely inside all three, no per-pixel edge test
+	uint64_t blocksPartial;
+	uint64_t blocksOccluded;   // Blocks (of the accepted and partial ones) behind everything already drawn there, by Hi-Z
+	uint64_t blocksDepthPassed;// ...in front of everything already drawn there, so no per-pixel depth loads
+	double binMs;
+	double rasterMs;
+};
+
+/*
+ *	CPU reference renderer. Draws transform their vertices to clip space and classify them against
+ *	the frustum: triangles wholly outside one plane are rejected, ones crossing the near plane or
+ *	leaving the guard band are clipped (Sutherland-Hodgman, only against the planes they cross)
+ *	and everything else goes straight to setup. Each triangle is set up in screen space and binned
+ *	into every tile its bounds touch. endFrame() then clears and
+ *	rasterises the tiles in parallel - tiles never share pixels, so no locking, and each tile
+ *	walks its bin in submission order so the image is the same on any number of threads.
+ *	Triangles are stepped incrementally across the tile with the edgeFunction coefficients,
+ *	depth tested (less) and shaded with perspective correct vertex colours.
+ *	mode picks between the plain per-pixel loop and the 8x8 block SIMD one. The block modes also
+ *	keep a Hi-Z depth range per block and skip blocks a triangle is wholly behind.
+ */
+// LANE_WIDTH pixels' worth of one float, with the operators MyMath's interpolation templates use
+struct PixelLanes {
+	StreamLane v;
+
+	PixelLanes operator+(const PixelLanes& other) const { return { laneAdd(v, other.v) }; }
+	PixelLanes operator*(const PixelLanes& other) const { return { laneMul(v, other.v) }; }
+	PixelLanes operator/(const PixelLanes& other) const { return { laneDiv(v, other.v) }; }
+};
+
+struct ColourLanes {
+	PixelLanes r, g, b, a;
+
+	static ColourLanes broadcast(const Colour& colour) {
+		return { { laneSet(colour.r) }, { laneSet(colour.g) }, { laneSet(colour.b) }, { laneSet(colour.a) } };
+	}
+
+	ColourLanes operator+(const ColourLanes& other) const { return { r + other.r, g + other.g, b + other.b, a + other.a }; }
+	ColourLanes operator*(const PixelLanes& scalar) const { return { r * scalar, g * scalar, b * scalar, a * scalar }; }
+	ColourLanes operator/(const PixelLanes& scalar) const { return { r / scalar, g / scalar, b / scalar, a / scalar }; }
+};
+
+class SoftwareRasteriser {
+public:
+	// A triangle after the perspective divide, ready for any tile to rasterise
+	struct SetupTriangle {
+		Vec4 v[3];          // Screen x, y (snapped to the subpixel grid), z/w and 1/w
+		Colour colour[3];
+		float invArea;      // 1 / edgeFunction(v0, v1, v2), winding is flipped so area is positive
+		int minX, minY, maxX, maxY;  // Pixels whose centres the bounds contain, clamped to the screen
+
+		// Integer edge k at the pixel centre (X, Y) in 28.4 is a * X + b * Y + c, in the same order
+		// as the float edges (v1 v2, v2 v0, v0 v1). c includes the fill rule bias.
+		int32_t a[3], b[3];
+		int64_t c[3];
+	};
+
+	struct Tile {
+		int x0, y0, x1, y1;  // Pixel rectangle, x1/y1 exclusive
+		std::vector<unsigned int> bin;
+		uint64_t pixelsCovered;
+		uint64_t pixelsShaded;
+		uint64_t blocksRejected;
+		uint64_t blocksAccepted;
+		uint64_t blocksPartial;
+		uint64_t blocksOccluded;
+		uint64_t blocksDepthPassed;
+	};
+
+	static const int BLOCK_SIZE = 8;
+
+	int width = 0;
+	int height = 0;
+	int tileSize = 64;
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<uint32_t> colourBuffer;  // RGBA8, row-major
+	std::vector<float> depthBuffer;
+	// Hi-Z: nearest and farthest depth in each BLOCK_SIZE square, refreshed whenever a block draws a pixel
+	int blocksX = 0;
+	int blocksY = 0;
+	std::vector<float> hizMin;
+	std::vector<float> hizMax;
+	bool hierarchicalZ = true;  // Block modes only
+	Colour clearColour;
+	float clearDepth = 1.f;
+
+	std::vector<Tile> tiles;
+	std::vector<SetupTriangle> triangles;
+	std::vector<Vec4> clipPositions;  // Scratch for transformed vertices
+	std::vector<uint16_t> clipCodes;  // ...and their ClipCodes
+	float guardX = 1.f, guardY = 1.f; // Guard band edges in NDC
+	ThreadPool* pool = NULL;
+	RasterMode mode = RASTER_SIMD;
+	RasterStats stats = {};
+
+	void initialize(int _width, int _height, ThreadPool* _pool, int _tileSize = 64) {
+		width = _width;
+		height = _height;
+		pool = _pool;
+		// Tiles own whole blocks, so Hi-Z never needs locking
+		tileSize = (_tileSize + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+		tilesX = (width + tileSize - 1) / tileSize;
+		tilesY = (height + tileSize - 1) / tileSize;
+		guardX = 1.f + 2.f * GUARD_BAND_PIXELS / width;
+		guardY = 1.f + 2.f * GUARD_BAND_PIXELS / height;
+		colourBuffer.assign((size_t)width * height, 0);
+		// Block rows always load whole lanes, so the last row may read a little past the end
+		depthBuffer.assign((size_t)width * height + BLOCK_SIZE, 1.f);
+		blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		hizMin.assign((size_t)blocksX * blocksY, 1.f);
+		hizMax.assign((size_t)blocksX * blocksY, 1.f);
+
+		tiles.resize((size_t)tilesX * tilesY);
+		for (int ty = 0; ty < tilesY; ty++) {
+			for (int tx = 0; tx < tilesX; tx++) {
+				Tile& tile = tiles[ty * tilesX + tx];
+				tile.x0 = tx * tileSize;
+				tile.y0 = ty * tileSize;
+				tile.x1 = std::min<int>(tile.x0 + tileSize, width);
+				tile.y1 = std::min<int>(tile.y0 + tileSize, height);
+			}
+		}
+	}
+
+	void beginFrame() {
+		triangles.clear();
+		for (Tile& tile : tiles) tile.bin.clear();
+		stats = {};
+	}
+
+	// Indexed triangle list, positions are transformed by transform (projection * view * world)
+	void drawIndexed(const Matrix& transform, const Vec3* positions, const Colour* colours, unsigned int vertexCount,
+					 const unsigned int* indices, unsigned int indexCount) {
+		auto start = std::chrono::high_resolution_clock::now();
+		clipPositions.resize(vertexCount);
+		transformPoints(transform, positions, &clipPositions[0], vertexCount);
+		clipCodes.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++) clipCodes[i] = clipCode(clipPositions[i]);
+		for (unsigned int i = 0; i + 2 < indexCount; i += 3) {
+			unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			stats.trianglesIn++;
+			unsigned int outside = clipCodes[a] & clipCodes[b] & clipCodes[c];
+			unsigned int crossing = clipCodes[a] | clipCodes[b] | clipCodes[c];
+			if (outside & CLIP_FRUSTUM) {
+				stats.trianglesRejected++;
+			} else if (crossing & CLIP_NEEDED) {
+				stats.trianglesClipped++;
+				clipTriangle(clipPositions[a], clipPositions[b], clipPositions[c], colours[a], colours[b], colours[c], crossing & CLIP_NEEDED);
+			} else {
+				stats.trianglesPassed++;
+				addTriangle(clipPositions[a], clipPositions[b], clipPositions[c], colours[a], colours[b], colours[c]);
+			}
+		}
+		stats.binMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Clear and rasterise every tile, the image is complete when this returns
+	void endFrame() {
+		auto start = std::chrono::high_resolution_clock::now();
+		pool->run((unsigned int)tiles.size(), [this](unsigned int index, unsigned int) { rasteriseTile(tiles[index]); });
+		for (Tile& tile : tiles) {
+			stats.tileBins += tile.bin.size();
+			stats.pixelsCovered += tile.pixelsCovered;
+			stats.pixelsShaded += tile.pixelsShaded;
+			stats.blocksRejected += tile.blocksRejected;
+			stats.blocksAccepted += tile.blocksAccepted;
+			stats.blocksPartial += tile.blocksPartial;
+			stats.blocksOccluded += tile.blocksOccluded;
+			stats.blocksDepthPassed += tile.blocksDepthPassed;
+		}
+		stats.rasterMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	static uint32_t pack(const Colour& colour) {
+		auto channel = [](float c) { return (uint32_t)(std::min<float>(std::max<float>(c, 0.f), 1.f) * 255.f + 0.5f); };
+		return channel(colour.r) | (channel(colour.g) << 8) | (channel(colour.b) << 16) | (channel(colour.a) << 24);
+	}
+
+private:
+	unsigned int clipCode(const Vec4& p) const {
+		unsigned int code = 0;
+		if (p.x < -p.w) code |= CLIP_LEFT;
+		if (p.x > p.w) code |= CLIP_RIGHT;
+		if (p.y < -p.w) code |= CLIP_BOTTOM;
+		if (p.y > p.w) code |= CLIP_TOP;
+		if (p.z < 0.f) code |= CLIP_NEAR;
+		if (p.z > p.w) code |= CLIP_FAR;
+		if (p.x < -guardX * p.w) code |= GUARD_LEFT;
+		if (p.x > guardX * p.w) code |= GUARD_RIGHT;
+		if (p.y < -guardY * p.w) code |= GUARD_BOTTOM;
+		if (p.y > guardY * p.w) code |= GUARD_TOP;
+		return code;
+	}
+
+	/*
+	 *	Sutherland-Hodgman against just the planes in planes (ClipCodes), in clip space where
+	 *	colours still interpolate linearly. The polygon left over is fanned into addTriangle.
+	 */
+	void clipTriangle(const Vec4& p0, const Vec4& p1, const Vec4& p2, const Colour& c0, const Colour& c1, const Colour& c2, unsigned int planes) {
+		const int MAX_VERTICES = 3 + 5;  // Each plane adds at most one vertex
+		Vec4 positions[2][MAX_VERTICES];
+		Colour colours[2][MAX_VERTICES];
+		positions[0][0] = p0; positions[0][1] = p1; positions[0][2] = p2;
+		colours[0][0] = c0; colours[0][1] = c1; colours[0][2] = c2;
+		int count = 3, current = 0;
+
+		// Signed distance to each plane, inside is >= 0
+		const Vec4 planeVectors[5] = { Vec4(0.f, 0.f, 1.f, 0.f), Vec4(1.f, 0.f, 0.f, guardX), Vec4(-1.f, 0.f, 0.f, guardX),
+									   Vec4(0.f, 1.f, 0.f, guardY), Vec4(0.f, -1.f, 0.f, guardY) };
+		const unsigned int planeCodes[5] = { CLIP_NEAR, GUARD_LEFT, GUARD_RIGHT, GUARD_BOTTOM, GUARD_TOP };
+		for (int plane = 0; plane < 5; plane++) {
+			if (!(planes & planeCodes[plane])) continue;
+			const Vec4* in = positions[current];
+			const Colour* inColours = colours[current];
+			Vec4* out = positions[current ^ 1];
+			Colour* outColours = colours[current ^ 1];
+			int outCount = 0;
+			for (int i = 0; i < count; i++) {
+				int j = (i + 1 == count) ? 0 : i + 1;
+				float di = in[i].Dot(planeVectors[plane]), dj = in[j].Dot(planeVectors[plane]);
+				if (di >= 0.f) {
+					out[outCount] = in[i];
+					outColours[outCount++] = inColours[i];
+				}
+				if ((di >= 0.f) != (dj >= 0.f)) {
+					// Always step from the inside vertex, so both triangles sharing this edge get the same point
+					int a = (di >= 0.f) ? i : j, b = (di >= 0.f) ? j : i;
+					float da = (di >= 0.f) ? di : dj, db = (di >= 0.f) ? dj : di;
+					float t = da / (da - db);
+					out[outCount] = lerp(in[a], in[b], t);
+					outColours[outCount++] = lerp(inColours[a], inColours[b], t);
+				}
+			}
+			count = outCount;
+			current ^= 1;
+			if (count < 3) return;
+		}
+
+		for (int i = 1; i + 1 < count; i++)
+			addTriangle(positions[current][0], positions[current][i], positions[current][i + 1], colours[current][0], colours[current][i], colours[current][i + 1]);
+	}
+
+	void addTriangle(const Vec4& p0, const Vec4& p1, const Vec4& p2, const Colour& c0, const Colour& c1, const Colour& c2) {
+		// Only reachable with a projection that doesn't keep w positive in front of the near plane
+		if (p0.w <= 0.f || p1.w <= 0.f || p2.w <= 0.f) {
+			stats.trianglesCulled++;
+			return;
+		}
+
+		SetupTriangle tri;
+		Vec4 clip[3] = { p0, p1, p2 };
+		int32_t X[3], Y[3];
+		for (int k = 0; k < 3; k++) {
+			Vec4 ndc = clip[k].divideByW();
+			float x = (ndc.x + 1.f) * 0.5f * width, y = (1.f - ndc.y) * 0.5f * height;
+			// The guard band keeps vertices well inside the limit, this only catches NaNs and infinities
+			if (!(fabsf(x) < SUBPIXEL_LIMIT && fabsf(y) < SUBPIXEL_LIMIT)) {
+				stats.trianglesCulled++;
+				return;
+			}
+			// Snap, and rasterise the snapped position in every mode so they all agree on the shape
+			X[k] = (int32_t)floorf(x * SUBPIXEL_STEPS + 0.5f);
+			Y[k] = (int32_t)floorf(y * SUBPIXEL_STEPS + 0.5f);
+			tri.v[k] = Vec4((float)X[k] / SUBPIXEL_STEPS, (float)Y[k] / SUBPIXEL_STEPS, ndc.z, ndc.w);
+		}
+		tri.colour[0] = c0; tri.colour[1] = c1; tri.colour[2] = c2;
+
+		// Exact area from the snapped vertices
+		int64_t area = (int64_t)(X[2] - X[0]) * (Y[1] - Y[0]) - (int64_t)(X[1] - X[0]) * (Y[2] - Y[0]);
+		if (area == 0) {
+			stats.trianglesCulled++;
+			return;
+		}
+		if (area < 0) {
+			// Two-sided, flip to the winding the inside test expects
+			std::swap(tri.v[1], tri.v[2]);
+			std::swap(tri.colour[1], tri.colour[2]);
+			std::swap(X[1], X[2]);
+			std::swap(Y[1], Y[2]);
+			area = -area;
+		}
+		tri.invArea = (float)(SUBPIXEL_STEPS * SUBPIXEL_STEPS) / (float)area;
+
+		const int from[3] = { 1, 2, 0 };
+		const int to[3] = { 2, 0, 1 };
+		for (int k = 0; k < 3; k++) {
+			tri.a[k] = Y[to[k]] - Y[from[k]];
+			tri.b[k] = -(X[to[k]] - X[from[k]]);
+			tri.c[k] = -((int64_t)tri.a[k] * X[from[k]] + (int64_t)tri.b[k] * Y[from[k]]);
+			// Top-left rule: pixel centres exactly on an edge belong to the triangle only if the edge
+			// is a left edge (going down the screen) or a flat top edge (going left), so a shared
+			// edge is drawn by exactly one of its two triangles
+			bool topLeft = tri.a[k] > 0 || (tri.a[k] == 0 && tri.b[k] > 0);
+			if (!topLeft) tri.c[k] -= 1;
+		}
+
+		// Pixels whose centres (16 * x + 8) lie inside the snapped bounds
+		auto firstCentre = [](int32_t minimum) { return (int)floorf((minimum - SUBPIXEL_STEPS / 2 + SUBPIXEL_STEPS - 1) / (float)SUBPIXEL_STEPS); };
+		auto lastCentre = [](int32_t maximum) { return (int)floorf((maximum - SUBPIXEL_STEPS / 2) / (float)SUBPIXEL_STEPS); };
+		tri.minX = std::max<int>(firstCentre(std::min<int32_t>(X[0], std::min<int32_t>(X[1], X[2]))), 0);
+		tri.minY = std::max<int>(firstCentre(std::min<int32_t>(Y[0], std::min<int32_t>(Y[1], Y[2]))), 0);
+		tri.maxX = std::min<int>(lastCentre(std::max<int32_t>(X[0], std::max<int32_t>(X[1], X[2]))), width - 1);
+		tri.maxY = std::min<int>(lastCentre(std::max<int32_t>(Y[0], std::max<int32_t>(Y[1], Y[2]))), height - 1);
+		if (tri.maxX < tri.minX || tri.maxY < tri.minY) {
+			stats.trianglesCulled++;
+			return;
+		}
+
+		unsigned int index = (unsigned int)triangles.size();
+		triangles.push_back(tri);
+		for (int ty = tri.minY / tileSize; ty <= tri.maxY / tileSize; ty++)
+			for (int tx = tri.minX / tileSize; tx <= tri.maxX / tileSize; tx++)
+				tiles[ty * tilesX + tx].bin.push_back(index);
+	}
+
+	void rasteriseTile(Tile& tile) {
+		uint32_t clear = pack(clearColour);
+		for (int y = tile.y0; y < tile.y1; y++) {
+			std::fill(&colourBuffer[(size_t)y * width + tile.x0], &colourBuffer[(size_t)y * width + tile.x1], clear);
+			std::fill(&depthBuffer[(size_t)y * width + tile.x0], &depthBuffer[(size_t)y * width + tile.x1], clearDepth);
+		}
+		tile.pixelsCovered = 0;
+		tile.pixelsShaded = 0;
+		tile.blocksRejected = 0;
+		tile.blocksAccepted = 0;
+		tile.blocksPartial = 0;
+		tile.blocksOccluded = 0;
+		tile.blocksDepthPassed = 0;
+		for (int by = tile.y0 / BLOCK_SIZE; by * BLOCK_SIZE < tile.y1; by++) {
+			std::fill(&hizMin[(size_t)by * blocksX + tile.x0 / BLOCK_SIZE], &hizMin[(size_t)by * blocksX + (tile.x1 + BLOCK_SIZE - 1) / BLOCK_SIZE], clearDepth);
+			std::fill(&hizMax[(size_t)by * blocksX + tile.x0 / BLOCK_SIZE], &hizMax[(size_t)by * blocksX + (tile.x1 + BLOCK_SIZE - 1) / BLOCK_SIZE], clearDepth);
+		}
+		switch (mode) {
+		case RASTER_SCALAR:
+			for (unsigned int index : tile.bin) rasteriseTriangle(tile, triangles[index]);
+			break;
+		case RASTER_SIMD:
+			for (unsigned int index : tile.bin) rasteriseTriangleBlocks<false>(tile, triangles[index]);
+			break;
+		case RASTER_FIXED:
+			for (unsigned int index : tile.bin) rasteriseTriangleFixed(tile, triangles[index]);
+			break;
+		case RASTER_FIXED_SIMD:
+			for (unsigned int index : tile.bin) rasteriseTriangleBlocks<true>(tile, triangles[index]);
+			break;
+		}
+	}
+
+	void rasteriseTriangle(Tile& tile, const SetupTriangle& tri) {
+		int x0 = std::max<int>(tri.minX, tile.x0), x1 = std::min<int>(tri.maxX + 1, tile.x1);
+		int y0 = std::max<int>(tri.minY, tile.y0), y1 = std::min<int>(tri.maxY + 1, tile.y1);
+		if (x0 >= x1 || y0 >= y1) return;
+
+		const Vec4& v0 = tri.v[0];
+		const Vec4& v1 = tri.v[1];
+		const Vec4& v2 = tri.v[2];
+
+		// edgeFunction(a, b, p) is linear in p, so step it instead of re-evaluating it per pixel
+		float dx0 = v2.y - v1.y, dy0 = -(v2.x - v1.x);
+		float dx1 = v0.y - v2.y, dy1 = -(v0.x - v2.x);
+		float dx2 = v1.y - v0.y, dy2 = -(v1.x - v0.x);
+		Vec4 p((float)x0 + 0.5f, (float)y0 + 0.5f);
+		float row0 = edgeFunction(v1, v2, p);
+		float row1 = edgeFunction(v2, v0, p);
+		float row2 = edgeFunction(v0, v1, p);
+
+		for (int y = y0; y < y1; y++) {
+			float e0 = row0, e1 = row1, e2 = row2;
+			float* depth = &depthBuffer[(size_t)y * width];
+			uint32_t* colour = &colourBuffer[(size_t)y * width];
+			for (int x = x0; x < x1; x++) {
+				if (e0 >= 0.f && e1 >= 0.f && e2 >= 0.f) {
+					tile.pixelsCovered++;
+					float alpha = e0 * tri.invArea, beta = e1 * tri.invArea, gamma = e2 * tri.invArea;
+					float z = alpha * v0.z + beta * v1.z + gamma * v2.z;
+					if (z < depth[x]) {
+						depth[x] = z;
+						float fragW = alpha * v0.w + beta * v1.w + gamma * v2.w;
+						colour[x] = pack(perspectiveCorrectInterpolateAttribute(tri.colour[0], tri.colour[1], tri.colour[2],
+																				 v0.w, v1.w, v2.w, alpha, beta, gamma, fragW));
+						tile.pixelsShaded++;
+					}
+				}
+				e0 += dx0; e1 += dx1; e2 += dx2;
+			}
+			row0 += dy0; row1 += dy1; row2 += dy2;
+		}
+	}
+
+	// rasteriseTriangle with the coverage test on exact integer edges, the float edges are still
+	// stepped alongside for interpolation so this matches the block walk pixel for pixel
+	void rasteriseTriangleFixed(Tile& tile, const SetupTriangle& tri) {
+		int x0 = std::max<int>(tri.minX, tile.x0), x1 = std::min<int>(tri.maxX + 1, tile.x1);
+		int y0 = std::max<int>(tri.minY, tile.y0), y1 = std::min<int>(tri.maxY + 1, tile.y1);
+		if (x0 >= x1 || y0 >= y1) return;
+
+		const Vec4& v0 = tri.v[0];
+		const Vec4& v1 = tri.v[1];
+		const Vec4& v2 = tri.v[2];
+
+		int64_t X = (int64_t)x0 * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2, Y = (int64_t)y0 * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+		int64_t row0 = tri.a[0] * X + tri.b[0] * Y + tri.c[0];
+		int64_t row1 = tri.a[1] * X + tri.b[1] * Y + tri.c[1];
+		int64_t row2 = tri.a[2] * X + tri.b[2] * Y + tri.c[2];
+		int64_t dx0 = (int64_t)tri.a[0] * SUBPIXEL_STEPS, dx1 = (int64_t)tri.a[1] * SUBPIXEL_STEPS, dx2 = (int64_t)tri.a[2] * SUBPIXEL_STEPS;
+		int64_t dy0 = (int64_t)tri.b[0] * SUBPIXEL_STEPS, dy1 = (int64_t)tri.b[1] * SUBPIXEL_STEPS, dy2 = (int64_t)tri.b[2] * SUBPIXEL_STEPS;
+
+		float fdx0 = v2.y - v1.y, fdy0 = -(v2.x - v1.x);
+		float fdx1 = v0.y - v2.y, fdy1 = -(v0.x - v2.x);
+		float fdx2 = v1.y - v0.y, fdy2 = -(v1.x - v0.x);
+		Vec4 p((float)x0 + 0.5f, (float)y0 + 0.5f);
+		float frow0 = edgeFunction(v1, v2, p);
+		float frow1 = edgeFunction(v2, v0, p);
+		float frow2 = edgeFunction(v0, v1, p);
+
+		for (int y = y0; y < y1; y++) {
+			int64_t e0 = row0, e1 = row1, e2 = row2;
+			float f0 = frow0, f1 = frow1, f2 = frow2;
+			float* depth = &depthBuffer[(size_t)y * width];
+			uint32_t* colour = &colourBuffer[(size_t)y * width];
+			for (int x = x0; x < x1; x++) {
+				// All three are non-negative when none of their sign bits are set
+				if ((e0 | e1 | e2) >= 0) {
+					tile.pixelsCovered++;
+					float alpha = f0 * tri.invArea, beta = f1 * tri.invArea, gamma = f2 * tri.invArea;
+					float z = alpha * v0.z + beta * v1.z + gamma * v2.z;
+					if (z < depth[x]) {
+						depth[x] = z;
+						float fragW = alpha * v0.w + beta * v1.w + gamma * v2.w;
+						colour[x] = pack(perspectiveCorrectInterpolateAttribute(tri.colour[0], tri.colour[1], tri.colour[2],
+																				 v0.w, v1.w, v2.w, alpha, beta, gamma, fragW));
+						tile.pixelsShaded++;
+					}
+				}
+				e0 += dx0; e1 += dx1; e2 += dx2;
+				f0 += fdx0; f1 += fdx1; f2 += fdx2;
+			}
+			row0 += dy0; row1 += dy1; row2 += dy2;
+			frow0 += fdy0; frow1 += fdy1; frow2 += fdy2;
+		}
+	}
+
+	/*
+	 *	Walks the triangle in 8x8 blocks. The edge values at a block's corner pixels bound them
+	 *	over the whole block, so a block outside any edge is skipped and a block inside all three
+	 *	skips the edge tests. Otherwise each row is tested LANE_WIDTH pixels at a time into a
+	 *	coverage mask and depth tested the same way. Barycentrics stay in lanes all the way through
+	 *	perspectiveCorrectInterpolateAttribute, only the final depth and colour writes are per pixel.
+	 *	Before any of that the triangle's depth range over the block is checked against Hi-Z:
+	 *	behind the farthest pixel there and the block is skipped, in front of the nearest and the
+	 *	per-pixel depth test is.
+	 *	FIXED does the reject/accept and coverage tests on the integer edges. Inside a block that
+	 *	straddles an edge the edge values fit in 32 bits, so they run EDGE_LANE_WIDTH at a time.
+	 */
+	template<bool FIXED>
+	void rasteriseTriangleBlocks(Tile& tile, const SetupTriangle& tri) {
+		int x0 = std::max<int>(tri.minX, tile.x0), x1 = std::min<int>(tri.maxX + 1, tile.x1);
+		int y0 = std::max<int>(tri.minY, tile.y0), y1 = std::min<int>(tri.maxY + 1, tile.y1);
+		if (x0 >= x1 || y0 >= y1) return;
+
+		const Vec4& v0 = tri.v[0];
+		const Vec4& v1 = tri.v[1];
+		const Vec4& v2 = tri.v[2];
+		const Vec4* from[3] = { &v1, &v2, &v0 };
+		const Vec4* to[3] = { &v2, &v0, &v1 };
+		float dx[3], dy[3], spanMin[3], spanMax[3];
+		for (int k = 0; k < 3; k++) {
+			dx[k] = to[k]->y - from[k]->y;
+			dy[k] = -(to[k]->x - from[k]->x);
+			// How far the edge value moves from a block's first pixel to its other corners
+			float last = (float)(BLOCK_SIZE - 1);
+			spanMin[k] = std::min<float>(dx[k] * last, 0.f) + std::min<float>(dy[k] * last, 0.f);
+			spanMax[k] = std::max<float>(dx[k] * last, 0.f) + std::max<float>(dy[k] * last, 0.f);
+		}
+		int32_t stepX[3], stepY[3];
+		int64_t fixedSpanMin[3], fixedSpanMax[3];
+		EdgeLane rowSteps[3];
+		for (int k = 0; k < 3; k++) {
+			stepX[k] = tri.a[k] * SUBPIXEL_STEPS;
+			stepY[k] = tri.b[k] * SUBPIXEL_STEPS;
+			int64_t lastX = (int64_t)stepX[k] * (BLOCK_SIZE - 1), lastY = (int64_t)stepY[k] * (BLOCK_SIZE - 1);
+			fixedSpanMin[k] = std::min<int64_t>(lastX, 0) + std::min<int64_t>(lastY, 0);
+			fixedSpanMax[k] = std::max<int64_t>(lastX, 0) + std::max<int64_t>(lastY, 0);
+			rowSteps[k] = edgeSet(stepY[k]);
+		}
+		const int EDGE_LANES = BLOCK_SIZE / (int)EDGE_LANE_WIDTH;
+		EdgeLane edges[3][BLOCK_SIZE / EDGE_LANE_WIDTH];
+
+		const unsigned int laneBits = (1u << LANE_WIDTH) - 1;
+		const StreamLane zero = laneSet(0.f);
+		const StreamLane invArea = laneSet(tri.invArea);
+		const StreamLane z0 = laneSet(v0.z), z1 = laneSet(v1.z), z2 = laneSet(v2.z);
+		const StreamLane ramp[3] = { laneRamp(0.f, dx[0]), laneRamp(0.f, dx[1]), laneRamp(0.f, dx[2]) };
+		const PixelLanes w0 = { laneSet(v0.w) }, w1 = { laneSet(v1.w) }, w2 = { laneSet(v2.w) };
+		const ColourLanes c0 = ColourLanes::broadcast(tri.colour[0]);
+		const ColourLanes c1 = ColourLanes::broadcast(tri.colour[1]);
+		const ColourLanes c2 = ColourLanes::broadcast(tri.colour[2]);
+		const StreamLane one = laneSet(1.f), scale = laneSet(255.f), half = laneSet(0.5f);
+		float z[LANE_WIDTH], channels[4][LANE_WIDTH];
+
+		// Depth is a plane in screen space, bound it over a block the same way as the edges. The
+		// interpolated depth can round a little outside the plane, so the bounds get some slack.
+		float dzdx = (dx[0] * v0.z + dx[1] * v1.z + dx[2] * v2.z) * tri.invArea;
+		float dzdy = (dy[0] * v0.z + dy[1] * v1.z + dy[2] * v2.z) * tri.invArea;
+		float last = (float)(BLOCK_SIZE - 1);
+		float zSpanMin = std::min<float>(dzdx * last, 0.f) + std::min<float>(dzdy * last, 0.f);
+		float zSpanMax = std::max<float>(dzdx * last, 0.f) + std::max<float>(dzdy * last, 0.f);
+		float triangleZMin = std::min<float>(v0.z, std::min<float>(v1.z, v2.z));
+		float triangleZMax = std::max<float>(v0.z, std::max<float>(v1.z, v2.z));
+
+		for (int by = y0 & ~(BLOCK_SIZE - 1); by < y1; by += BLOCK_SIZE) {
+			// Integer edge values at the first block of the row, then one add per block
+			int bxStart = x0 & ~(BLOCK_SIZE - 1);
+			int64_t E[3];
+			if (FIXED) {
+				int64_t X = (int64_t)bxStart * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2, Y = (int64_t)by * SUBPIXEL_STEPS + SUBPIXEL_STEPS / 2;
+				for (int k = 0; k < 3; k++) E[k] = tri.a[k] * X + tri.b[k] * Y + tri.c[k] - (int64_t)stepX[k] * BLOCK_SIZE;
+			}
+			for (int bx = bxStart; bx < x1; bx += BLOCK_SIZE) {
+				Vec4 p((float)bx + 0.5f, (float)by + 0.5f);
+				float e[3];
+				bool accept = true, reject = false;
+				for (int k = 0; k < 3; k++) {
+					e[k] = edgeFunction(*from[k], *to[k], p);
+					if (FIXED) {
+						E[k] += (int64_t)stepX[k] * BLOCK_SIZE;
+						if (E[k] + fixedSpanMax[k] < 0) reject = true;
+						if (E[k] + fixedSpanMin[k] < 0) accept = false;
+					} else {
+						if (e[k] + spanMax[k] < 0.f) reject = true;
+						if (e[k] + spanMin[k] < 0.f) accept = false;
+					}
+				}
+				if (reject) {
+					tile.blocksRejected++;
+					continue;
+				}
+				if (accept) tile.blocksAccepted++;
+				else tile.blocksPartial++;
+
+				size_t block = (size_t)(by / BLOCK_SIZE) * blocksX + bx / BLOCK_SIZE;
+				bool depthPass = false;
+				if (hierarchicalZ) {
+					float zOrigin = (e[0] * v0.z + e[1] * v1.z + e[2] * v2.z) * tri.invArea;
+					float zMin = std::max<float>(zOrigin + zSpanMin, triangleZMin) - HIZ_EPSILON;
+					float zMax = std::min<float>(zOrigin + zSpanMax, triangleZMax) + HIZ_EPSILON;
+					if (zMin >= hizMax[block]) {
+						tile.blocksOccluded++;
+						continue;
+					}
+					depthPass = zMax < hizMin[block];
+					if (depthPass) tile.blocksDepthPassed++;
+				}
+				bool wrote = false;
+
+				// Columns of this block inside the triangle's bounds
+				int colStart = std::max<int>(bx, x0) - bx, colEnd = std::min<int>(bx + BLOCK_SIZE, x1) - bx;
+				unsigned int columns = ((1u << colEnd) - 1) & ~((1u << colStart) - 1);
+				int rowStart = std::max<int>(by, y0), rowEnd = std::min<int>(by + BLOCK_SIZE, y1);
+
+				// A block straddling an edge has 32-bit edge values, set them up at its first row and step them down
+				if (FIXED && !accept) {
+					for (int k = 0; k < 3; k++) {
+						int32_t start = (int32_t)(E[k] + (int64_t)stepY[k] * (rowStart - by));
+						for (int h = 0; h < EDGE_LANES; h++) edges[k][h] = edgeRamp(start + stepX[k] * h * (int)EDGE_LANE_WIDTH, stepX[k]);
+					}
+				}
+
+				for (int y = rowStart; y < rowEnd; y++) {
+					int row = y - by;
+					float r = (float)row;
+					float rowE[3] = { e[0] + dy[0] * r, e[1] + dy[1] * r, e[2] + dy[2] * r };
+					float* depth = &depthBuffer[(size_t)y * width + bx];
+					uint32_t* colour = &colourBuffer[(size_t)y * width + bx];
+					// Integer coverage for the whole row of the block up front
+					unsigned int rowMask = columns;
+					if (FIXED && !accept) {
+						unsigned int inside = 0;
+						for (int h = 0; h < EDGE_LANES; h++) {
+							inside |= edgeInside(edges[0][h], edges[1][h], edges[2][h]) << (h * (int)EDGE_LANE_WIDTH);
+							for (int k = 0; k < 3; k++) edges[k][h] = edgeAdd(edges[k][h], rowSteps[k]);
+						}
+						rowMask &= inside;
+						if (rowMask == 0) continue;
+					}
+					for (int g = 0; g < BLOCK_SIZE; g += (int)LANE_WIDTH) {
+						unsigned int mask = (rowMask >> g) & laneBits;
+						if (mask == 0) continue;
+						StreamLane l0 = laneAdd(laneSet(rowE[0] + dx[0] * g), ramp[0]);
+						StreamLane l1 = laneAdd(laneSet(rowE[1] + dx[1] * g), ramp[1]);
+						StreamLane l2 = laneAdd(laneSet(rowE[2] + dx[2] * g), ramp[2]);
+						if (!FIXED && !accept) {
+							mask &= laneGreaterEqualMask(l0, zero) & laneGreaterEqualMask(l1, zero) & laneGreaterEqualMask(l2, zero);
+							if (mask == 0) continue;
+						}
+						tile.pixelsCovered += std::bitset<32>(mask).count();
+
+						PixelLanes alpha = { laneMul(l0, invArea) }, beta = { laneMul(l1, invArea) }, gamma = { laneMul(l2, invArea) };
+						StreamLane depthLane = laneAdd(laneAdd(laneMul(alpha.v, z0), laneMul(beta.v, z1)), laneMul(gamma.v, z2));
+						if (!depthPass) {
+							mask &= laneLessMask(depthLane, laneLoadUnaligned(&depth[g]));
+							if (mask == 0) continue;
+						}
+						wrote = true;
+
+						PixelLanes fragW = alpha * w0 + beta * w1 + gamma * w2;
+						ColourLanes shaded = perspectiveCorrectInterpolateAttribute(c0, c1, c2, w0, w1, w2, alpha, beta, gamma, fragW);
+						// Same rounding as pack(), done for every lane at once
+						const PixelLanes* channel[4] = { &shaded.r, &shaded.g, &shaded.b, &shaded.a };
+						for (int k = 0; k < 4; k++)
+							laneStoreUnaligned(channels[k], laneAdd(laneMul(laneMin(laneMax(channel[k]->v, zero), one), scale), half));
+						laneStoreUnaligned(z, depthLane);
+						for (unsigned int i = 0; i < LANE_WIDTH; i++) {
+							if (!(mask & (1u << i))) continue;
+							depth[g + i] = z[i];
+							colour[g + i] = (uint32_t)channels[0][i] | ((uint32_t)channels[1][i] << 8) | ((uint32_t)channels[2][i] << 16) | ((uint32_t)channels[3][i] << 24);
+							tile.pixelsShaded++;
+						}
+					}
+				}
+				if (hierarchicalZ && wrote) refreshHierarchicalZ(bx, by, block);
+			}
+		}
+	}
+
+	// Recompute one block's Hi-Z bounds from the depth buffer after something was drawn into it
+	void refreshHierarchicalZ(int bx, int by, size_t block) {
+		int rows = std::min<int>((int)BLOCK_SIZE, height - by);
+		if (bx + BLOCK_SIZE <= width) {
+			StreamLane lo = laneLoadUnaligned(&depthBuffer[(size_t)by * width + bx]), hi = lo;
+			for (int y = 0; y < rows; y++) {
+				const float* depth = &depthBuffer[(size_t)(by + y) * width + bx];
+				for (int g = 0; g < BLOCK_SIZE; g += (int)LANE_WIDTH) {
+					StreamLane d = laneLoadUnaligned(&depth[g]);
+					lo = laneMin(lo, d);
+					hi = laneMax(hi, d);
+				}
+			}
+			float los[LANE_WIDTH], his[LANE_WIDTH];
+			laneStoreUnaligned(los, lo);
+			laneStoreUnaligned(his, hi);
+			float zMin = los[0], zMax = his[0];
+			for (unsigned int i = 1; i < LANE_WIDTH; i++) {
+				zMin = std::min<float>(zMin, los[i]);
+				zMax = std::max<float>(zMax, his[i]);
+			}
+			hizMin[block] = zMin;
+			hizMax[block] = zMax;
+			return;
+		}
+		// Block hanging off the right of the screen
+		float zMin = depthBuffer[(size_t)by * width + bx], zMax = zMin;
+		for (int y = 0; y < rows; y++) {
+			for (int x = bx; x < width; x++) {
+				float d = depthBuffer[(size_t)(by + y) * width + x];
+				zMin = std::min<float>(zMin, d);
+				zMax = std::max<float>(zMax, d);
+			}
+		}
+		hizMin[block] = zMin;
+		hizMax[block] = zMax;
+	}
+};
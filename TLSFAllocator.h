@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline unsigned int highestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline unsigned int lowestBit(uint64_t value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+struct TLSFStats {
+	uint64_t size;
+	uint64_t usedBytes;
+	uint64_t freeBytes;
+	uint64_t largestFreeBlock;
+	uint64_t allocations;   // Live allocations
+	uint64_t freeBlocks;
+
+	// 0 when all free space is one block, towards 1 as it splinters
+	float fragmentation() const { return freeBytes ? 1.0f - (float)largestFreeBlock / (float)freeBytes : 0.0f; }
+};
+
+// An offset in the managed range and the block to hand back to free()
+struct TLSFAllocation {
+	uint64_t offset;
+	uint64_t size;
+	unsigned int block;
+};
+
+/*
+ *	Two-Level Segregated Fit allocator over an abstract range of offsets (no memory of its own).
+ *	Free blocks are binned by the top bit of their size and then 16 linear steps below it,
+ *	with a bitmap per level, so allocate and free are O(1) and neighbours merge on free.
+ *	Pure CPU - the GPU heaps use it to place resources, but it knows nothing about them.
+ */
+class TLSFAllocator {
+public:
+	static const unsigned int SL_BITS = 4;
+	static const unsigned int SL_COUNT = 1 << SL_BITS;
+	static const unsigned int FL_COUNT = 64 - SL_BITS + 1;
+	static const unsigned int NONE = 0xffffffff;
+
+	struct Block {
+		uint64_t offset;
+		uint64_t size;
+		unsigned int prevPhysical;  // Neighbours in address order
+		unsigned int nextPhysical;
+		unsigned int prevFree;      // Neighbours in the same size bin
+		unsigned int nextFree;
+		bool free;
+	};
+
+	std::vector<Block> blocks;
+	std::vector<unsigned int> unusedBlocks;
+	uint64_t flBitmap = 0;
+	uint32_t slBitmap[FL_COUNT];
+	unsigned int freeLists[FL_COUNT][SL_COUNT];
+	uint64_t granularity = 1;
+	TLSFStats stats = {};
+
+	// granularity is the smallest size and alignment handed out (a power of two)
+	void initialize(uint64_t size, uint64_t _granularity = 256) {
+		granularity = _granularity;
+		blocks.clear();
+		unusedBlocks.clear();
+		flBitmap = 0;
+		for (unsigned int i = 0; i < FL_COUNT; i++) {
+			slBitmap[i] = 0;
+			for (unsigned int j = 0; j < SL_COUNT; j++) freeLists[i][j] = NONE;
+		}
+		stats = {};
+		stats.size = size & ~(granularity - 1);
+		stats.freeBytes = stats.size;
+
+		unsigned int block = createBlock(0, stats.size);
+		insertFree(block);
+	}
+
+	bool allocate(uint64_t size, uint64_t alignment, TLSFAllocation& allocation) {
+		if (size == 0) size = 1;
+		size = alignUp(size, granularity);
+		if (alignment < granularity) alignment = granularity;
+
+		// Any block this big can be aligned, padding is never more than alignment - granularity
+		uint64_t searchSize = size + alignment - granularity;
+		if (searchSize >= SL_COUNT) searchSize += (1ull << (highestBit(searchSize) - SL_BITS)) - 1;  // Round up to the next bin
+		unsigned int block = findFree(searchSize);
+		if (block == NONE) return false;
+		removeFree(block);
+
+		// Give the front padding back as its own free block
+		uint64_t padding = alignUp(blocks[block].offset, alignment) - blocks[block].offset;
+		if (padding > 0) {
+			unsigned int front = createBlock(blocks[block].offset, padding);
+			linkBefore(front, block);
+			blocks[block].offset += padding;
+			blocks[block].size -= padding;
+			insertFree(front);
+		}
+
+		// And anything left over at the back
+		if (blocks[block].size > size) {
+			unsigned int back = createBlock(blocks[block].offset + size, blocks[block].size - size);
+			linkAfter(back, block);
+			blocks[block].size = size;
+			insertFree(back);
+		}
+
+		blocks[block].free = false;
+		stats.usedBytes += size;
+		stats.freeBytes -= size;
+		stats.allocations++;
+
+		allocation.offset = blocks[block].offset;
+		allocation.size = size;
+		allocation.block = block;
+		return true;
+	}
+
+	void free(unsigned int block) {
+		stats.usedBytes -= blocks[block].size;
+		stats.freeBytes += blocks[block].size;
+		stats.allocations--;
+
+		// Merge with free neighbours so the range does not splinter
+		unsigned int prev = blocks[block].prevPhysical;
+		if (prev != NONE && blocks[prev].free) {
+			removeFree(prev);
+			blocks[block].offset = blocks[prev].offset;
+			blocks[block].size += blocks[prev].size;
+			unlink(prev);
+		}
+		unsigned int next = blocks[block].nextPhysical;
+		if (next != NONE && blocks[next].free) {
+			removeFree(next);
+			blocks[block].size += blocks[next].size;
+			unlink(next);
+		}
+		insertFree(block);
+	}
+
+	const TLSFStats& getStats() {
+		// The largest free block is in the highest non-empty bin
+		stats.largestFreeBlock = 0;
+		if (flBitmap != 0) {
+			unsigned int fl = highestBit(flBitmap);
+			unsigned int sl = highestBit(slBitmap[fl]);
+			for (unsigned int block = freeLists[fl][sl]; block != NONE; block = blocks[block].nextFree)
+				if (blocks[block].size > stats.largestFreeBlock) stats.largestFreeBlock = blocks[block].size;
+		}
+		return stats;
+	}
+
+private:
+	static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	static void mapping(uint64_t size, unsigned int& fl, unsigned int& sl) {
+		if (size < SL_COUNT) {
+			fl = 0;
+			sl = (unsigned int)size;
+			return;
+		}
+		unsigned int top = highestBit(size);
+		fl = top - SL_BITS + 1;
+		sl = (unsigned int)(size >> (top - SL_BITS)) - SL_COUNT;
+	}
+
+	unsigned int findFree(uint64_t size) {
+		unsigned int fl, sl;
+		mapping(size, fl, sl);
+		if (fl >= FL_COUNT) return NONE;
+
+		uint32_t slMap = slBitmap[fl] & (~0u << sl);
+		if (slMap == 0) {
+			// Nothing in this row, take the smallest bin of the next non-empty one
+			uint64_t flMap = (fl + 1 < 64) ? flBitmap & (~0ull << (fl + 1)) : 0;
+			if (flMap == 0) return NONE;
+			fl = lowestBit(flMap);
+			slMap = slBitmap[fl];
+		}
+		sl = lowestBit(slMap);
+		return freeLists[fl][sl];
+	}
+
+	void insertFree(unsigned int block) {
+		unsigned int fl, sl;
+		mapping(blocks[block].size, fl, sl);
+		Block& b = blocks[block];
+		b.free = true;
+		b.prevFree = NONE;
+		b.nextFree = freeLists[fl][sl];
+		if (b.nextFree != NONE) blocks[b.nextFree].prevFree = block;
+		freeLists[fl][sl] = block;
+		flBitmap |= 1ull << fl;
+		slBitmap[fl] |= 1u << sl;
+		stats.freeBlocks++;
+	}
+
+	void removeFree(unsigned int block) {
+		unsigned int fl, sl;
+		mapping(blocks[block].size, fl, sl);
+		Block& b = blocks[block];
+		if (b.prevFree != NONE) blocks[b.prevFree].nextFree = b.nextFree;
+		else freeLists[fl][sl] = b.nextFree;
+		if (b.nextFree != NONE) blocks[b.nextFree].prevFree = b.prevFree;
+		if (freeLists[fl][sl] == NONE) {
+			slBitmap[fl] &= ~(1u << sl);
+			if (slBitmap[fl] == 0) flBitmap &= ~(1ull << fl);
+		}
+		b.free = false;
+		stats.freeBlocks--;
+	}
+
+	unsigned int createBlock(uint64_t offset, uint64_t size) {
+		unsigned int block;
+		if (!unusedBlocks.empty()) {
+			block = unusedBlocks.back();
+			unusedBlocks.pop_back();
+		} else {
+			block = (unsigned int)blocks.size();
+			blocks.push_back(Block());
+		}
+		Block& b = blocks[block];
+		b.offset = offset;
+		b.size = size;
+		b.prevPhysical = b.nextPhysical = b.prevFree = b.nextFree = NONE;
+		b.free = false;
+		return block;
+	}
+
+	void linkBefore(unsigned int block, unsigned int next) {
+		blocks[block].prevPhysical = blocks[next].prevPhysical;
+		blocks[block].nextPhysical = next;
+		if (blocks[next].prevPhysical != NONE) blocks[blocks[next].prevPhysical].nextPhysical = block;
+		blocks[next].prevPhysical = block;
+	}
+
+	void linkAfter(unsigned int block, unsigned int prev) {
+		blocks[block].nextPhysical = blocks[prev].nextPhysical;
+		blocks[block].prevPhysical = prev;
+		if (blocks[prev].nextPhysical != NONE) blocks[blocks[prev].nextPhysical].prevPhysical = block;
+		blocks[prev].nextPhysical = block;
+	}
+
+	// Drop a block that has been merged into a neighbour
+	void unlink(unsigned int block) {
+		Block& b = blocks[block];
+		if (b.prevPhysical != NONE) blocks[b.prevPhysical].nextPhysical = b.nextPhysical;
+		if (b.nextPhysical != NONE) blocks[b.nextPhysical].prevPhysical = b.prevPhysical;
+		unusedBlocks.push_back(block);
+	}
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *	Fixed set of worker threads that run one parallel-for at a time.
+ *	run() hands indices out from an atomic counter and the calling thread works too, so a pool
+ *	with no workers just runs everything inline. Thread 0 is always the caller.
+ */
+class ThreadPool {
+public:
+	// Calls job(index, thread) for every index, returns once all of them have finished
+	typedef std::function<void(unsigned int index, unsigned int thread)> Job;
+
+	// 0 workers means one per hardware thread besides the caller
+	void initialize(unsigned int workerCount = 0) {
+		if (workerCount == 0) {
+			unsigned int hardware = std::thread::hardware_concurrency();
+			workerCount = (hardware > 1) ? hardware - 1 : 0;
+		}
+		for (unsigned int i = 0; i < workerCount; i++) workers.push_back(std::thread(&ThreadPool::workerLoop, this, i + 1));
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	unsigned int threadCount() const { return (unsigned int)workers.size() + 1; }
+
+	void run(unsigned int count, const Job& job) {
+		if (count == 0) return;
+		if (workers.empty() || count == 1) {
+			for (unsigned int i = 0; i < count; i++) job(i, 0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = &job;
+			jobCount = count;
+			next = 0;
+			busy = (unsigned int)workers.size();
+			generation++;
+		}
+		wake.notify_all();
+		work(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return busy == 0; });
+		current = NULL;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const Job* current = NULL;
+	unsigned int jobCount = 0;
+	std::atomic<unsigned int> next{ 0 };
+	unsigned int busy = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	void work(unsigned int thread) {
+		for (unsigned int i = next++; i < jobCount; i = next++) (*current)(i, thread);
+	}
+
+	void workerLoop(unsigned int thread) {
+		uint64_t seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping) return;
+				seen = generation;
+			}
+			work(thread);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				busy--;
+			}
+			done.notify_one();
+		}
+	}
+};
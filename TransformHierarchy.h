@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MyMath.h"
+#include "Platform.h"
+#include "ThreadPool.h"
+
+struct TransformStats {
+	uint64_t recomputed;        // World matrices rebuilt by the last update
+	uint64_t skipped;           // ...left alone because nothing above them changed
+	uint64_t rangesUpdated;     // Disjoint dirty subtrees walked, after nested ones were merged
+	uint64_t jobs;              // Pool jobs they were handed out as
+	double updateMs;
+};
+
+/*
+ *	Flat transform hierarchy. Nodes live in arrays indexed by node, with each parent index lower
+ *	than its children's (topological order). Local and world matrices are separate arrays, and
+ *	besides the parent only a dirty byte and a place in a depth-first order are stored per node.
+ *	In that depth-first order every node's descendants directly follow it, so the part of the
+ *	hierarchy a setLocal() affects is one contiguous range. update() turns the dirty nodes into
+ *	ranges, drops the ones nested inside another and walks only those: a static scene costs
+ *	nothing and a changed leaf costs one matrix. Ranges are handed to the thread pool in jobs of
+ *	about JOB_NODES, a bigger one is split below its top node into one range per child.
+ *	The order is rebuilt in update() after nodes were added.
+ */
+class TransformHierarchy {
+public:
+	static const unsigned int JOB_NODES = 1024;
+
+	std::vector<int> parents;       // -1 for roots
+	std::vector<Matrix> locals;     // Relative to the parent
+	std::vector<Matrix> worlds;     // Parent's world * local, valid after update()
+	TransformStats stats = {};
+
+	unsigned int size() const { return (unsigned int)parents.size(); }
+
+	// Parent has to exist already, which is what keeps the order topological
+	unsigned int addNode(int parent, const Matrix& local) {
+		unsigned int node = size();
+		if (parent >= (int)node) {
+			debugLog("TransformHierarchy: parent " + std::to_string(parent) + " added after its child, making it a root\n");
+			parent = -1;
+		}
+		parents.push_back(parent);
+		locals.push_back(local);
+		worlds.push_back(local);
+		dirty.push_back(0);
+		orderStale = true;
+		markDirty(node);
+		return node;
+	}
+
+	void setLocal(unsigned int node, const Matrix& local) {
+		locals[node] = local;
+		markDirty(node);
+	}
+
+	const Matrix& getWorld(unsigned int node) const { return worlds[node]; }
+
+	// Rebuild the world matrices under every changed node, in parallel when given a pool
+	void update(ThreadPool* pool = NULL) {
+		auto start = std::chrono::high_resolution_clock::now();
+		stats = {};
+		if (orderStale) rebuildOrder();
+
+		// Depth-first positions sort parents before their descendants, a range starting inside the last one is nested in it.
+		// With a large part of the hierarchy dirty one pass over the order is cheaper than sorting.
+		ranges.clear();
+		if (dirtyNodes.size() * 8 > size()) {
+			for (unsigned int first = 0; first < size(); first++) {
+				if (!dirty[order[first]]) continue;
+				ranges.push_back({ first, first + extent[order[first]] });
+				first = ranges.back().end - 1;
+			}
+		} else {
+			starts.clear();
+			for (unsigned int node : dirtyNodes) starts.push_back(position[node]);
+			std::sort(starts.begin(), starts.end());
+			for (unsigned int first : starts)
+				if (ranges.empty() || first >= ranges.back().end) ranges.push_back({ first, first + extent[order[first]] });
+		}
+		for (unsigned int node : dirtyNodes) dirty[node] = 0;
+		dirtyNodes.clear();
+		for (const Range& range : ranges) stats.recomputed += range.end - range.begin;
+		stats.rangesUpdated = ranges.size();
+		stats.skipped = size() - stats.recomputed;
+
+		if (pool) splitRanges();
+
+		// Group small ranges so each job has about JOB_NODES to do
+		jobStarts.clear();
+		unsigned int nodes = JOB_NODES;
+		for (unsigned int i = 0; i < ranges.size(); i++) {
+			if (nodes >= JOB_NODES) {
+				jobStarts.push_back(i);
+				nodes = 0;
+			}
+			nodes += ranges[i].end - ranges[i].begin;
+		}
+		jobStarts.push_back((unsigned int)ranges.size());
+		stats.jobs = jobStarts.size() - 1;
+
+		ThreadPool::Job job = [this](unsigned int index, unsigned int) {
+			for (unsigned int i = jobStarts[index]; i < jobStarts[index + 1]; i++) updateRange(ranges[i]);
+		};
+		if (pool) pool->run((unsigned int)stats.jobs, job);
+		else for (unsigned int i = 0; i < stats.jobs; i++) job(i, 0);
+		stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+private:
+	struct Range {
+		unsigned int begin, end;  // Positions in order, begin is the dirty node
+	};
+
+	std::vector<uint8_t> dirty;           // Local changed since the last update
+	std::vector<unsigned int> dirtyNodes; // ...the same nodes as a list
+	std::vector<unsigned int> order;      // Nodes depth-first, roots in node order
+	std::vector<unsigned int> position;   // Of each node in order
+	std::vector<unsigned int> extent;     // Node plus all its descendants
+	bool orderStale = false;
+	std::vector<unsigned int> starts;
+	std::vector<Range> ranges;
+	std::vector<unsigned int> jobStarts;
+
+	void markDirty(unsigned int node) {
+		if (dirty[node]) return;
+		dirty[node] = 1;
+		dirtyNodes.push_back(node);
+	}
+
+	void rebuildOrder() {
+		unsigned int count = size();
+		extent.assign(count, 1);
+		for (unsigned int node = count; node-- > 0;)
+			if (parents[node] >= 0) extent[parents[node]] += extent[node];
+
+		// Each child goes right after its parent's earlier children and all of their descendants
+		std::vector<unsigned int> next(count);
+		position.resize(count);
+		order.resize(count);
+		unsigned int rootPosition = 0;
+		for (unsigned int node = 0; node < count; node++) {
+			int parent = parents[node];
+			if (parent < 0) {
+				position[node] = rootPosition;
+				rootPosition += extent[node];
+			} else {
+				position[node] = next[parent];
+			}
+			next[node] = position[node] + 1;
+			if (parent >= 0) next[parent] += extent[node];
+			order[position[node]] = node;
+		}
+		orderStale = false;
+	}
+
+	// Worlds of the top nodes of big ranges are rebuilt here, their children's ranges replace them
+	void splitRanges() {
+		std::vector<Range> pending;
+		pending.swap(ranges);
+		while (!pending.empty()) {
+			Range range = pending.back();
+			pending.pop_back();
+			if (range.end - range.begin <= JOB_NODES) {
+				ranges.push_back(range);
+				continue;
+			}
+			updateRange({ range.begin, range.begin + 1 });
+			for (unsigned int child = range.begin + 1; child < range.end; child += extent[order[child]])
+				pending.push_back({ child, child + extent[order[child]] });
+		}
+	}
+
+	// The first node's parent is outside the range and already up to date, every other node's is inside
+	void updateRange(const Range& range) {
+		for (unsigned int i = range.begin; i < range.end; i++) {
+			unsigned int node = order[i];
+			int parent = parents[node];
+			worlds[node] = (parent >= 0) ? worlds[parent].mul(locals[node]) : locals[node];
+		}
+	}
+};
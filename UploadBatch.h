@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "GPUDevice.h"
+#include "Platform.h"
+#include "ResourceStateTracker.h"
+
+/*
+ *	Persistent, persistently mapped staging buffer used as a circular FIFO.
+ *	head/tail are running byte counts (offset = count % capacity) so "bytes in use" is just head - tail.
+ *	Allocations made before close() are tagged with the fence value that frees them.
+ */
+class StagingRing {
+public:
+	struct Region {
+		uint64_t end;         // head when the region was closed
+		uint64_t fenceValue;  // Completes once the GPU has read everything before end
+	};
+
+	GPUResource* buffer = NULL;
+	unsigned char* mapped = NULL;
+	uint64_t capacity = 0;
+	uint64_t head = 0;
+	uint64_t tail = 0;
+	uint64_t highWaterMark = 0;
+	std::deque<Region> inFlight;
+
+	void initialize(GPUDevice* device, uint64_t sizeInBytes) {
+		capacity = sizeInBytes;
+		buffer = device->createBuffer(GPU_HEAP_UPLOAD, capacity, GPU_STATE_GENERIC_READ);
+		mapped = (unsigned char*)buffer->map();
+	}
+
+	~StagingRing() {
+		if (buffer) {
+			buffer->unmap();
+			delete buffer;
+		}
+	}
+
+	uint64_t used() const { return head - tail; }
+
+	// Returns false if there is not enough free space right now
+	bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+		uint64_t start = (head + alignment - 1) & ~(alignment - 1);
+		// Allocations never straddle the end of the buffer, skip to the start instead
+		if ((start % capacity) + size > capacity) start += capacity - (start % capacity);
+		if (start + size - tail > capacity) return false;
+		offset = start % capacity;
+		head = start + size;
+		if (used() > highWaterMark) highWaterMark = used();
+		return true;
+	}
+
+	void close(uint64_t fenceValue) {
+		if (!inFlight.empty() && inFlight.back().end == head) return;
+		Region region = { head, fenceValue };
+		inFlight.push_back(region);
+	}
+
+	void retire(uint64_t completedValue) {
+		while (!inFlight.empty() && inFlight.front().fenceValue <= completedValue) {
+			tail = inFlight.front().end;
+			inFlight.pop_front();
+		}
+	}
+};
+
+struct UploadStats {
+	uint64_t buffersQueued;
+	uint64_t texturesQueued;
+	uint64_t bytesQueued;
+	uint64_t submits;
+	uint64_t stalls;             // Times the ring was full and the CPU had to wait for the GPU
+	uint64_t dedicatedBuffers;   // Uploads too large for the ring
+};
+
+// How copy queue uploads lined up against rendering, reset every frame
+struct StreamingFrameStats {
+	uint64_t submits;         // Copy queue submissions made this frame
+	uint64_t bytes;           // Bytes queued for the copy queue this frame
+	uint64_t firstUses;       // Streamed resources used by the graphics queue for the first time
+	uint64_t overlapped;      // First uses whose copy had already finished, no wait needed
+	uint64_t serialized;      // First uses that made the graphics queue wait on the copy queue
+	uint64_t copiesInFlight;  // Frames submitted while copy work was still running
+};
+
+/*
+ *	Collects buffer and texture copies and submits them as one command list on one queue.
+ *	All "to COPY_DEST" transitions, then all copies, then all "to final state" transitions,
+ *	so N uploads cost one submission and one fence instead of N round trips.
+ *	Transitions start from each resource's tracked state, so re-uploads are handled too.
+ *	On a copy queue no barriers are recorded: resources stay in COMMON, which the graphics
+ *	queue implicitly promotes from, and each destination is stamped with the fence value
+ *	its copy completes at so the first user can wait for exactly that.
+ *	The fence is the queue's shared timeline, so fenceValue is only this batch's last signal.
+ */
+class UploadBatch {
+public:
+	struct PendingCopy {
+		GPUResource* dst;
+		GPUResource* src;
+		uint64_t srcOffset;
+		uint64_t size;
+		GPUResourceState targetState;
+		bool texture;
+		GPUTextureFootprint footprint;
+	};
+
+	struct DedicatedBuffer {
+		GPUResource* buffer;
+		uint64_t fenceValue;
+	};
+
+	GPUDevice* device;
+	GPUQueue* queue;
+	GPUQueueType queueType;
+	TrackedCommandList commandList;
+	GPUFence* fence;
+	uint64_t fenceValue = 0;
+
+	StagingRing ring;
+	std::vector<PendingCopy> pending;
+	std::vector<DedicatedBuffer> dedicated;
+	UploadStats stats = {};
+
+	void initialize(GPUDevice* _device, GPUQueue* _queue, GPUQueueType _queueType, GPUFence* queueFence, uint64_t ringSizeInBytes) {
+		device = _device;
+		queue = _queue;
+		queueType = _queueType;
+		fence = queueFence;
+		commandList.initialize(device->createCommandList(queueType));
+		ring.initialize(device, ringSizeInBytes);
+	}
+
+	~UploadBatch() {
+		for (DedicatedBuffer& d : dedicated) delete d.buffer;
+	}
+
+	void queueBuffer(GPUResource* dst, const void* data, uint64_t size, GPUResourceState targetState) {
+		PendingCopy copy = {};
+		copy.dst = dst;
+		copy.size = size;
+		copy.targetState = targetState;
+		copy.texture = false;
+		stage(copy, data, 16);
+		stats.buffersQueued++;
+	}
+
+	// data is already laid out with footprint.rowPitch, footprint.offset is relative to data
+	void queueTexture(GPUResource* dst, const void* data, uint64_t size, const GPUTextureFootprint& footprint, GPUResourceState targetState) {
+		PendingCopy copy = {};
+		copy.dst = dst;
+		copy.size = size;
+		copy.targetState = targetState;
+		copy.texture = true;
+		copy.footprint = footprint;
+		stage(copy, data, 512);  // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+		stats.texturesQueued++;
+	}
+
+	// Record and execute everything queued so far, returns the fence value that marks completion
+	uint64_t submit() {
+		if (pending.empty()) return fenceValue;
+
+		commandList.reset();
+		bool transitions = (queueType != GPU_QUEUE_COPY);
+		if (transitions)
+			for (PendingCopy& copy : pending) commandList.transition(copy.dst, GPU_STATE_COPY_DEST);
+
+		// The first copy flushes every transition above in one call
+		for (PendingCopy& copy : pending) {
+			if (copy.texture) {
+				commandList.copyTextureRegion(copy.dst, 0, copy.src, copy.footprint);
+			} else {
+				commandList.copyBufferRegion(copy.dst, 0, copy.src, copy.srcOffset, copy.size);
+			}
+		}
+
+		if (transitions)
+			for (PendingCopy& copy : pending) commandList.transition(copy.dst, copy.targetState);
+		commandList.close();
+
+		GPUCommandList* lists[] = { commandList.commandList };
+		queue->executeCommandLists(1, lists);
+		fenceValue = fence->signal(queue);
+
+		// Everything staged so far is free once this value completes
+		ring.close(fenceValue);
+		for (DedicatedBuffer& d : dedicated)
+			if (d.fenceValue == 0) d.fenceValue = fenceValue;
+		if (queueType == GPU_QUEUE_COPY)
+			for (PendingCopy& copy : pending) copy.dst->uploadFenceValue = fenceValue;
+		pending.clear();
+		stats.submits++;
+		return fenceValue;
+	}
+
+	bool isComplete(uint64_t value) { return fence->isComplete(value); }
+
+	void wait(uint64_t value) {
+		fence->wait(value);
+		retire();
+	}
+
+	void flush() { wait(submit()); }
+
+	// Give back staging memory the GPU has finished reading
+	void retire() {
+		uint64_t completed = fence->fence->getCompletedValue();
+		ring.retire(completed);
+		for (unsigned int i = 0; i < dedicated.size();) {
+			if (dedicated[i].fenceValue != 0 && dedicated[i].fenceValue <= completed) {
+				delete dedicated[i].buffer;
+				dedicated[i] = dedicated.back();
+				dedicated.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+
+private:
+	void stage(PendingCopy& copy, const void* data, uint64_t alignment) {
+		stats.bytesQueued += copy.size;
+		unsigned char* dst = NULL;
+
+		if (copy.size > ring.capacity) {
+			// Larger than the whole ring - give it its own staging buffer, freed on the fence
+			DedicatedBuffer d = { device->createBuffer(GPU_HEAP_UPLOAD, copy.size, GPU_STATE_GENERIC_READ), 0 };
+			dedicated.push_back(d);
+			copy.src = d.buffer;
+			copy.srcOffset = 0;
+			dst = (unsigned char*)d.buffer->map();
+			memcpy(dst, data, (size_t)copy.size);
+			d.buffer->unmap();
+			stats.dedicatedBuffers++;
+		} else {
+			uint64_t offset = 0;
+			if (!ring.allocate(copy.size, alignment, offset)) {
+				retire();
+				if (!ring.allocate(copy.size, alignment, offset)) {
+					// Ring is full of this batch or of uploads still in flight - submit and wait for space
+					stats.stalls++;
+					flush();
+					if (!ring.allocate(copy.size, alignment, offset)) {
+						// Only possible if the ring is fragmented at the wrap point, an empty ring always fits
+						ring.head = ring.tail = 0;
+						ring.allocate(copy.size, alignment, offset);
+					}
+				}
+			}
+			copy.src = ring.buffer;
+			copy.srcOffset = offset;
+			memcpy(ring.mapped + offset, data, (size_t)copy.size);
+		}
+		if (copy.texture) copy.footprint.offset += copy.srcOffset;
+		// Replaced by the real fence value when the batch is submitted
+		if (queueType == GPU_QUEUE_COPY) copy.dst->uploadFenceValue = GPU_UPLOAD_PENDING;
+		pending.push_back(copy);
+	}
+};
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <assert.h>
+#include <cstring>
+
+#include "MyMath.h"
+#include "Platform.h"
+
+// Every stream is padded to a multiple of this many floats and aligned for full-width loads
+const size_t STREAM_WIDTH = 8;
+const size_t STREAM_ALIGNMENT = 32;
+
+/*
+ *	One register worth of floats - 8 with AVX, 4 with SSE, 1 without SIMD - so each stream
+ *	operation is written once. Only whole lanes are ever loaded or stored, the padding at the
+ *	end of a stream takes the spill. Comparisons return one bit per lane, lane 0 lowest.
+ *	laneRamp(start, step) is start + step * lane.
+ *	laneMin/laneMax pick the same operand as std::min/std::max on ties, so results match
+ *	Min/Max on Vec3 bit for bit.
+ */
+#if defined(MYMATH_AVX)
+typedef __m256 StreamLane;
+const size_t LANE_WIDTH = 8;
+inline StreamLane laneLoad(const float* p) { return _mm256_load_ps(p); }
+inline void laneStore(float* p, StreamLane v) { _mm256_store_ps(p, v); }
+inline StreamLane laneSet(float f) { return _mm256_set1_ps(f); }
+inline StreamLane laneAdd(StreamLane a, StreamLane b) { return _mm256_add_ps(a, b); }
+inline StreamLane laneSub(StreamLane a, StreamLane b) { return _mm256_sub_ps(a, b); }
+inline StreamLane laneMul(StreamLane a, StreamLane b) { return _mm256_mul_ps(a, b); }
+inline StreamLane laneDiv(StreamLane a, StreamLane b) { return _mm256_div_ps(a, b); }
+inline StreamLane laneSqrt(StreamLane a) { return _mm256_sqrt_ps(a); }
+inline StreamLane laneMin(StreamLane a, StreamLane b) { return _mm256_min_ps(b, a); }
+inline StreamLane laneMax(StreamLane a, StreamLane b) { return _mm256_max_ps(b, a); }
+inline StreamLane laneLoadUnaligned(const float* p) { return _mm256_loadu_ps(p); }
+inline void laneStoreUnaligned(float* p, StreamLane v) { _mm256_storeu_ps(p, v); }
+inline StreamLane laneRamp(float start, float step) { return _mm256_add_ps(_mm256_set1_ps(start), _mm256_mul_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7))); }
+inline unsigned int laneGreaterEqualMask(StreamLane a, StreamLane b) { return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)); }
+inline unsigned int laneLessMask(StreamLane a, StreamLane b) { return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+#elif defined(MYMATH_SSE)
+typedef __m128 StreamLane;
+const size_t LANE_WIDTH = 4;
+inline StreamLane laneLoad(const float* p) { return _mm_load_ps(p); }
+inline void laneStore(float* p, StreamLane v) { _mm_store_ps(p, v); }
+inline StreamLane laneSet(float f) { return _mm_set1_ps(f); }
+inline StreamLane laneAdd(StreamLane a, StreamLane b) { return _mm_add_ps(a, b); }
+inline StreamLane laneSub(StreamLane a, StreamLane b) { return _mm_sub_ps(a, b); }
+inline StreamLane laneMul(StreamLane a, StreamLane b) { return _mm_mul_ps(a, b); }
+inline StreamLane laneDiv(StreamLane a, StreamLane b) { return _mm_div_ps(a, b); }
+inline StreamLane laneSqrt(StreamLane a) { return _mm_sqrt_ps(a); }
+inline StreamLane laneMin(StreamLane a, StreamLane b) { return _mm_min_ps(b, a); }
+inline StreamLane laneMax(StreamLane a, StreamLane b) { return _mm_max_ps(b, a); }
+inline StreamLane laneLoadUnaligned(const float* p) { return _mm_loadu_ps(p); }
+inline void laneStoreUnaligned(float* p, StreamLane v) { _mm_storeu_ps(p, v); }
+inline StreamLane laneRamp(float start, float step) { return _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3))); }
+inline unsigned int laneGreaterEqualMask(StreamLane a, StreamLane b) { return (unsigned int)_mm_movemask_ps(_mm_cmpge_ps(a, b)); }
+inline unsigned int laneLessMask(StreamLane a, StreamLane b) { return (unsigned int)_mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+#else
+typedef float StreamLane;
+const size_t LANE_WIDTH = 1;
+inline StreamLane laneLoad(const float* p) { return *p; }
+inline void laneStore(float* p, StreamLane v) { *p = v; }
+inline StreamLane laneSet(float f) { return f; }
+inline StreamLane laneAdd(StreamLane a, StreamLane b) { return a + b; }
+inline StreamLane laneSub(StreamLane a, StreamLane b) { return a - b; }
+inline StreamLane laneMul(StreamLane a, StreamLane b) { return a * b; }
+inline StreamLane laneDiv(StreamLane a, StreamLane b) { return a / b; }
+inline StreamLane laneSqrt(StreamLane a) { return sqrtf(a); }
+inline StreamLane laneMin(StreamLane a, StreamLane b) { return std::min<float>(a, b); }
+inline StreamLane laneMax(StreamLane a, StreamLane b) { return std::max<float>(a, b); }
+inline StreamLane laneLoadUnaligned(const float* p) { return *p; }
+inline void laneStoreUnaligned(float* p, StreamLane v) { *p = v; }
+inline StreamLane laneRamp(float start, float) { return start; }
+inline unsigned int laneGreaterEqualMask(StreamLane a, StreamLane b) { return (a >= b) ? 1u : 0u; }
+inline unsigned int laneLessMask(StreamLane a, StreamLane b) { return (a < b) ? 1u : 0u; }
+#endif
+
+// One allocation holding every component array of a stream back to back
+class StreamStorage {
+public:
+	float* data = NULL;
+	size_t count = 0;
+	size_t capacity = 0;  // Per component, always a multiple of STREAM_WIDTH
+
+	StreamStorage() {}
+	StreamStorage(const StreamStorage&) = delete;
+	StreamStorage& operator=(const StreamStorage&) = delete;
+
+	~StreamStorage() {
+		alignedFree(data);
+	}
+
+	// Keeps the first min(count, n) elements, new ones read as 0. The kernels write whole lanes, so
+	// the padding past count holds whatever they left there (Normalize leaves NaN) until it is grown into.
+	void resize(size_t n, unsigned int components) {
+		size_t needed = (n + STREAM_WIDTH - 1) & ~(STREAM_WIDTH - 1);
+		if (needed > capacity) {
+			float* grown = (float*)alignedAlloc(needed * components * sizeof(float), STREAM_ALIGNMENT);
+			for (unsigned int c = 0; c < components; c++) {
+				if (count > 0) memcpy(grown + c * needed, data + c * capacity, count * sizeof(float));
+				memset(grown + c * needed + count, 0, (needed - count) * sizeof(float));
+			}
+			alignedFree(data);
+			data = grown;
+			capacity = needed;
+		} else if (n > count) {
+			for (unsigned int c = 0; c < components; c++) memset(data + c * capacity + count, 0, (n - count) * sizeof(float));
+		}
+		count = n;
+	}
+
+	float* component(unsigned int c) const { return data + c * capacity; }
+
+	// Element count rounded up to whole lanes, which is what the operations loop over
+	size_t padded() const { return (count + LANE_WIDTH - 1) & ~(LANE_WIDTH - 1); }
+};
+
+// Per-component kernels, out may be one of the inputs
+inline void streamAdd(const float* a, const float* b, float* out, size_t n) {
+	for (size_t i = 0; i < n; i += LANE_WIDTH) laneStore(&out[i], laneAdd(laneLoad(&a[i]), laneLoad(&b[i])));
+}
+
+inline void streamSub(const float* a, const float* b, float* out, size_t n) {
+	for (size_t i = 0; i < n; i += LANE_WIDTH) laneStore(&out[i], laneSub(laneLoad(&a[i]), laneLoad(&b[i])));
+}
+
+inline void streamScale(const float* a, float scalar, float* out, size_t n) {
+	StreamLane s = laneSet(scalar);
+	for (size_t i = 0; i < n; i += LANE_WIDTH) laneStore(&out[i], laneMul(laneLoad(&a[i]), s));
+}
+
+inline void streamMin(const float* a, const float* b, float* out, size_t n) {
+	for (size_t i = 0; i < n; i += LANE_WIDTH) laneStore(&out[i], laneMin(laneLoad(&a[i]), laneLoad(&b[i])));
+}
+
+inline void streamMax(const float* a, const float* b, float* out, size_t n) {
+	for (size_t i = 0; i < n; i += LANE_WIDTH) laneStore(&out[i], laneMax(laneLoad(&a[i]), laneLoad(&b[i])));
+}
+
+// A stream of single floats, the result of dot products and lengths
+class FloatStream {
+public:
+	StreamStorage storage;
+	float* v = NULL;
+
+	void resize(size_t n) {
+		storage.resize(n, 1);
+		v = storage.component(0);
+	}
+
+	size_t size() const { return storage.count; }
+	float& operator[](size_t i) { return v[i]; }
+	float operator[](size_t i) const { return v[i]; }
+};
+
+/*
+ *	Structure-of-arrays Vec3s - all the x values, then all the y values, then all the z values -
+ *	so a loop over thousands of positions or normals works on 4 or 8 of them per instruction.
+ *	Convert from/to the Vec3 arrays the rest of the code uses at the edges.
+ */
+class Vec3Stream {
+public:
+	StreamStorage storage;
+	float* x = NULL;
+	float* y = NULL;
+	float* z = NULL;
+
+	void resize(size_t n) {
+		storage.resize(n, 3);
+		x = storage.component(0);
+		y = storage.component(1);
+		z = storage.component(2);
+	}
+
+	size_t size() const { return storage.count; }
+	Vec3 get(size_t i) const { return Vec3(x[i], y[i], z[i]); }
+	void set(size_t i, const Vec3& value) { x[i] = value.x; y[i] = value.y; z[i] = value.z; }
+
+	void fromAoS(const Vec3* values, size_t n) {
+		resize(n);
+		for (size_t i = 0; i < n; i++) set(i, values[i]);
+	}
+
+	// xyz of each Vec4, w is dropped
+	void fromAoS(const Vec4* values, size_t n) {
+		resize(n);
+		for (size_t i = 0; i < n; i++) {
+			x[i] = values[i].x; y[i] = values[i].y; z[i] = values[i].z;
+		}
+	}
+
+	void toAoS(Vec3* values) const {
+		for (size_t i = 0; i < size(); i++) values[i] = get(i);
+	}
+};
+
+/*
+ *	Structure-of-arrays Vec4s, also used for colours (x, y, z, w hold r, g, b, a).
+ */
+class Vec4Stream {
+public:
+	StreamStorage storage;
+	float* x = NULL;
+	float* y = NULL;
+	float* z = NULL;
+	float* w = NULL;
+
+	void resize(size_t n) {
+		storage.resize(n, 4);
+		x = storage.component(0);
+		y = storage.component(1);
+		z = storage.component(2);
+		w = storage.component(3);
+	}
+
+	size_t size() const { return storage.count; }
+	Vec4 get(size_t i) const { return Vec4(x[i], y[i], z[i], w[i]); }
+	void set(size_t i, const Vec4& value) { x[i] = value.x; y[i] = value.y; z[i] = value.z; w[i] = value.w; }
+
+	void fromAoS(const Vec4* values, size_t n) {
+		resize(n);
+		for (size_t i = 0; i < n; i++) set(i, values[i]);
+	}
+
+	void fromAoS(const Colour* values, size_t n) {
+		resize(n);
+		for (size_t i = 0; i < n; i++) {
+			x[i] = values[i].r; y[i] = values[i].g; z[i] = values[i].b; w[i] = values[i].a;
+		}
+	}
+
+	void toAoS(Vec4* values) const {
+		for (size_t i = 0; i < size(); i++) values[i] = get(i);
+	}
+
+	void toAoS(Colour* values) const {
+		for (size_t i = 0; i < size(); i++) values[i] = Colour(x[i], y[i], z[i], w[i]);
+	}
+};
+
+/*
+ *	Whole-stream operations. out is resized to match a, and may be a or b (except for cross).
+ *	b has to be at least as long as a, the kernels read it as far as a's padding.
+ *	Each one does the same arithmetic in the same order as the Vec3/Vec4 member it mirrors,
+ *	so results are identical to looping over the AoS types (Normalize aside, see below).
+ */
+inline bool streamCovers(size_t aSize, size_t bSize) {
+	if (bSize >= aSize) return true;
+	debugLog("VectorStream: second stream has " + std::to_string(bSize) + " elements, the first " + std::to_string(aSize) + "\n");
+	assert(false);
+	return false;
+}
+
+inline void Add(const Vec3Stream& a, const Vec3Stream& b, Vec3Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamAdd(a.x, b.x, out.x, n);
+	streamAdd(a.y, b.y, out.y, n);
+	streamAdd(a.z, b.z, out.z, n);
+}
+
+inline void Sub(const Vec3Stream& a, const Vec3Stream& b, Vec3Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamSub(a.x, b.x, out.x, n);
+	streamSub(a.y, b.y, out.y, n);
+	streamSub(a.z, b.z, out.z, n);
+}
+
+inline void Scale(const Vec3Stream& a, float scalar, Vec3Stream& out) {
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamScale(a.x, scalar, out.x, n);
+	streamScale(a.y, scalar, out.y, n);
+	streamScale(a.z, scalar, out.z, n);
+}
+
+inline void Min(const Vec3Stream& a, const Vec3Stream& b, Vec3Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamMin(a.x, b.x, out.x, n);
+	streamMin(a.y, b.y, out.y, n);
+	streamMin(a.z, b.z, out.z, n);
+}
+
+inline void Max(const Vec3Stream& a, const Vec3Stream& b, Vec3Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamMax(a.x, b.x, out.x, n);
+	streamMax(a.y, b.y, out.y, n);
+	streamMax(a.z, b.z, out.z, n);
+}
+
+inline void Dot(const Vec3Stream& a, const Vec3Stream& b, FloatStream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	for (size_t i = 0; i < n; i += LANE_WIDTH) {
+		StreamLane d = laneAdd(laneMul(laneLoad(&a.x[i]), laneLoad(&b.x[i])), laneMul(laneLoad(&a.y[i]), laneLoad(&b.y[i])));
+		laneStore(&out.v[i], laneAdd(d, laneMul(laneLoad(&a.z[i]), laneLoad(&b.z[i]))));
+	}
+}
+
+inline void Cross(const Vec3Stream& a, const Vec3Stream& b, Vec3Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	for (size_t i = 0; i < n; i += LANE_WIDTH) {
+		StreamLane ax = laneLoad(&a.x[i]), ay = laneLoad(&a.y[i]), az = laneLoad(&a.z[i]);
+		StreamLane bx = laneLoad(&b.x[i]), by = laneLoad(&b.y[i]), bz = laneLoad(&b.z[i]);
+		laneStore(&out.x[i], laneSub(laneMul(ay, bz), laneMul(az, by)));
+		laneStore(&out.y[i], laneSub(laneMul(az, bx), laneMul(ax, bz)));
+		laneStore(&out.z[i], laneSub(laneMul(ax, by), laneMul(ay, bx)));
+	}
+}
+
+// Like Vec3::normalize, zero length vectors come out as NaN. The sqrt is single precision here,
+// Vec3::normalize rounds through double, so the two can differ in the last bit
+inline void Normalize(const Vec3Stream& a, Vec3Stream& out) {
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	StreamLane one = laneSet(1.f);
+	for (size_t i = 0; i < n; i += LANE_WIDTH) {
+		StreamLane x = laneLoad(&a.x[i]), y = laneLoad(&a.y[i]), z = laneLoad(&a.z[i]);
+		StreamLane lengthSquare = laneAdd(laneAdd(laneMul(x, x), laneMul(y, y)), laneMul(z, z));
+		StreamLane len = laneDiv(one, laneSqrt(lengthSquare));
+		laneStore(&out.x[i], laneMul(x, len));
+		laneStore(&out.y[i], laneMul(y, len));
+		laneStore(&out.z[i], laneMul(z, len));
+	}
+}
+
+// Smallest box around every element (the padding is left out)
+inline void Bounds(const Vec3Stream& a, Vec3& minimum, Vec3& maximum) {
+	if (a.size() == 0) return;
+	StreamLane lo[3] = { laneSet(a.x[0]), laneSet(a.y[0]), laneSet(a.z[0]) };
+	StreamLane hi[3] = { lo[0], lo[1], lo[2] };
+	const float* components[3] = { a.x, a.y, a.z };
+	size_t whole = a.size() & ~(LANE_WIDTH - 1);
+	for (int c = 0; c < 3; c++) {
+		for (size_t i = 0; i < whole; i += LANE_WIDTH) {
+			StreamLane v = laneLoad(&components[c][i]);
+			lo[c] = laneMin(lo[c], v);
+			hi[c] = laneMax(hi[c], v);
+		}
+		float lanes[2][LANE_WIDTH];
+		memcpy(lanes[0], &lo[c], sizeof(StreamLane));
+		memcpy(lanes[1], &hi[c], sizeof(StreamLane));
+		float l = lanes[0][0], h = lanes[1][0];
+		for (size_t i = 1; i < LANE_WIDTH; i++) {
+			l = std::min<float>(l, lanes[0][i]);
+			h = std::max<float>(h, lanes[1][i]);
+		}
+		for (size_t i = whole; i < a.size(); i++) {
+			l = std::min<float>(l, components[c][i]);
+			h = std::max<float>(h, components[c][i]);
+		}
+		minimum.v[c] = l;
+		maximum.v[c] = h;
+	}
+}
+
+inline void Add(const Vec4Stream& a, const Vec4Stream& b, Vec4Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamAdd(a.x, b.x, out.x, n);
+	streamAdd(a.y, b.y, out.y, n);
+	streamAdd(a.z, b.z, out.z, n);
+	streamAdd(a.w, b.w, out.w, n);
+}
+
+inline void Scale(const Vec4Stream& a, float scalar, Vec4Stream& out) {
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamScale(a.x, scalar, out.x, n);
+	streamScale(a.y, scalar, out.y, n);
+	streamScale(a.z, scalar, out.z, n);
+	streamScale(a.w, scalar, out.w, n);
+}
+
+inline void Min(const Vec4Stream& a, const Vec4Stream& b, Vec4Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamMin(a.x, b.x, out.x, n);
+	streamMin(a.y, b.y, out.y, n);
+	streamMin(a.z, b.z, out.z, n);
+	streamMin(a.w, b.w, out.w, n);
+}
+
+inline void Max(const Vec4Stream& a, const Vec4Stream& b, Vec4Stream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	streamMax(a.x, b.x, out.x, n);
+	streamMax(a.y, b.y, out.y, n);
+	streamMax(a.z, b.z, out.z, n);
+	streamMax(a.w, b.w, out.w, n);
+}
+
+inline void Dot(const Vec4Stream& a, const Vec4Stream& b, FloatStream& out) {
+	if (!streamCovers(a.size(), b.size())) return;
+	out.resize(a.size());
+	size_t n = a.storage.padded();
+	for (size_t i = 0; i < n; i += LANE_WIDTH) {
+		StreamLane d = laneAdd(laneMul(laneLoad(&a.x[i]), laneLoad(&b.x[i])), laneMul(laneLoad(&a.y[i]), laneLoad(&b.y[i])));
+		d = laneAdd(d, laneMul(laneLoad(&a.z[i]), laneLoad(&b.z[i])));
+		laneStore(&out.v[i], laneAdd(d, laneMul(laneLoad(&a.w[i]), laneLoad(&b.w[i]))));
+	}
+}
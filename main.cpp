@@ -8,18 +8,47 @@
 #include "ScreenSpaceTriangle.h"
 #include "Primitive.h"
 #include "PSOManager.h"
+#include "NullDevice.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
 #include "Window.h"
+#else
+#include "Benchmarks.h"
+#endif
 
-#include <map>
 #include <cmath>
-#include <fstream>
-#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+#ifdef _WIN32
 // Laptops and Nvidia GPUs - Not found by default
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
 }
+#endif
+
+// Per-frame constant buffer updates, shared by the windowed and headless loops
+void updateConstants(Primitive& primitive, float time, unsigned int WIDTH, unsigned int HEIGHT) {
+	primitive.constantBuffer.update(primitive.timeHandle, &time);
+
+	// Lets add lights spinning over the triangle
+	Vec4 lights[4];
+	for (int i = 0; i < 4; i++) {
+		float angle = time + (i * M_PI / 2.0f);
+		lights[i] = Vec4(
+			WIDTH / 2.0f + (cosf(angle) * (WIDTH * 0.3f)),
+			HEIGHT / 2.0f + (sinf(angle) * (HEIGHT * 0.3f)),
+			0, 0
+		);
+	}
+	// Update the array in the buffer
+	primitive.constantBuffer.update(primitive.lightsHandle, lights);
+}
 
+#ifdef _WIN32
 /*
  *	Entry-point function - WinMain
  *	WinMain Parameters:
@@ -34,13 +63,21 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 	unsigned int WIDTH = 1024, HEIGHT = 1024;  // Define screen dimensions
 
 	Window window;
+	ThreadPool pool;
 	Core core;
 	Primitive primitive;
 	GamesEngineeringBase::Timer timer;
 	
 	window.initialize(WIDTH, HEIGHT, "My Window");
+	pool.initialize();
 	core.initialize(window.hwnd, WIDTH, HEIGHT);
+	core.shaderManager.compilePool = &pool;
+	core.beginUploads();
 	primitive.initialize(&core);
+	core.endUploads();
+	core.shaderManager.cache.logStats();
+	core.shaderManager.logPermutationStats();
+	core.pipelines.logStats();
 	float time = 0.f;
 	// ConstantBuffer2 constBufferCPU2;   // Pulsing Triangle -> ConstantBuffer1 constBufferCPU1;
 	// constBufferCPU2.time = 0;		  // Pulsing Triangle -> constBufferCPU1.time = 0;
@@ -49,22 +86,9 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 		if (window.keys[VK_ESCAPE] == 1) break;
 		float dt = timer.dt();
 		time += dt;
-		primitive.constantBuffer.update("time", &time);
+		updateConstants(primitive, time, WIDTH, HEIGHT);
 		// constBufferCPU2.time += dt;  // Pulsing Triangle -> constBufferCPU1.time += dt;
 
-		// Lets add lights spinning over the triangle
-		Vec4 lights[4];
-		for (int i = 0; i < 4; i++) {
-			float angle = time + (i * M_PI / 2.0f);
-			lights[i] = Vec4(
-				WIDTH / 2.0f + (cosf(angle) * (WIDTH * 0.3f)),
-				HEIGHT / 2.0f + (sinf(angle) * (HEIGHT * 0.3f)), 
-				0, 0
-			);
-		}
-		// Update the array in the buffer
-		primitive.constantBuffer.update("lights", lights);
-
 		core.beginFrame();
 		window.processMessages();
 
@@ -74,4 +98,96 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 	}
 	core.flushGraphicsQueue();
 	return 0;
-}
\ No newline at end of file
+}
+#else
+/*
+ *	Headless entry-point - runs the same frame loop on the null backend and reports its CPU cost
+ *	Usage: GPUDrawing [frames] [gpuLatency] [framesInFlight] [--bench[=gpu|math|raster|shaders]]
+ */
+int main(int argc, char** argv) {
+	unsigned int WIDTH = 1024, HEIGHT = 1024;  // Define screen dimensions
+
+	// Numbers are positional, --bench can go anywhere
+	const char* bench = NULL;
+	unsigned int numbers[3] = { 1000, 0, 2 };
+	unsigned int numberCount = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--bench", 7) == 0) bench = (argv[i][7] == '=') ? &argv[i][8] : "all";
+		else if (numberCount < 3) numbers[numberCount++] = (unsigned int)atoi(argv[i]);
+	}
+	unsigned int frames = numbers[0];
+
+	NullDevice* nullDevice = new NullDevice();
+	nullDevice->initialize();
+	if (numberCount > 1) nullDevice->gpuLatency = numbers[1];
+	unsigned int framesInFlight = numbers[2];
+
+	ThreadPool pool;
+	pool.initialize();
+	Core core;
+	Primitive primitive;
+	core.initialize(nullDevice, NULL, WIDTH, HEIGHT, framesInFlight);
+	core.shaderManager.compilePool = &pool;
+	core.beginUploads();
+	primitive.initialize(&core);
+	core.endUploads();
+	core.shaderManager.cache.logStats();
+	core.shaderManager.logPermutationStats();
+	core.pipelines.logStats();
+
+	// Only measure the frame loop, not start-up uploads
+	nullDevice->stats.reset();
+	float time = 0.f;
+	const float dt = 1.f / 60.f;
+	double totalMs = 0.0, minMs = 1e30, maxMs = 0.0;
+
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		time += dt;
+		updateConstants(primitive, time, WIDTH, HEIGHT);
+
+		core.beginFrame();
+		primitive.draw(&core);
+		core.finishFrame();
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		totalMs += ms;
+		if (ms < minMs) minMs = ms;
+		if (ms > maxMs) maxMs = ms;
+	}
+	core.flushGraphicsQueue();
+
+	const NullDeviceStats& stats = nullDevice->stats;
+	double perFrame = (frames > 0) ? 1.0 / frames : 0.0;
+	printf("frames: %u (%u in flight)\n", frames, core.framesInFlight);
+	printf("cpu frame ms: avg %.5f min %.5f max %.5f\n", totalMs * perFrame, minMs, maxMs);
+	printf("per frame: commands %.1f draws %.1f barriers %.1f lists %.1f bytes copied %.1f\n",
+		   stats.totalCommands() * perFrame, stats.drawCalls * perFrame, stats.barriers * perFrame,
+		   stats.commandListsExecuted * perFrame, stats.bytesCopied * perFrame);
+	printf("fence signals %llu, cpu waits %llu, queue waits %llu, presents %llu\n",
+		   (unsigned long long)stats.fenceSignals, (unsigned long long)stats.cpuWaits,
+		   (unsigned long long)stats.queueWaits, (unsigned long long)stats.presents);
+	const BarrierStats& barriers = core.barrierTotal;
+	printf("per frame: transitions %.1f redundant %.1f barriers %.1f flushes %.1f, largest flush %llu\n",
+		   barriers.transitions * perFrame, barriers.redundant * perFrame, barriers.barriers * perFrame,
+		   barriers.flushes * perFrame, (unsigned long long)barriers.largestFlush);
+	if (bench) {
+		bool all = strcmp(bench, "all") == 0;
+		if (all || strcmp(bench, "gpu") == 0) runGPUBenchmarks(core, primitive);
+		if (all || strcmp(bench, "math") == 0) runMathBenchmarks(core, pool);
+		if (all || strcmp(bench, "raster") == 0) runRasterBenchmarks(core, primitive, pool);
+		if (all || strcmp(bench, "shaders") == 0) runShaderBenchmarks(core, primitive);
+	}
+
+	const GPUMemoryStats& memoryStats = core.memory.getStats();
+	printf("gpu memory: heaps %llu (%.1f MB) used %.1f MB, placed %llu committed %llu, fragmentation %.3f\n",
+		   (unsigned long long)memoryStats.heaps, memoryStats.heapBytes / (1024.0 * 1024.0), memoryStats.usedBytes / (1024.0 * 1024.0),
+		   (unsigned long long)memoryStats.placedResources, (unsigned long long)memoryStats.committedResources, memoryStats.fragmentation);
+
+	const FrameRingStats& ringStats = core.constantBufferRing.stats;
+	printf("constant buffer ring: capacity %llu high-water %llu allocations %llu grows %u\n",
+		   (unsigned long long)ringStats.capacity, (unsigned long long)ringStats.highWaterMark,
+		   (unsigned long long)ringStats.allocations, ringStats.grows);
+	return 0;
+}
+#endif